@@ -2,14 +2,14 @@
 
 #include <cstring>
 
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
 
 // defined in the main SDL wrapper
 extern SDL_Surface* gBackBuffer;
 extern bool handle_input();
 extern void render();
 
-#elif MLN_TARGET_PICO
+#elif MLN_DISPLAY_LCD
 
 #include "drivers/keyboard.h"
 #include "drivers/lcd.h"
@@ -44,7 +44,7 @@ constexpr uint16_t darkenTimes<0>(uint16_t c)
 }
 
 
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
 void darken(SDL_Surface* surf)
 {
     uint16_t* pix = (uint16_t*)(surf->pixels);
@@ -130,14 +130,14 @@ AnimRenderer::AnimRenderer(float minX, float maxX, float minY, float maxY)
     , mX( mAxisX, 0, IMGW - 1)
     , mY( mAxisY, IMGW - 1, 0)
 {
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
     mSurf = SDL_CreateRGBSurfaceWithFormat(0, IMGW, IMGH, 16, SDL_PIXELFORMAT_RGB565);
     if (!mSurf)
         return;
 
     SDL_FillRect(gBackBuffer, nullptr, 0);
 
-#elif MLN_TARGET_PICO
+#elif MLN_DISPLAY_LCD
 
     lcd_scroll_clear();
     lcd_enable_cursor(false);
@@ -147,11 +147,11 @@ AnimRenderer::AnimRenderer(float minX, float maxX, float minY, float maxY)
 
 AnimRenderer::~AnimRenderer()
 {
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
     SDL_FreeSurface(mSurf);
     mSurf = nullptr;
 
-#elif MLN_TARGET_PICO
+#elif MLN_DISPLAY_LCD
 
     lcd_enable_cursor(true);
 
@@ -167,7 +167,7 @@ void AnimRenderer::darken()
 
 void AnimRenderer::blit() const
 {
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
 
     SDL_LockSurface(mSurf);
 
@@ -184,7 +184,7 @@ void AnimRenderer::blit() const
     SDL_BlitSurface(mSurf, nullptr, gBackBuffer, &dstRect);
     render();
 
-#elif MLN_TARGET_PICO
+#elif MLN_DISPLAY_LCD
 
     // expand row-by-row to local array and then blit each of those in turn
     uint16_t row[IMGW];
@@ -202,14 +202,19 @@ void AnimRenderer::blit() const
 
 bool AnimRenderer::check_for_break()
 {
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
 
     return handle_input() == false;
 
-#elif MLN_TARGET_PICO
+#elif MLN_DISPLAY_LCD
 
     return keyboard_key_available();
 
+#else
+
+    // there's nothing to watch, so stop after the first frame
+    return true;
+
 #endif
 }
 
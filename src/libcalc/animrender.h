@@ -5,7 +5,7 @@
 
 #include <cstdint>
 
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
 #include <SDL.h>
 #endif
 
@@ -97,7 +97,7 @@ public:
 private:
     TinyScopeFrameBuf mFb;
 
-#if MLN_TARGET_PC
+#if MLN_DISPLAY_SDL
     SDL_Surface* mSurf = nullptr;
 #endif
 
@@ -0,0 +1,299 @@
+#include "ast.h"
+
+#include "context.h"
+#include "funcs.h"
+#include "maths.h"
+#include "symbols.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+// the arena is a list of fixed-size chunks which are kept around between evals
+constexpr int kNodesPerChunk = 256;
+
+struct AstState
+{
+    std::vector<Node*> Chunks;
+    size_t ChunkIx = 0;
+    int NodeIx = 0;
+
+    AstStats Stats;
+
+    // open-addressed, sized to at least twice the number of nodes being shared
+    std::vector<Node*> ShareTable;
+
+    std::vector<WalkStep> WalkSteps;
+};
+
+AstState* create_ast_state()
+{
+    return new AstState;
+}
+
+void destroy_ast_state(AstState* state)
+{
+    for (Node* chunk : state->Chunks)
+        delete[] chunk;
+    delete state;
+}
+
+static AstState& ast_state()
+{
+    return *calc_context().Ast;
+}
+
+std::vector<WalkStep>& walk_steps()
+{
+    return ast_state().WalkSteps;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void reset_ast()
+{
+    AstState& state = ast_state();
+
+    state.ChunkIx = 0;
+    state.NodeIx = 0;
+}
+
+Node* new_node(NodeKind kind, Node* a, Node* b)
+{
+    AstState& state = ast_state();
+
+    if (state.ChunkIx < state.Chunks.size() && state.NodeIx == kNodesPerChunk)
+    {
+        ++state.ChunkIx;
+        state.NodeIx = 0;
+    }
+    if (state.ChunkIx == state.Chunks.size())
+        state.Chunks.push_back(new Node[kNodesPerChunk]);
+
+    Node* node = state.Chunks[state.ChunkIx] + state.NodeIx;
+    ++state.NodeIx;
+    ++state.Stats.NodesBuilt;
+
+    *node = Node();
+    node->Kind = kind;
+    node->A = a;
+    node->B = b;
+    return node;
+}
+
+Node* new_const(double val)
+{
+    Node* node = new_node(NodeKind::Const);
+    node->Value = val;
+    return node;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static Node* folded(Node* node, double val)
+{
+    ++ast_state().Stats.NodesFolded;
+
+    node->Kind = NodeKind::Const;
+    node->Value = val;
+    node->A = nullptr;
+    node->B = nullptr;
+    return node;
+}
+
+// node's children have been folded already
+static Node* fold_node(Node* node)
+{
+    const bool aConst = node->A && (node->A->Kind == NodeKind::Const);
+    const bool bConst = node->B && (node->B->Kind == NodeKind::Const);
+    const double a = aConst ? node->A->Value : 0.0;
+    const double b = bConst ? node->B->Value : 0.0;
+
+    switch (node->Kind)
+    {
+    case NodeKind::Sym:
+    {
+        // user values can change after the definition, so whoever keeps the result has to track
+        // what it used (see deps.h)
+        double val;
+        if (eval_named_value(node->Name, val))
+            return folded(node, val);
+        break;
+    }
+
+    case NodeKind::Call:
+        if (aConst)
+            return folded(node, call_builtin_func(node->BuiltinIx, a));
+        break;
+
+    case NodeKind::Neg:
+        if (aConst)
+            return folded(node, -a);
+        break;
+
+    case NodeKind::Add:     if (aConst && bConst) return folded(node, a + b);           break;
+    case NodeKind::Sub:     if (aConst && bConst) return folded(node, a - b);           break;
+    case NodeKind::Mul:     if (aConst && bConst) return folded(node, a * b);           break;
+    case NodeKind::Div:     if (aConst && bConst) return folded(node, a / b);           break;
+    case NodeKind::Pow:     if (aConst && bConst) return folded(node, std::pow(a, b));  break;
+
+    case NodeKind::Fact:
+    {
+        // leave bad factorials for run time, so they get reported like they always have
+        double val = a;
+        if (aConst && compute_factorial(val))
+            return folded(node, val);
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    return node;
+}
+
+Node* fold_constants(Node* node)
+{
+    return rewrite_tree(node, enter_every_node, fold_node);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// counts how many parents read each node. a node on both sides of a binop is read once, since
+// the emitter Dups it. returns the number of distinct nodes that aren't just a number or the arg
+static int count_uses(Node* root)
+{
+    int count = 0;
+
+    TreeWalk walk;
+    walk.push(root);
+
+    WalkStep step;
+    while (walk.pop(step))
+    {
+        Node* node = step.At;
+        if (++node->Uses > 1)
+            continue;
+
+        if ((node->Kind != NodeKind::Const) && (node->Kind != NodeKind::Arg))
+            ++count;
+        if (node->B && (node->B != node->A))
+            walk.push(node->B);
+        if (node->A)
+            walk.push(node->A);
+    }
+
+    return count;
+}
+
+static void clear_uses(Node* root)
+{
+    TreeWalk walk;
+    walk.push(root);
+
+    WalkStep step;
+    while (walk.pop(step))
+    {
+        Node* node = step.At;
+        if (!node || (node->Uses == 0))
+            continue;
+
+        node->Uses = 0;
+        node->Temp = kNoTemp;
+        walk.push(node->B);
+        walk.push(node->A);
+    }
+}
+
+static uint32_t hash_node(const Node* node)
+{
+    uint64_t valueBits;
+    memcpy(&valueBits, &node->Value, sizeof(valueBits));
+
+    const uint64_t parts[] =
+    {
+        uint64_t(node->Kind) | (uint64_t(node->BuiltinIx) << 8) | (uint64_t(node->Name) << 16),
+        valueBits,
+        uint64_t(uintptr_t(node->A)),
+        uint64_t(uintptr_t(node->B)),
+    };
+
+    uint64_t hash = 14695981039346656037ull;
+    for (uint64_t part : parts)
+    {
+        hash ^= part;
+        hash *= 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    return uint32_t(hash);
+}
+
+// children are compared by address, so they must already have been shared
+static bool same_node(const Node* a, const Node* b)
+{
+    return (a->Kind == b->Kind) && (a->BuiltinIx == b->BuiltinIx) && (a->Name == b->Name)
+        && (memcmp(&a->Value, &b->Value, sizeof(a->Value)) == 0)
+        && (a->A == b->A) && (a->B == b->B);
+}
+
+// returns the node's twin from the table, adding the node itself if it hasn't got one
+static Node* find_or_add_shared(Node* node, bool add)
+{
+    AstState& state = ast_state();
+
+    const size_t mask = state.ShareTable.size() - 1;
+    for (size_t ix = hash_node(node) & mask; ; ix = (ix + 1) & mask)
+    {
+        Node*& entry = state.ShareTable[ix];
+        if (!entry)
+        {
+            if (add)
+                entry = node;
+            return entry;
+        }
+        if (same_node(entry, node))
+            return entry;
+    }
+}
+
+// nodes that have already been through here have shared children, so are found straight away
+static Node* find_twin(Node* node)
+{
+    return find_or_add_shared(node, false);
+}
+
+static Node* add_shared(Node* node)
+{
+    return find_or_add_shared(node, true);
+}
+
+Node* share_subtrees(Node* root, int& outNumShared)
+{
+    AstState& state = ast_state();
+
+    const int numBefore = count_uses(root);
+    clear_uses(root);
+
+    size_t tableSize = 16;
+    while (tableSize < size_t(numBefore) * 2)
+        tableSize *= 2;
+    state.ShareTable.assign(tableSize, nullptr);
+
+    root = rewrite_tree(root, find_twin, add_shared);
+
+    outNumShared = numBefore - count_uses(root);
+    state.Stats.NodesShared += outNumShared;
+    return root;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+const AstStats& ast_stats()
+{
+    return ast_state().Stats;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "intern.h"
+#include "parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+// expressions are parsed into a tree first, which gets tidied up before being turned into a
+// Program. nodes come from an arena that's emptied at the start of every calc_eval, so trees
+// must never be kept past that
+enum class NodeKind : uint8_t
+{
+    Const,      // Value
+    Arg,        // the function's arg
+    Sym,        // the named value Name
+
+    Call,       // builtin function #BuiltinIx (A)
+    CallUser,   // user function Name (A)
+    Deriv,      // derivative of function Name at A
+
+    Neg,        // -A
+    Add, Sub,   // A op B
+    Mul, Div,
+    Pow,
+    Fact,       // A!
+};
+
+constexpr uint8_t kNoTemp = 0xff;
+
+struct Node
+{
+    NodeKind Kind = NodeKind::Const;
+    uint8_t BuiltinIx = 0;
+    SymId Name = kNoSymId;
+    double Value = 0.0;
+
+    Node* A = nullptr;
+    Node* B = nullptr;
+
+    // filled in by share_subtrees: how many parents read this node, and the temp it's kept in
+    // once it's been emitted
+    uint16_t Uses = 0;
+    uint8_t Temp = kNoTemp;
+
+    // for the ops that can fail when they're run
+    SourcePos Pos;
+};
+
+struct AstStats
+{
+    uint32_t NodesBuilt = 0;
+    uint32_t NodesFolded = 0;   // ops that were worked out at definition time instead
+    uint32_t NodesShared = 0;   // ops that were merged with an identical one
+};
+
+//-------------------------------------------------------------------------------------------------
+
+struct AstState;
+AstState* create_ast_state();
+void destroy_ast_state(AstState* state);
+
+void reset_ast();
+
+Node* new_node(NodeKind kind, Node* a = nullptr, Node* b = nullptr);
+Node* new_const(double val);
+
+// replaces every subtree that doesn't depend on the arg or on a user function with a single
+// Const. results are bit-identical to evaluating the tree at run time, as long as no user value
+// it used has changed since
+Node* fold_constants(Node* node);
+
+// merges identical subtrees, so that each is only worked out once per run. nothing in an
+// expression can change a value, so every node is pure and this never changes results.
+// returns how many ops were merged away, and leaves Uses set for the emitter
+Node* share_subtrees(Node* root, int& outNumShared);
+
+const AstStats& ast_stats();
+
+//-------------------------------------------------------------------------------------------------
+
+// trees can be thousands of nodes deep, eg. a long sum, so nothing walks them by recursing. what's
+// still to be done goes on a stack instead. there's one stack, so walks can run inside each other:
+// each only uses the part above where it started, and leaves it as it found it
+struct WalkStep
+{
+    Node* At = nullptr;
+    Node** Slot = nullptr;  // where a replacement for At goes, for walks that make them
+    int Tag = 0;            // whatever else the walk needs to keep with it
+};
+
+std::vector<WalkStep>& walk_steps();
+
+struct TreeWalk
+{
+    std::vector<WalkStep>& Steps;
+    const size_t Base;
+
+    TreeWalk() : Steps(walk_steps()), Base(Steps.size()) {}
+    ~TreeWalk() { Steps.resize(Base); }
+
+    void push(Node* at, Node** slot = nullptr, int tag = 0)
+    {
+        Steps.push_back({ .At = at, .Slot = slot, .Tag = tag });
+    }
+
+    bool pop(WalkStep& out)
+    {
+        if (Steps.size() == Base)
+            return false;
+
+        out = Steps.back();
+        Steps.pop_back();
+        return true;
+    }
+};
+
+// replaces every node in the tree with what leave returns for it, children first and A before B.
+// when enter returns something for a node, that replaces it straight away, and its children are
+// left alone
+template<typename Enter, typename Leave>
+Node* rewrite_tree(Node* root, Enter enter, Leave leave)
+{
+    TreeWalk walk;
+    walk.push(root, &root);
+
+    WalkStep step;
+    while (walk.pop(step))
+    {
+        Node* node = step.At;
+        if (!node)
+            continue;
+
+        if (step.Tag == 1)
+        {
+            *step.Slot = leave(node);
+            continue;
+        }
+
+        if (Node* replacement = enter(node))
+        {
+            *step.Slot = replacement;
+            continue;
+        }
+
+        walk.push(node, step.Slot, 1);
+        walk.push(node->B, &node->B);
+        walk.push(node->A, &node->A);
+    }
+
+    return root;
+}
+
+inline Node* enter_every_node(Node*)
+{
+    return nullptr;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,429 @@
+#include "bytecode.h"
+
+#include "funcs.h"
+#include "maths.h"
+#include "simd.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+// batches are run a block of lanes at a time, small enough that the whole stack lives on the stack
+#if MLN_TARGET_PC
+constexpr int kBatchBlock = 32;
+#else
+constexpr int kBatchBlock = 4;
+#endif
+static_assert((kBatchBlock % VecD::Width) == 0);
+
+//-------------------------------------------------------------------------------------------------
+
+// how much each op changes the stack depth by
+static const int8_t kOpStackDelta[] =
+{
+    +1, +1, +1, // Const, Arg, Sym
+    +1,         // Dup
+    +1, 0,      // Load, Store
+    0, 0, 0,    // Call, CallUser, Deriv
+    0,          // Neg
+    -1, -1,     // Add, Sub
+    -1, -1,     // Mul, Div
+    -1,         // Pow
+    0,          // Fact
+};
+static_assert((sizeof(kOpStackDelta) / sizeof(kOpStackDelta[0])) == size_t(Op::COUNT));
+
+//-------------------------------------------------------------------------------------------------
+
+void reset_program(Program& prog)
+{
+    prog.Code.clear();
+    prog.Consts.clear();
+    prog.Names.clear();
+    prog.NumTemps = 0;
+    prog.NodesShared = 0;
+    prog.Depth = 0;
+    prog.MaxDepth = 0;
+    prog.Sites.clear();
+    prog.EmitPos = {};
+}
+
+static bool emit(Program& prog, Op op, size_t operand, ParseCtx& ctx)
+{
+    if (ctx.Error)
+        return false;
+
+    prog.Code.push_back({ .Code = op, .Operand = uint32_t(operand) });
+    prog.Sites.push_back(prog.EmitPos);
+
+    prog.Depth += kOpStackDelta[int(op)];
+    if (prog.Depth > prog.MaxDepth)
+        prog.MaxDepth = prog.Depth;
+
+    return true;
+}
+
+bool emit_op(Program& prog, Op op, ParseCtx& ctx)
+{
+    return emit(prog, op, 0, ctx);
+}
+
+bool emit_const(Program& prog, double val, ParseCtx& ctx)
+{
+    if (ctx.Error)
+        return false;
+
+    size_t ix = 0;
+    while (ix < prog.Consts.size() && memcmp(&prog.Consts[ix], &val, sizeof(val)) != 0)
+        ++ix;
+
+    if (ix == prog.Consts.size())
+        prog.Consts.push_back(val);
+
+    return emit(prog, Op::Const, ix, ctx);
+}
+
+bool emit_named(Program& prog, Op op, SymId name, ParseCtx& ctx)
+{
+    if (ctx.Error)
+        return false;
+
+    size_t ix = 0;
+    while (ix < prog.Names.size() && prog.Names[ix] != name)
+        ++ix;
+
+    if (ix == prog.Names.size())
+        prog.Names.push_back(name);
+
+    return emit(prog, op, ix, ctx);
+}
+
+bool emit_call(Program& prog, int builtinIx, ParseCtx& ctx)
+{
+    return emit(prog, Op::Call, builtinIx, ctx);
+}
+
+bool emit_temp(Program& prog, Op op, int tempIx, ParseCtx& ctx)
+{
+    if (tempIx >= prog.NumTemps)
+        prog.NumTemps = uint8_t(tempIx + 1);
+
+    return emit(prog, op, tempIx, ctx);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void on_run_error(ParseCtx& ctx, SourcePos pos, const char* msg)
+{
+    if (pos.Text == kNoSymId)
+    {
+        ctx.CurrIx = pos.Ix;
+        on_parse_error(ctx, msg);
+        return;
+    }
+
+    // it was compiled from a function body, maybe inlined into this one, so point into that
+    const UserFunction* func = lookup_user_func(pos.Text);
+    const char* def = func ? function_def(func) : "";
+    ParseCtx body { .InBuffer = def, .CurrIx = std::min(pos.Ix, int32_t(strlen(def))), .ResBuffer = ctx.ResBuffer,
+                    .ResBufferLen = ctx.ResBufferLen, .Error = ctx.Error };
+    on_parse_error(body, msg);
+    ctx.Error = true;
+}
+
+bool run_program(const Program& prog, double arg, double& outVal, ParseCtx& ctx)
+{
+    char errBuf[20+kMaxSymbolLength+1];
+
+    double localStack[kMaxProgramStack];
+    std::vector<double> bigStack;
+    double* stack = localStack;
+    if (prog.MaxDepth > kMaxProgramStack)
+    {
+        bigStack.resize(prog.MaxDepth);
+        stack = bigStack.data();
+    }
+
+    double* top = stack - 1;
+    double temps[kMaxProgramTemps];
+
+    const Instr* in = prog.Code.data();
+    const Instr* inEnd = in + prog.Code.size();
+    for (; in != inEnd; ++in)
+    {
+        switch (in->Code)
+        {
+        case Op::Const:
+            *(++top) = prog.Consts[in->Operand];
+            break;
+
+        case Op::Arg:
+            *(++top) = arg;
+            break;
+
+        case Op::Sym:
+            if (!eval_named_value(prog.Names[in->Operand], *(++top)))
+            {
+                sprintf(errBuf, "unknown named val: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            break;
+
+        case Op::Dup:
+            ++top;
+            *top = top[-1];
+            break;
+
+        case Op::Load:
+            *(++top) = temps[in->Operand];
+            break;
+
+        case Op::Store:
+            temps[in->Operand] = *top;
+            break;
+
+        case Op::Call:
+            *top = call_builtin_func(in->Operand, *top);
+            break;
+
+        case Op::CallUser:
+            if (!eval_function(prog.Names[in->Operand], *top, *top, ctx))
+            {
+                if (ctx.Error)
+                    return false;
+
+                sprintf(errBuf, "unknown func: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            break;
+
+        case Op::Deriv:
+            if (!eval_derivative(prog.Names[in->Operand], *top, *top, ctx))
+            {
+                if (ctx.Error)
+                    return false;
+
+                sprintf(errBuf, "unknown func: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            break;
+
+        case Op::Neg:
+            *top = -*top;
+            break;
+
+        case Op::Add:   --top;  *top = top[0] + top[1];     break;
+        case Op::Sub:   --top;  *top = top[0] - top[1];     break;
+        case Op::Mul:   --top;  *top = top[0] * top[1];     break;
+        case Op::Div:   --top;  *top = top[0] / top[1];     break;
+        case Op::Pow:   --top;  *top = std::pow(top[0], top[1]);    break;
+
+        case Op::Fact:
+            if (!compute_factorial(*top))
+            {
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], "need a positive integer");
+                return false;
+            }
+            break;
+
+        default:
+            on_parse_error(ctx, "corrupt program");
+            return false;
+        }
+    }
+
+    if (top != stack)
+    {
+        on_parse_error(ctx, "corrupt program");
+        return false;
+    }
+
+    outVal = *top;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+template<typename OpFn>
+static inline void batch_binop(double* a, const double* b, OpFn op)
+{
+    for (int i = 0; i < kBatchBlock; i += VecD::Width)
+        vec_store(a + i, op(vec_load(a + i), vec_load(b + i)));
+}
+
+static bool run_block(const Program& prog, const double* xs, double* ys, ParseCtx& ctx)
+{
+    char errBuf[20+kMaxSymbolLength+1];
+
+    double localStack[kMaxProgramStack][kBatchBlock];
+    std::vector<double> bigStack;
+    double (*stack)[kBatchBlock] = localStack;
+    if (prog.MaxDepth > kMaxProgramStack)
+    {
+        bigStack.resize(size_t(prog.MaxDepth) * kBatchBlock);
+        stack = reinterpret_cast<double (*)[kBatchBlock]>(bigStack.data());
+    }
+
+    double (*top)[kBatchBlock] = stack - 1;
+    double temps[kMaxProgramTemps][kBatchBlock];
+
+    const Instr* in = prog.Code.data();
+    const Instr* inEnd = in + prog.Code.size();
+    for (; in != inEnd; ++in)
+    {
+        switch (in->Code)
+        {
+        case Op::Const:
+        {
+            const double val = prog.Consts[in->Operand];
+            ++top;
+            for (double& lane : *top)
+                lane = val;
+            break;
+        }
+
+        case Op::Arg:
+            ++top;
+            memcpy(*top, xs, sizeof(*top));
+            break;
+
+        case Op::Sym:
+        {
+            const SymId name = prog.Names[in->Operand];
+            ++top;
+
+            double val;
+            if (!eval_named_value(name, val))
+            {
+                sprintf(errBuf, "unknown named val: %s", interned_name(name));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            for (double& lane : *top)
+                lane = val;
+            break;
+        }
+
+        case Op::Dup:
+            ++top;
+            memcpy(*top, top[-1], sizeof(*top));
+            break;
+
+        case Op::Load:
+            ++top;
+            memcpy(*top, temps[in->Operand], sizeof(*top));
+            break;
+
+        case Op::Store:
+            memcpy(temps[in->Operand], *top, sizeof(*top));
+            break;
+
+        case Op::Call:
+            call_builtin_func_batch(in->Operand, *top, *top, kBatchBlock);
+            break;
+
+        case Op::CallUser:
+            if (!eval_function_batch(prog.Names[in->Operand], *top, *top, kBatchBlock, ctx))
+            {
+                if (ctx.Error)
+                    return false;
+
+                sprintf(errBuf, "unknown func: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            break;
+
+        case Op::Deriv:
+            for (double& lane : *top)
+            {
+                if (!eval_derivative(prog.Names[in->Operand], lane, lane, ctx))
+                {
+                    if (ctx.Error)
+                        return false;
+
+                    sprintf(errBuf, "unknown func: %s", interned_name(prog.Names[in->Operand]));
+                    on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                    return false;
+                }
+            }
+            break;
+
+        case Op::Neg:
+            for (int i = 0; i < kBatchBlock; i += VecD::Width)
+                vec_store(*top + i, -vec_load(*top + i));
+            break;
+
+        case Op::Add:   --top;  batch_binop(*top, top[1], [](VecD a, VecD b) { return a + b; });    break;
+        case Op::Sub:   --top;  batch_binop(*top, top[1], [](VecD a, VecD b) { return a - b; });    break;
+        case Op::Mul:   --top;  batch_binop(*top, top[1], [](VecD a, VecD b) { return a * b; });    break;
+        case Op::Div:   --top;  batch_binop(*top, top[1], [](VecD a, VecD b) { return a / b; });    break;
+
+        case Op::Pow:
+            --top;
+            for (int i = 0; i < kBatchBlock; ++i)
+                top[0][i] = std::pow(top[0][i], top[1][i]);
+            break;
+
+        case Op::Fact:
+            for (double& lane : *top)
+            {
+                if (!compute_factorial(lane))
+                {
+                    on_run_error(ctx, prog.Sites[in - prog.Code.data()], "need a positive integer");
+                    return false;
+                }
+            }
+            break;
+
+        default:
+            on_parse_error(ctx, "corrupt program");
+            return false;
+        }
+    }
+
+    if (top != stack)
+    {
+        on_parse_error(ctx, "corrupt program");
+        return false;
+    }
+
+    memcpy(ys, *top, sizeof(*top));
+    return true;
+}
+
+bool run_program_batch(const Program& prog, const double* xs, double* ys, int count, ParseCtx& ctx)
+{
+    for (int start = 0; start < count; start += kBatchBlock)
+    {
+        const int num = count - start;
+        if (num >= kBatchBlock)
+        {
+            if (!run_block(prog, xs + start, ys + start, ctx))
+                return false;
+            continue;
+        }
+
+        // pad out the last block by repeating its last x so the spare lanes can't raise errors of their own
+        double xBlock[kBatchBlock];
+        double yBlock[kBatchBlock];
+        for (int i = 0; i < kBatchBlock; ++i)
+            xBlock[i] = xs[start + (i < num ? i : num - 1)];
+
+        if (!run_block(prog, xBlock, yBlock, ctx))
+            return false;
+
+        memcpy(ys + start, yBlock, num * sizeof(yBlock[0]));
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
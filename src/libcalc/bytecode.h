@@ -0,0 +1,86 @@
+#pragma once
+
+#include "parser.h"
+
+#include <cstdint>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+// programs can be any size. the interpreters keep this much stack locally, and put anything that
+// needs more on the heap
+constexpr int kMaxProgramStack = 32;
+constexpr int kMaxProgramTemps = 16;
+
+//-------------------------------------------------------------------------------------------------
+
+// a compiled expression is a little stack machine program
+// every op either pushes one value, or pops its args and pushes its result
+enum class Op : uint8_t
+{
+    Const,      // push Consts[operand]
+    Arg,        // push the function's arg
+    Sym,        // push the current value of the symbol Names[operand]
+    Dup,        // push a copy of top
+    Load,       // push Temps[operand]
+    Store,      // Temps[operand] = top, leaving it on the stack
+
+    Call,       // top = builtin function #operand (top)
+    CallUser,   // top = user function Names[operand] (top)
+    Deriv,      // top = derivative of function Names[operand] at top
+
+    Neg,
+    Add, Sub,
+    Mul, Div,
+    Pow,
+    Fact,
+
+    COUNT,
+};
+
+struct Instr
+{
+    Op Code;
+    uint32_t Operand;
+};
+
+struct Program
+{
+    std::vector<Instr> Code;
+    std::vector<double> Consts;
+    std::vector<SymId> Names;
+
+    // temps hold values that are used more than once, see share_subtrees
+    uint8_t NumTemps = 0;
+    uint16_t NodesShared = 0;
+
+    // stack depth after the last emitted op, and the most the program will ever need
+    int Depth = 0;
+    int MaxDepth = 0;
+
+    // where each op in Code came from, for errors, and what the next one emitted is given
+    std::vector<SourcePos> Sites;
+    SourcePos EmitPos;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+void reset_program(Program& prog);
+
+// all emitters do nothing once ctx has an error
+bool emit_op(Program& prog, Op op, ParseCtx& ctx);
+bool emit_const(Program& prog, double val, ParseCtx& ctx);
+bool emit_named(Program& prog, Op op, SymId name, ParseCtx& ctx);
+bool emit_call(Program& prog, int builtinIx, ParseCtx& ctx);
+bool emit_temp(Program& prog, Op op, int tempIx, ParseCtx& ctx);
+
+// reports an error running the op that came from pos, pointing at it the way the parser would
+void on_run_error(ParseCtx& ctx, SourcePos pos, const char* msg);
+
+// arg is what Op::Arg pushes; it's ignored by programs that aren't function bodies
+bool run_program(const Program& prog, double arg, double& outVal, ParseCtx& ctx);
+
+// runs the program once for each of xs, giving the same results as calling run_program for each x
+bool run_program_batch(const Program& prog, const double* xs, double* ys, int count, ParseCtx& ctx);
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,181 @@
+#include "cells.h"
+
+#include "bytecode.h"
+#include "context.h"
+#include "deps.h"
+#include "expr.h"
+#include "format.h"
+#include "libcalc.h"
+#include "parser.h"
+#include "symbols.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+struct Cell
+{
+    SymId Name = kNoSymId;
+    std::vector<char> Def;  // 0 terminated
+};
+
+// kept packed like the user symbols; undefining moves the last cell into the hole
+struct CellsState
+{
+    std::vector<Cell> Cells;
+    IdIndex CellIx;
+};
+
+CellsState* create_cells_state()
+{
+    return new CellsState;
+}
+
+void destroy_cells_state(CellsState* state)
+{
+    delete state;
+}
+
+static CellsState& cells_state()
+{
+    return *calc_context().Cells;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void init_cells()
+{
+    CellsState& state = cells_state();
+
+    state.Cells.clear();
+    state.CellIx = IdIndex();
+}
+
+// works out ctx's input the same way as typing it in would. ctx mustn't have been advanced yet
+static bool eval_def(ParseCtx ctx, double& outVal)
+{
+    advance_token(ctx);
+
+    outVal = parse_expression(ctx);
+    if (!ctx.Error && !accept(ctx, Token::Eof))
+        on_parse_error(ctx, "trailing nonsense");
+
+    return !ctx.Error;
+}
+
+bool define_cell(SymId name, ParseCtx& ctx)
+{
+    CellsState& state = cells_state();
+
+    if (is_constant(name))
+    {
+        on_parse_error(ctx, "can't redefine a constant");
+        return false;
+    }
+
+    // compiling it is just to find what it uses. the value comes from eval_def, so it's exactly
+    // what typing the expression in gives
+    const char* def = ctx.InBuffer;
+    const ParseCtx defCtx = ctx;
+    Program code;
+    std::vector<SymId> uses;
+    advance_token(ctx);
+    if (!compile_expression(ctx, code, kNoSymId, kNoSymId, &uses))
+        return false;
+
+    double val;
+    if (!eval_def(defCtx, val))
+    {
+        ctx.Error = true;
+        return false;
+    }
+
+    if (uses_reach(uses, name))
+    {
+        on_parse_error(ctx, "circular definition");
+        return false;
+    }
+
+    int ix = state.CellIx.Find(name);
+    if (ix < 0)
+    {
+        ix = int(state.Cells.size());
+        state.CellIx.Set(name, ix);
+        state.Cells.emplace_back();
+        state.Cells.back().Name = name;
+    }
+    state.Cells[ix].Def.assign(def, def + strlen(def) + 1);
+
+    set_uses(name, uses);
+    return define_value(name, val, ctx);
+}
+
+void undef_cell(SymId name)
+{
+    CellsState& state = cells_state();
+
+    const int ix = state.CellIx.Find(name);
+    if (ix < 0)
+        return;
+
+    const int lastIx = int(state.Cells.size()) - 1;
+    if (ix != lastIx)
+    {
+        state.Cells[ix] = std::move(state.Cells[lastIx]);
+        state.CellIx.Set(state.Cells[ix].Name, ix);
+    }
+
+    state.Cells.pop_back();
+    state.CellIx.Clear(name);
+
+    set_uses(name, {});
+}
+
+bool recompute_cell(SymId name, bool& outChanged)
+{
+    CellsState& state = cells_state();
+
+    const int ix = state.CellIx.Find(name);
+    if (ix < 0)
+        return false;
+
+    outChanged = false;
+
+    char line[80 + kMaxSymbolLength];
+    char errBuf[64];
+    double val;
+    ParseCtx ctx { .InBuffer = state.Cells[ix].Def.data(), .ResBuffer = errBuf, .ResBufferLen = sizeof(errBuf) };
+    if (!eval_def(ctx, val))
+    {
+        // just the message, not where it was
+        errBuf[strcspn(errBuf, "\n")] = 0;
+        snprintf(line, sizeof(line), "  %s: %s\n", interned_name(name), errBuf);
+        calc_puts(line);
+        return true;
+    }
+
+    double oldVal;
+    if (eval_named_value(name, oldVal) && (memcmp(&oldVal, &val, sizeof(val)) == 0))
+        return true;
+
+    outChanged = true;
+    refresh_value(name, val);
+
+    char valStr[32];
+    dtostr_human(val, valStr, sizeof(valStr));
+    snprintf(line, sizeof(line), "  %s = %s\n", interned_name(name), valStr);
+    calc_puts(line);
+    return true;
+}
+
+const char* cell_def(SymId name)
+{
+    CellsState& state = cells_state();
+
+    const int ix = state.CellIx.Find(name);
+    return (ix >= 0) ? state.Cells[ix].Def.data() : nullptr;
+}
+
+//-------------------------------------------------------------------------------------------------
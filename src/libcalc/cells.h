@@ -0,0 +1,32 @@
+#pragma once
+
+#include "intern.h"
+
+//-------------------------------------------------------------------------------------------------
+
+struct ParseCtx;
+
+//-------------------------------------------------------------------------------------------------
+
+// a cell is a user value that stays defined by its expression: after "area := pi*r^2", changing
+// r works area out again and prints its new value. cells are worked out in dependency order, and
+// only the ones downstream of a change (see deps.h)
+struct CellsState;
+CellsState* create_cells_state();
+void destroy_cells_state(CellsState* state);
+
+void init_cells();
+
+// ctx holds the expression, which must be valid now
+bool define_cell(SymId name, ParseCtx& ctx);
+
+// turns name back into a plain value, when it's given one with "="
+void undef_cell(SymId name);
+
+// returns false if name isn't a cell. otherwise outChanged says if its value did
+bool recompute_cell(SymId name, bool& outChanged);
+
+// null if name isn't a cell
+const char* cell_def(SymId name);
+
+//-------------------------------------------------------------------------------------------------
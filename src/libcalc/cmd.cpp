@@ -1,24 +1,51 @@
 #include "cmd.h"
 
+#include "ast.h"
+#include "cells.h"
+#include "context.h"
 #include "format.h"
 #include "funcs.h"
 #include "parser.h"
+#include "simplify.h"
 #include "symbols.h"
 
+#include <cstdio>
 #include <cstring>
 
 //-------------------------------------------------------------------------------------------------
 
-static CommandDef gCommands[kMaxCommands];
-static int gRegisteredCommands = 0;
+struct CommandsState
+{
+    CommandDef Commands[kMaxCommands];
+    int NumCommands = 0;
+
+    IdIndex CommandIx;
+};
+
+CommandsState* create_commands_state()
+{
+    return new CommandsState;
+}
+
+void destroy_commands_state(CommandsState* state)
+{
+    delete state;
+}
+
+static CommandsState& cmd_state()
+{
+    return *calc_context().Commands;
+}
 
 //-------------------------------------------------------------------------------------------------
 
 bool cmd_help(ParseCtx& ctx)
 {
+    CommandsState& state = cmd_state();
+
     if (peek(ctx, Token::Symbol))
     {
-        const CommandDef* cmd = lookup_command(ctx.TokenSymbol);
+        const CommandDef* cmd = lookup_command(ctx.TokenSymbolId);
         if (!cmd)
         {
             on_parse_error(ctx, "unknown help topic");
@@ -38,10 +65,15 @@ bool cmd_help(ParseCtx& ctx)
     calc_puts(" <name>[<var>] = <expr in var>\n");
     calc_puts("eg.  f[x] = sin(x^2)\n");
     calc_puts("eg.  theta = 2pi/3\n");
+    calc_puts(" <name> := <expr> keeps it up to date\n");
+    calc_puts("eg.  area := pi*r^2\n");
+    calc_puts("the * is needed after a name: pi r is an error\n");
+    calc_puts("d(f, x) is the slope of f at x\n");
+    calc_puts("fp = deriv f defines it as fp(x)\n");
     calc_puts("\n([{ and }]) are interchangeable\n\n");
 
-    const CommandDef* cmd = gCommands;
-    for (int i=0; i<gRegisteredCommands; ++i, ++cmd)
+    const CommandDef* cmd = state.Commands;
+    for (int i=0; i<state.NumCommands; ++i, ++cmd)
     {
         calc_puts(cmd->Name);
         calc_puts(" -- ");
@@ -86,6 +118,13 @@ bool cmd_list(const char*)
             calc_puts(function_name(it));
             calc_puts("(...) = ");
             calc_puts(function_def(it));
+
+            if (const int numShared = function_nodes_shared(it))
+            {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "   (%d fewer %s)", numShared, (numShared == 1) ? "op" : "ops");
+                calc_puts(buf);
+            }
             calc_puts("\n");
         }
     }
@@ -104,6 +143,12 @@ bool cmd_list(const char*)
             calc_puts(symbol_name(it));
             calc_puts(" = ");
             calc_puts(val_str);
+
+            if (const char* def = cell_def(symbol_id(it)))
+            {
+                calc_puts("   :=");
+                calc_puts(def);
+            }
             calc_puts("\n");
         }
     }
@@ -113,58 +158,222 @@ bool cmd_list(const char*)
 
 //-------------------------------------------------------------------------------------------------
 
+static void puts_stat(const char* name, uint32_t val)
+{
+    char line[40];
+    snprintf(line, sizeof(line), "%-16s%lu\n", name, (unsigned long)val);
+    calc_puts(line);
+}
+
+bool cmd_stats(const char*)
+{
+    const AstStats& ast = ast_stats();
+    puts_stat("nodes built", ast.NodesBuilt);
+    puts_stat("nodes folded", ast.NodesFolded);
+    puts_stat("nodes shared", ast.NodesShared);
+
+    const SimplifyStats& simp = simplify_stats();
+    puts_stat("polys rewritten", simp.PolysRewritten);
+    puts_stat("pows expanded", simp.PowsExpanded);
+    puts_stat("divs rewritten", simp.DivsRewritten);
+    puts_stat("ops dropped", simp.OpsDropped);
+
+    const EvalStats& eval = eval_stats();
+    const uint64_t numLines = uint64_t(eval.Definitions) + eval.Commands + eval.Expressions;
+    puts_stat("definitions", eval.Definitions);
+    puts_stat("commands", eval.Commands);
+    puts_stat("expressions", eval.Expressions);
+    if (eval.Nanos > 0)
+        puts_stat("lines per sec", uint32_t(numLines * 1000000000ull / eval.Nanos));
+
+    return true;
+}
+
+// memo ::= "memo" [symbol ["on" | "off" | "clear" | number]]
+bool cmd_memo(ParseCtx& ctx)
+{
+    if (peek(ctx, Token::Symbol))
+    {
+        SymId name;
+        expect_symbol(ctx, name);
+        if (!is_user_func(name))
+        {
+            on_parse_error(ctx, "unknown user function");
+            return false;
+        }
+
+        int size = -1;
+        if (peek(ctx, Token::Number))
+        {
+            const double num = expect_number(ctx);
+            size = (num < 1.0e6) ? int(num) : 1000000;
+        }
+        else if (peek(ctx, Token::Symbol))
+        {
+            char option[kMaxSymbolLength+1];
+            expect_symbol(ctx, option);
+
+            if (strcmp(option, "off") == 0)
+                size = 0;
+            else if (strcmp(option, "clear") == 0)
+                return clear_memo(name);
+            else if (strcmp(option, "on") != 0)
+            {
+                on_parse_error(ctx, "expected on, off, clear or a size");
+                return false;
+            }
+        }
+
+        return set_memo_size(name, size);
+    }
+
+    bool any = false;
+    for (UserFunctionIt it = function_user_begin(); it; it = function_next(it))
+    {
+        const int size = function_memo_size(it);
+        if (size == 0)
+            continue;
+
+        uint32_t hits, misses;
+        function_memo_stats(it, hits, misses);
+
+        char line[80];
+        snprintf(line, sizeof(line), "  %s: %d entries, %lu hits, %lu misses\n",
+            function_name(it), size, (unsigned long)hits, (unsigned long)misses);
+        calc_puts(line);
+        any = true;
+    }
+
+    if (!any)
+        calc_puts("no user funcs are memoized\n");
+
+    return true;
+}
+
+// digits ::= "digits" [number | "shortest"]
+bool cmd_digits(ParseCtx& ctx)
+{
+    if (peek(ctx, Token::Number))
+    {
+        const double num = expect_number(ctx);
+        if ((num < 1.0) || (num > kMaxFormatDigits))
+        {
+            on_parse_error(ctx, "expected 1 to 17 digits");
+            return false;
+        }
+        set_format_digits(int(num));
+    }
+    else if (peek(ctx, Token::Symbol))
+    {
+        char option[kMaxSymbolLength+1];
+        expect_symbol(ctx, option);
+        if (strcmp(option, "shortest") != 0)
+        {
+            on_parse_error(ctx, "expected a number of digits or shortest");
+            return false;
+        }
+        set_format_digits(kShortestDigits);
+    }
+
+    const int digits = format_digits();
+    if (digits == kShortestDigits)
+    {
+        calc_puts("shortest digits that read back exactly\n");
+    }
+    else
+    {
+        char line[40];
+        snprintf(line, sizeof(line), "%d significant digits\n", digits);
+        calc_puts(line);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+
 void init_commands()
 {
-    gRegisteredCommands = 0;
+    CommandsState& state = cmd_state();
+
+    state.NumCommands = 0;
+    state.CommandIx = IdIndex();
 
     register_calc_cmd(cmd_help, "help", "help [command]", "shows help");
     register_calc_cmd(cmd_list, "list", "list", "lists definitions");
+    register_calc_cmd(cmd_stats, "stats", "stats", "shows compiler and eval counters");
+    register_calc_cmd(cmd_memo, "memo", "memo [func [on | off | clear | size]]", "caches user func results");
+    register_calc_cmd(cmd_digits, "digits", "digits [count | shortest]", "sets how many digits results show");
 }
 
 //-------------------------------------------------------------------------------------------------
 
+void register_calc_cmd(CalcContext* calc, calc_cmd_func func, const char* name, const char* usage, const char* help)
+{
+    if (!calc)
+        return;
+
+    ContextScope scope(calc);
+    register_calc_cmd(func, name, usage, help);
+}
+
 void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage, const char* help)
 {
-    if (gRegisteredCommands >= kMaxCommands)
+    CommandsState& state = cmd_state();
+
+    if (state.NumCommands >= kMaxCommands)
         return;
 
-    CommandDef* cmd = gCommands + gRegisteredCommands;
+    const SymId id = intern(name);
+    if (id == kNoSymId)
+        return;
+
+    CommandDef* cmd = state.Commands + state.NumCommands;
     cmd->Name = name;
     cmd->Usage = usage;
     cmd->Help = help;
     cmd->Func = func;
     cmd->PFunc = nullptr;
 
-    ++gRegisteredCommands;
+    if (state.CommandIx.Find(id) < 0)
+        state.CommandIx.Set(id, state.NumCommands);
+    ++state.NumCommands;
 }
 
 void register_calc_cmd(calc_cmd_parser_func func, const char* name, const char* usage, const char* help)
 {
-    if (gRegisteredCommands >= kMaxCommands)
+    CommandsState& state = cmd_state();
+
+    if (state.NumCommands >= kMaxCommands)
         return;
 
-    CommandDef* cmd = gCommands + gRegisteredCommands;
+    const SymId id = intern(name);
+    if (id == kNoSymId)
+        return;
+
+    CommandDef* cmd = state.Commands + state.NumCommands;
     cmd->Name = name;
     cmd->Usage = usage;
     cmd->Help = help;
     cmd->Func = nullptr;
     cmd->PFunc = func;
 
-    ++gRegisteredCommands;
+    if (state.CommandIx.Find(id) < 0)
+        state.CommandIx.Set(id, state.NumCommands);
+    ++state.NumCommands;
 }
 
 //-------------------------------------------------------------------------------------------------
 
-const CommandDef* lookup_command(const char* name)
+const CommandDef* lookup_command(SymId name)
 {
-    const CommandDef* cmd = gCommands;
-    for (int i=0; i<gRegisteredCommands; ++i, ++cmd)
-    {
-        if (strcmp(cmd->Name, name) == 0)
-            return cmd;
-    }
+    CommandsState& state = cmd_state();
+
+    const int ix = state.CommandIx.Find(name);
+    if (ix < 0)
+        return nullptr;
 
-    return nullptr;
+    return state.Commands + ix;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "intern.h"
 #include "libcalc.h"
 
 //-------------------------------------------------------------------------------------------------
@@ -23,12 +24,30 @@ struct CommandDef
 
 //-------------------------------------------------------------------------------------------------
 
+struct CommandsState;
+CommandsState* create_commands_state();
+void destroy_commands_state(CommandsState* state);
+
 void init_commands();
 
+// these add to the current context
 void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage, const char* help);
 void register_calc_cmd(calc_cmd_parser_func func, const char* name, const char* usage, const char* help);
 
-const CommandDef* lookup_command(const char* name);
+const CommandDef* lookup_command(SymId name);
+
+//-------------------------------------------------------------------------------------------------
+
+// what calc_eval has been given so far, for stats
+struct EvalStats
+{
+    uint32_t Definitions = 0;
+    uint32_t Commands = 0;
+    uint32_t Expressions = 0;
+    uint64_t Nanos = 0;     // spent in calc_eval, where there's a clock to tell
+};
+
+const EvalStats& eval_stats();
 
 //-------------------------------------------------------------------------------------------------
 
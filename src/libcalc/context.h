@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cmd.h"
+#include "format.h"
+#include "libcalc.h"
+#include "platform.h"
+#include "simplify.h"
+
+//-------------------------------------------------------------------------------------------------
+
+// the state of modules with types of their own is kept in the module, and made and freed by it
+struct AstState;
+struct CellsState;
+struct CommandsState;
+struct DepsState;
+struct ExprState;
+struct FunctionsState;
+struct InternState;
+struct ParserState;
+struct SymbolsState;
+
+// everything one calculator knows. nothing is shared between contexts, and the code works on
+// whichever one is current on its thread, which calc_eval and the other entry points set up
+struct CalcContext
+{
+    calc_puts_func Puts = nullptr;
+    void* PutsUser = nullptr;
+
+    InternState* Intern = nullptr;
+    ParserState* Parser = nullptr;
+    AstState* Ast = nullptr;
+    ExprState* Expr = nullptr;
+    SymbolsState* Symbols = nullptr;
+    FunctionsState* Functions = nullptr;
+    CellsState* Cells = nullptr;
+    DepsState* Deps = nullptr;
+    CommandsState* Commands = nullptr;
+
+    Plot PlotBuf;
+    const Plot* ActivePlot = nullptr;   // null until something is drawn in PlotBuf
+
+    int FormatDigits = kDefaultDigits;
+    bool JitEnabled = false;
+
+    SimplifyStats Simplify;
+    EvalStats Eval;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+extern MLN_THREAD_LOCAL CalcContext* gCurrentContext;
+
+inline CalcContext& calc_context()
+{
+    return *gCurrentContext;
+}
+
+// makes ctx current until it goes out of scope. they can be nested, eg. a command evaluating
+// something in another context
+class ContextScope
+{
+    ContextScope(const ContextScope&) = delete;
+    ContextScope& operator=(const ContextScope&) = delete;
+
+public:
+    explicit ContextScope(CalcContext* ctx) : mPrev(gCurrentContext) { gCurrentContext = ctx; }
+    ~ContextScope() { gCurrentContext = mPrev; }
+
+private:
+    CalcContext* mPrev;
+};
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,180 @@
+#include "deps.h"
+
+#include "cells.h"
+#include "context.h"
+#include "funcs.h"
+
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------------------
+
+// the graph is kept both ways round: Uses to undo a definition's edges when it's replaced, and
+// UsedBy to find what's downstream of a change
+struct DepNode
+{
+    SymId Name = kNoSymId;
+
+    std::vector<SymId> Uses;
+    std::vector<SymId> UsedBy;
+
+    // set to the walk's VisitMark when a walk reaches the node, and when it's found to have changed
+    uint32_t VisitMark = 0;
+    uint32_t ChangedMark = 0;
+};
+
+struct DepsState
+{
+    std::vector<DepNode> Nodes;
+    IdIndex NodeIx;
+
+    uint32_t VisitMark = 0;
+};
+
+DepsState* create_deps_state()
+{
+    return new DepsState;
+}
+
+void destroy_deps_state(DepsState* state)
+{
+    delete state;
+}
+
+static DepsState& deps_state()
+{
+    return *calc_context().Deps;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void init_deps()
+{
+    DepsState& state = deps_state();
+
+    state.Nodes.clear();
+    state.NodeIx = IdIndex();
+    state.VisitMark = 0;
+}
+
+static DepNode& find_or_add_node(SymId name)
+{
+    DepsState& state = deps_state();
+
+    int ix = state.NodeIx.Find(name);
+    if (ix < 0)
+    {
+        ix = int(state.Nodes.size());
+        state.NodeIx.Set(name, ix);
+        state.Nodes.emplace_back();
+        state.Nodes.back().Name = name;
+    }
+    return state.Nodes[ix];
+}
+
+void set_uses(SymId name, const std::vector<SymId>& uses)
+{
+    // these ids are held on to past the statement
+    keep_interned_names();
+
+    // find_or_add_node can move the nodes, so nothing is held across calls to it
+    const std::vector<SymId> oldUses = find_or_add_node(name).Uses;
+    for (SymId used : oldUses)
+    {
+        std::vector<SymId>& usedBy = find_or_add_node(used).UsedBy;
+        usedBy.erase(std::remove(usedBy.begin(), usedBy.end(), name), usedBy.end());
+    }
+
+    for (SymId used : uses)
+        find_or_add_node(used).UsedBy.push_back(name);
+
+    find_or_add_node(name).Uses = uses;
+}
+
+// depth first through the users, so each one is added after everything downstream of it
+static void add_users_post_order(int ix, std::vector<int>& outOrder)
+{
+    DepsState& state = deps_state();
+
+    DepNode& node = state.Nodes[ix];
+    if (node.VisitMark == state.VisitMark)
+        return;
+    node.VisitMark = state.VisitMark;
+
+    for (SymId user : node.UsedBy)
+        add_users_post_order(state.NodeIx.Find(user), outOrder);
+
+    outOrder.push_back(ix);
+}
+
+static bool any_use_changed(const DepNode& node, uint32_t mark)
+{
+    DepsState& state = deps_state();
+
+    for (SymId used : node.Uses)
+    {
+        if (state.Nodes[state.NodeIx.Find(used)].ChangedMark == mark)
+            return true;
+    }
+    return false;
+}
+
+void definition_changed(SymId name)
+{
+    DepsState& state = deps_state();
+
+    const int startIx = state.NodeIx.Find(name);
+    if (startIx < 0)
+        return;
+
+    ++state.VisitMark;
+    const uint32_t mark = state.VisitMark;
+
+    std::vector<int> order;
+    add_users_post_order(startIx, order);
+
+    // backwards, that's everything before its users, starting with name itself
+    state.Nodes[startIx].ChangedMark = mark;
+    for (int i = int(order.size()) - 2; i >= 0; --i)
+    {
+        const int ix = order[i];
+        if (!any_use_changed(state.Nodes[ix], mark))
+            continue;
+
+        // recomputing a cell can recompile functions, which adds nodes, so no references are
+        // kept across it
+        const SymId name = state.Nodes[ix].Name;
+        bool changed = true;
+        if (!recompute_cell(name, changed))
+            mark_function_stale(name);
+
+        if (changed)
+            state.Nodes[ix].ChangedMark = mark;
+    }
+}
+
+bool uses_reach(const std::vector<SymId>& uses, SymId name)
+{
+    DepsState& state = deps_state();
+
+    ++state.VisitMark;
+
+    std::vector<SymId> pending = uses;
+    while (!pending.empty())
+    {
+        const SymId used = pending.back();
+        pending.pop_back();
+        if (used == name)
+            return true;
+
+        const int ix = state.NodeIx.Find(used);
+        if ((ix < 0) || (state.Nodes[ix].VisitMark == state.VisitMark))
+            continue;
+        state.Nodes[ix].VisitMark = state.VisitMark;
+
+        pending.insert(pending.end(), state.Nodes[ix].Uses.begin(), state.Nodes[ix].Uses.end());
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "intern.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+// which user definitions refer to which. a function uses every user name in its body, including
+// the ones in bodies it inlined, and a cell uses every name in its expression. when a name
+// changes, everything that uses it, directly or not, is brought up to date: functions are marked
+// stale and recompiled the next time they're needed, and cells are recomputed straight away
+struct DepsState;
+DepsState* create_deps_state();
+void destroy_deps_state(DepsState* state);
+
+void init_deps();
+
+// replaces the names that name's definition uses
+void set_uses(SymId name, const std::vector<SymId>& uses);
+
+// updates every definition downstream of name, in dependency order, skipping any whose inputs
+// turned out not to change. name itself isn't touched
+void definition_changed(SymId name);
+
+// true if name is one of uses, or something any of them uses, directly or not
+bool uses_reach(const std::vector<SymId>& uses, SymId name);
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,457 @@
+#include "deriv.h"
+
+#include "ast.h"
+#include "expr.h"
+#include "format.h"
+#include "funcs.h"
+#include "parser.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+// the derivative is built as a tree and written back out as text, which define_function compiles
+// like anything typed in
+
+//-------------------------------------------------------------------------------------------------
+
+// these build nodes, doing away with the 0s and 1s the rules leave lying about. constants are
+// worked out the same way running them would. as usual for derivatives, anything times 0 is
+// taken to be 0, even where it isn't finite
+
+static bool is_const(const Node* node, double val)
+{
+    return (node->Kind == NodeKind::Const) && (node->Value == val);
+}
+
+static bool both_const(const Node* a, const Node* b)
+{
+    return (a->Kind == NodeKind::Const) && (b->Kind == NodeKind::Const);
+}
+
+static bool is_negative(const Node* node)
+{
+    return (node->Kind == NodeKind::Const) && (node->Value < 0.0);
+}
+
+static Node* make_neg(Node* a)
+{
+    if (a->Kind == NodeKind::Const)
+        return new_const(-a->Value);
+    if (a->Kind == NodeKind::Neg)
+        return a->A;
+    return new_node(NodeKind::Neg, a);
+}
+
+static Node* make_sub(Node* a, Node* b);
+
+static Node* make_add(Node* a, Node* b)
+{
+    if (is_const(a, 0.0))
+        return b;
+    if (is_const(b, 0.0))
+        return a;
+    if (both_const(a, b))
+        return new_const(a->Value + b->Value);
+    if (b->Kind == NodeKind::Neg)
+        return make_sub(a, b->A);
+    if (is_negative(b))
+        return make_sub(a, new_const(-b->Value));
+    return new_node(NodeKind::Add, a, b);
+}
+
+static Node* make_sub(Node* a, Node* b)
+{
+    if (is_const(b, 0.0))
+        return a;
+    if (is_const(a, 0.0))
+        return make_neg(b);
+    if (both_const(a, b))
+        return new_const(a->Value - b->Value);
+    if (b->Kind == NodeKind::Neg)
+        return make_add(a, b->A);
+    if (is_negative(b))
+        return make_add(a, new_const(-b->Value));
+    return new_node(NodeKind::Sub, a, b);
+}
+
+// signs are pulled out to the front, and constants go on the left
+static Node* make_mul(Node* a, Node* b)
+{
+    if (is_const(a, 0.0) || is_const(b, 0.0))
+        return new_const(0.0);
+    if (is_const(a, 1.0))
+        return b;
+    if (is_const(b, 1.0))
+        return a;
+    if (both_const(a, b))
+        return new_const(a->Value * b->Value);
+    if (b->Kind == NodeKind::Const)
+        return make_mul(b, a);
+    if (a->Kind == NodeKind::Neg)
+        return make_neg(make_mul(a->A, b));
+    if (b->Kind == NodeKind::Neg)
+        return make_neg(make_mul(a, b->A));
+    return new_node(NodeKind::Mul, a, b);
+}
+
+static Node* make_div(Node* a, Node* b)
+{
+    if (is_const(a, 0.0))
+        return new_const(0.0);
+    if (is_const(b, 1.0))
+        return a;
+    if (both_const(a, b))
+        return new_const(a->Value / b->Value);
+    if (a->Kind == NodeKind::Neg)
+        return make_neg(make_div(a->A, b));
+    if (b->Kind == NodeKind::Neg)
+        return make_neg(make_div(a, b->A));
+    return new_node(NodeKind::Div, a, b);
+}
+
+static Node* make_pow(Node* a, Node* b)
+{
+    if (is_const(b, 0.0))
+        return new_const(1.0);
+    if (is_const(b, 1.0))
+        return a;
+    if (both_const(a, b))
+        return new_const(pow(a->Value, b->Value));
+    return new_node(NodeKind::Pow, a, b);
+}
+
+static Node* make_ln(Node* a)
+{
+    Node* node = new_node(NodeKind::Call, a);
+    node->BuiltinIx = uint8_t(find_builtin_func(find_interned("ln")));
+    return node;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the derivative of node with respect to the arg, given its children's. returns null on errors
+static Node* differentiate_node(Node* node, Node* da, Node* db, ParseCtx& ctx)
+{
+    Node* a = node->A;
+    Node* b = node->B;
+
+    switch (node->Kind)
+    {
+    case NodeKind::Const:
+    case NodeKind::Sym:
+        return new_const(0.0);
+
+    case NodeKind::Arg:
+        return new_const(1.0);
+
+    case NodeKind::Call:
+    {
+        // registered builtins don't come with one, so theirs is worked out when it's run
+        const char* slopeDef = builtin_func_slope(node->BuiltinIx);
+        if (!slopeDef)
+        {
+            Node* slope = new_node(NodeKind::Deriv, a);
+            slope->Name = intern(builtin_func_name(node->BuiltinIx));
+            return make_mul(slope, da);
+        }
+
+        Node* slope = parse_function_body(slopeDef, intern("x"), a, ctx);
+        return slope ? make_mul(slope, da) : nullptr;
+    }
+
+    case NodeKind::CallUser:
+    {
+        Node* slope = new_node(NodeKind::Deriv, a);
+        slope->Name = node->Name;
+        slope->Pos = node->Pos;
+        return make_mul(slope, da);
+    }
+
+    case NodeKind::Deriv:
+        on_parse_error(ctx, "can't differentiate d()");
+        return nullptr;
+
+    case NodeKind::Neg:     return make_neg(da);
+    case NodeKind::Add:     return make_add(da, db);
+    case NodeKind::Sub:     return make_sub(da, db);
+
+    case NodeKind::Mul:
+        return make_add(make_mul(da, b), make_mul(a, db));
+
+    case NodeKind::Div:
+        if (is_const(db, 0.0))
+            return make_div(da, b);
+        return make_div(make_sub(make_mul(da, b), make_mul(a, db)), make_pow(b, new_const(2.0)));
+
+    case NodeKind::Pow:
+        // a^b with b not changing is the usual b a^(b-1), and with a not changing it's
+        // a^b ln(a). otherwise it's both
+        if (is_const(db, 0.0))
+            return make_mul(make_mul(b, make_pow(a, make_sub(b, new_const(1.0)))), da);
+        if (is_const(da, 0.0))
+            return make_mul(make_mul(node, make_ln(a)), db);
+        return make_mul(node, make_add(make_mul(db, make_ln(a)), make_div(make_mul(b, da), a)));
+
+    case NodeKind::Fact:
+        if (is_const(da, 0.0))
+            return new_const(0.0);
+        on_parse_error(ctx, "can't differentiate a factorial");
+        return nullptr;
+    }
+
+    on_parse_error(ctx, "corrupt expression");
+    return nullptr;
+}
+
+// children first, A before B, so errors come out in the order they're written
+static Node* differentiate(Node* root, ParseCtx& ctx)
+{
+    std::vector<Node*> slopes;  // of the children not yet used
+
+    TreeWalk walk;
+    walk.push(root);
+
+    WalkStep step;
+    while (walk.pop(step))
+    {
+        Node* node = step.At;
+        if (step.Tag == 0)
+        {
+            walk.push(node, nullptr, 1);
+            if (node->B)
+                walk.push(node->B);
+            if (node->A)
+                walk.push(node->A);
+            continue;
+        }
+
+        Node* db = nullptr;
+        Node* da = nullptr;
+        if (node->B)
+        {
+            db = slopes.back();
+            slopes.pop_back();
+        }
+        if (node->A)
+        {
+            da = slopes.back();
+            slopes.pop_back();
+        }
+
+        Node* slope = differentiate_node(node, da, db, ctx);
+        if (!slope)
+            return nullptr;
+        slopes.push_back(slope);
+    }
+
+    return slopes.back();
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the tree is written with the fewest brackets that parse back to the same thing, and every
+// multiply spelled out so none of the implicit multiply rules come into it
+enum Prec
+{
+    kPrecAdd = 1,
+    kPrecMul,
+    kPrecUnary,
+    kPrecExponent,
+    kPrecPostfix,
+};
+
+struct DerivText
+{
+    std::string Text;
+    SymId Arg = kNoSymId;
+};
+
+static void put(DerivText& out, const char* str)
+{
+    out.Text += str;
+}
+
+// the shortest that reads back as exactly val
+static void put_number(DerivText& out, double val)
+{
+    if (!std::isfinite(val))
+    {
+        put(out, (val != val) ? "(0/0)" : (val > 0.0) ? "(1/0)" : "(-1/0)");
+        return;
+    }
+
+    char buf[32];
+    dtostr_shortest(fabs(val), buf, sizeof(buf));
+
+    if (std::signbit(val))
+    {
+        put(out, "(-");
+        put(out, buf);
+        put(out, ")");
+    }
+    else
+    {
+        put(out, buf);
+    }
+}
+
+static int prec_of(const Node* node)
+{
+    switch (node->Kind)
+    {
+    case NodeKind::Add:
+    case NodeKind::Sub:
+        return kPrecAdd;
+
+    case NodeKind::Mul:
+    case NodeKind::Div:
+        return kPrecMul;
+
+    // -a * b reads as (-a) * b, which comes to the same
+    case NodeKind::Neg:
+        return ((node->A->Kind == NodeKind::Mul) || (node->A->Kind == NodeKind::Div)) ? kPrecMul : kPrecUnary;
+
+    case NodeKind::Pow:
+        return kPrecExponent;
+
+    default:
+        return kPrecPostfix;
+    }
+}
+
+// what's still to be written: a node, or else some text
+struct PutStep
+{
+    const Node* At = nullptr;
+    int MinPrec = 0;
+    const char* Text = nullptr;
+};
+
+static void put_node(DerivText& out, const Node* root, int rootPrec)
+{
+    static const char* const kInfixOps[] = { " + ", " - ", " * ", " / " };
+
+    std::vector<PutStep> steps;
+    steps.push_back({ .At = root, .MinPrec = rootPrec });
+
+    while (!steps.empty())
+    {
+        const PutStep step = steps.back();
+        steps.pop_back();
+
+        if (step.Text)
+        {
+            put(out, step.Text);
+            continue;
+        }
+
+        // what's left of this node, in the order it's written
+        PutStep rest[3];
+        int numRest = 0;
+
+        const Node* node = step.At;
+        const int prec = prec_of(node);
+        if (prec < step.MinPrec)
+        {
+            put(out, "(");
+            rest[numRest++] = { .At = node, .MinPrec = kPrecAdd };
+            rest[numRest++] = { .Text = ")" };
+        }
+        else switch (node->Kind)
+        {
+        case NodeKind::Const:
+            put_number(out, node->Value);
+            break;
+
+        case NodeKind::Arg:
+            put(out, interned_name(out.Arg));
+            break;
+
+        case NodeKind::Sym:
+            put(out, interned_name(node->Name));
+            break;
+
+        case NodeKind::Call:
+        case NodeKind::CallUser:
+            put(out, (node->Kind == NodeKind::Call) ? builtin_func_name(node->BuiltinIx) : interned_name(node->Name));
+            put(out, "(");
+            rest[numRest++] = { .At = node->A, .MinPrec = kPrecAdd };
+            rest[numRest++] = { .Text = ")" };
+            break;
+
+        case NodeKind::Deriv:
+            put(out, "d(");
+            put(out, interned_name(node->Name));
+            put(out, ", ");
+            rest[numRest++] = { .At = node->A, .MinPrec = kPrecAdd };
+            rest[numRest++] = { .Text = ")" };
+            break;
+
+        case NodeKind::Neg:
+            put(out, "-");
+            rest[numRest++] = { .At = node->A, .MinPrec = (node->A->Kind == NodeKind::Neg) ? int(kPrecPostfix) : prec };
+            break;
+
+        case NodeKind::Add:
+        case NodeKind::Sub:
+        case NodeKind::Mul:
+        case NodeKind::Div:
+            rest[numRest++] = { .At = node->A, .MinPrec = prec };
+            rest[numRest++] = { .Text = kInfixOps[int(node->Kind) - int(NodeKind::Add)] };
+            rest[numRest++] = { .At = node->B, .MinPrec = prec + 1 };
+            break;
+
+        case NodeKind::Pow:
+            rest[numRest++] = { .At = node->A, .MinPrec = kPrecPostfix };
+            rest[numRest++] = { .Text = "^" };
+            rest[numRest++] = { .At = node->B, .MinPrec = kPrecPostfix };
+            break;
+
+        case NodeKind::Fact:
+            rest[numRest++] = { .At = node->A, .MinPrec = kPrecPostfix };
+            rest[numRest++] = { .Text = "!" };
+            break;
+        }
+
+        while (numRest > 0)
+            steps.push_back(rest[--numRest]);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+bool define_derivative(SymId name, SymId func, ParseCtx& ctx)
+{
+    const UserFunction* f = lookup_user_func(func);
+    if (!f)
+    {
+        on_parse_error(ctx, "unknown user function");
+        return false;
+    }
+
+    Node* body = parse_function_body(function_def(f), function_arg(f), nullptr, ctx);
+    if (!body)
+        return false;
+
+    Node* slope = differentiate(body, ctx);
+    if (!slope)
+        return false;
+
+    DerivText out;
+    out.Arg = function_arg(f);
+    put_node(out, slope, kPrecAdd);
+
+    ParseCtx defCtx { .InBuffer = out.Text.c_str(), .ResBuffer = ctx.ResBuffer, .ResBufferLen = ctx.ResBufferLen };
+    if (!define_function(name, function_arg(f), defCtx))
+    {
+        ctx.Error = true;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "intern.h"
+
+//-------------------------------------------------------------------------------------------------
+
+struct ParseCtx;
+
+//-------------------------------------------------------------------------------------------------
+
+// "df = deriv f" works out f's derivative from its definition, tidies it up and defines it as the
+// user function df, with the same arg. df is then an ordinary function, so it's compiled, batched
+// and JITed like any other, rather than being differentiated again every time it's run
+//
+// df is made from f's definition as it is now, and is left alone if f is redefined later. calls
+// to other user functions become d(g, u) * u', which keeps following g
+bool define_derivative(SymId name, SymId func, ParseCtx& ctx);
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,219 @@
+#include "dual.h"
+
+#include "bytecode.h"
+#include "funcs.h"
+#include "maths.h"
+#include "symbols.h"
+
+#include <cmath>
+#include <cstdio>
+
+//-------------------------------------------------------------------------------------------------
+
+// chain rule. something that doesn't depend on the arg stays that way, even where the function
+// has an infinite slope
+static Dual chain(double val, double slope, double inDeriv)
+{
+    return { .Val = val, .Deriv = (inDeriv == 0.0) ? 0.0 : slope * inDeriv };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Dual dsin(const Dual& in)
+{
+    return chain(sin(in.Val), cos(in.Val), in.Deriv);
+}
+
+Dual dcos(const Dual& in)
+{
+    return chain(cos(in.Val), -sin(in.Val), in.Deriv);
+}
+
+Dual dtan(const Dual& in)
+{
+    const double val = tan(in.Val);
+    return chain(val, 1.0 + val*val, in.Deriv);
+}
+
+Dual dsinc(const Dual& in)
+{
+    const double val = sinc(in.Val);
+    const double slope = (in.Val == 0.0) ? 0.0 : (cos(in.Val) - val) / in.Val;
+    return chain(val, slope, in.Deriv);
+}
+
+Dual dasin(const Dual& in)
+{
+    return chain(asin(in.Val), 1.0 / sqrt(1.0 - in.Val*in.Val), in.Deriv);
+}
+
+Dual dacos(const Dual& in)
+{
+    return chain(acos(in.Val), -1.0 / sqrt(1.0 - in.Val*in.Val), in.Deriv);
+}
+
+Dual datan(const Dual& in)
+{
+    return chain(atan(in.Val), 1.0 / (1.0 + in.Val*in.Val), in.Deriv);
+}
+
+Dual dln(const Dual& in)
+{
+    return chain(log(in.Val), 1.0 / in.Val, in.Deriv);
+}
+
+Dual dlog10(const Dual& in)
+{
+    return chain(log10(in.Val), 1.0 / (in.Val * log(10.0)), in.Deriv);
+}
+
+Dual dsqrt(const Dual& in)
+{
+    const double val = sqrt(in.Val);
+    return chain(val, 0.5 / val, in.Deriv);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static Dual dmul(const Dual& a, const Dual& b)
+{
+    return { .Val = a.Val * b.Val, .Deriv = a.Deriv * b.Val + a.Val * b.Deriv };
+}
+
+static Dual ddiv(const Dual& a, const Dual& b)
+{
+    const double val = a.Val / b.Val;
+    return { .Val = val, .Deriv = (a.Deriv - val * b.Deriv) / b.Val };
+}
+
+// the two halves are kept apart so a constant exponent doesn't need the log of the base, which
+// is nan for negative bases
+static Dual dpow(const Dual& a, const Dual& b)
+{
+    const double val = std::pow(a.Val, b.Val);
+
+    double deriv = 0.0;
+    if (a.Deriv != 0.0)
+        deriv += b.Val * std::pow(a.Val, b.Val - 1.0) * a.Deriv;
+    if (b.Deriv != 0.0)
+        deriv += val * log(a.Val) * b.Deriv;
+
+    return { .Val = val, .Deriv = deriv };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+bool run_program_dual(const Program& prog, const Dual& arg, Dual& outVal, ParseCtx& ctx)
+{
+    char errBuf[20+kMaxSymbolLength+1];
+
+    Dual localStack[kMaxProgramStack];
+    std::vector<Dual> bigStack;
+    Dual* stack = localStack;
+    if (prog.MaxDepth > kMaxProgramStack)
+    {
+        bigStack.resize(prog.MaxDepth);
+        stack = bigStack.data();
+    }
+
+    Dual* top = stack - 1;
+    Dual temps[kMaxProgramTemps];
+
+    const Instr* in = prog.Code.data();
+    const Instr* inEnd = in + prog.Code.size();
+    for (; in != inEnd; ++in)
+    {
+        switch (in->Code)
+        {
+        case Op::Const:
+            *(++top) = { .Val = prog.Consts[in->Operand] };
+            break;
+
+        case Op::Arg:
+            *(++top) = arg;
+            break;
+
+        case Op::Sym:
+        {
+            double val;
+            if (!eval_named_value(prog.Names[in->Operand], val))
+            {
+                sprintf(errBuf, "unknown named val: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            *(++top) = { .Val = val };
+            break;
+        }
+
+        case Op::Dup:
+            ++top;
+            *top = top[-1];
+            break;
+
+        case Op::Load:
+            *(++top) = temps[in->Operand];
+            break;
+
+        case Op::Store:
+            temps[in->Operand] = *top;
+            break;
+
+        case Op::Call:
+            *top = call_builtin_func_dual(in->Operand, *top);
+            break;
+
+        case Op::CallUser:
+            if (!eval_function_dual(prog.Names[in->Operand], *top, *top, ctx))
+            {
+                if (ctx.Error)
+                    return false;
+
+                sprintf(errBuf, "unknown func: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            break;
+
+        case Op::Deriv:
+            on_run_error(ctx, prog.Sites[in - prog.Code.data()], "can't differentiate a derivative");
+            return false;
+
+        case Op::Neg:
+            *top = { .Val = -top->Val, .Deriv = -top->Deriv };
+            break;
+
+        case Op::Add:   --top;  *top = { .Val = top[0].Val + top[1].Val, .Deriv = top[0].Deriv + top[1].Deriv };   break;
+        case Op::Sub:   --top;  *top = { .Val = top[0].Val - top[1].Val, .Deriv = top[0].Deriv - top[1].Deriv };   break;
+        case Op::Mul:   --top;  *top = dmul(top[0], top[1]);    break;
+        case Op::Div:   --top;  *top = ddiv(top[0], top[1]);    break;
+        case Op::Pow:   --top;  *top = dpow(top[0], top[1]);    break;
+
+        case Op::Fact:
+            // only defined on whole numbers, so it has no slope anywhere
+            if (!compute_factorial(top->Val))
+            {
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], "need a positive integer");
+                return false;
+            }
+            if (top->Deriv != 0.0)
+                top->Deriv = NAN;
+            break;
+
+        default:
+            on_parse_error(ctx, "corrupt program");
+            return false;
+        }
+    }
+
+    if (top != stack)
+    {
+        on_parse_error(ctx, "corrupt program");
+        return false;
+    }
+
+    outVal = *top;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "parser.h"
+
+//-------------------------------------------------------------------------------------------------
+
+struct Program;
+
+// a value and its derivative with respect to the function's arg, which are worked out together.
+// the derivative is exact in the same way the value is, just rounded at each step
+struct Dual
+{
+    double Val = 0.0;
+    double Deriv = 0.0;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+// dual number versions of the builtin maths functions
+typedef Dual (*CalcDualFn)(const Dual& in);
+
+Dual dsin(const Dual& in);
+Dual dcos(const Dual& in);
+Dual dtan(const Dual& in);
+Dual dsinc(const Dual& in);
+Dual dasin(const Dual& in);
+Dual dacos(const Dual& in);
+Dual datan(const Dual& in);
+Dual dln(const Dual& in);
+Dual dlog10(const Dual& in);
+Dual dsqrt(const Dual& in);
+
+//-------------------------------------------------------------------------------------------------
+
+// runs the program once, giving the same value as run_program along with its derivative. it fails
+// in the same ways run_program does, and on a derivative of a derivative
+bool run_program_dual(const Program& prog, const Dual& arg, Dual& outVal, ParseCtx& ctx);
+
+//-------------------------------------------------------------------------------------------------
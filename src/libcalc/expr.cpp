@@ -1,183 +1,647 @@
 #include "expr.h"
 
+#include "ast.h"
+#include "bytecode.h"
+#include "context.h"
 #include "funcs.h"
 #include "maths.h"
 #include "parser.h"
+#include "simplify.h"
 #include "symbols.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
-#include <cstring>
+#include <deque>
 
 //-------------------------------------------------------------------------------------------------
 
-// primary = number | "(" expression ")"
-double parse_primary(ParseCtx& ctx)
+// the parser builds a tree, which is folded and then emitted as a Program. when LateBind is set
+// we're compiling a function body: names that don't exist yet are left to be looked up when the
+// program is run, and the tree is simplified and has its repeats shared, since it'll be run many
+// times
+
+// function bodies also have calls to small user functions replaced by the callee's body, with the
+// callee's arg standing for the caller's arg expression. an arg that's used more than once gets
+// walked once per use by fold_constants and simplify_tree, so the budget limits how much bigger
+// the tree can get that way
+constexpr int kMaxInlineNodes = 32;
+constexpr int kMaxInlineDepth = 4;
+constexpr int kInlineBudget = 128;
+
+struct InlineState
 {
-    if (accept(ctx, Token::LParen))
+    // the functions being compiled, outermost first. calls to these are never inlined
+    SymId Stack[kMaxInlineDepth + 1];
+    int Depth = 0;
+
+    int Budget = kInlineBudget;
+
+    std::vector<SymId>* Uses = nullptr;
+};
+
+struct CompileCtx
+{
+    bool LateBind;
+    SymId Arg = kNoSymId;
+
+    // set when parsing an inlined body, where the arg is the caller's expression
+    Node* ArgValue = nullptr;
+    int ArgUses = 0;
+
+    InlineState* Inline = nullptr;
+
+    // the user function whose definition is being parsed, for SourcePos
+    SymId Text = kNoSymId;
+};
+
+static Node* parse_tree(ParseCtx& ctx, CompileCtx& cc);
+
+//-------------------------------------------------------------------------------------------------
+
+// counts the nodes in a tree, giving up once there are more than limit
+static int count_nodes(Node* root, int limit)
+{
+    int count = 0;
+
+    TreeWalk walk;
+    walk.push(root);
+
+    WalkStep step;
+    while ((count <= limit) && walk.pop(step))
     {
-        double val = parse_expression(ctx);
-        expect(ctx, Token::RParen);
-        return val;
+        if (!step.At)
+            continue;
+
+        ++count;
+        walk.push(step.At->B);
+        walk.push(step.At->A);
     }
 
-    if (accept(ctx, Token::Minus))
+    return count;
+}
+
+// remembers that the body depends on a user name, so it can be recompiled when that changes
+static void note_use(CompileCtx& cc, SymId name)
+{
+    std::vector<SymId>* uses = cc.Inline ? cc.Inline->Uses : nullptr;
+    if (uses && (std::find(uses->begin(), uses->end(), name) == uses->end()))
+        uses->push_back(name);
+}
+
+// parses the body of user function callee with arg standing for its arg. returns null if the
+// call should be left as a call
+static Node* inline_call(SymId callee, Node* arg, CompileCtx& cc)
+{
+    InlineState* state = cc.Inline;
+    if (!state)
+        return nullptr;
+
+    note_use(cc, callee);
+
+    if (state->Depth > kMaxInlineDepth)
+        return nullptr;
+    for (int i = 0; i < state->Depth; ++i)
     {
-        return -expect_number(ctx);
+        if (state->Stack[i] == callee)
+            return nullptr;
     }
 
-    return expect_number(ctx);
+    const UserFunction* func = lookup_user_func(callee);
+    if (!func)
+        return nullptr;
+
+    char errBuf[64];
+    ParseCtx sub { .InBuffer = function_def(func), .ResBuffer = errBuf, .ResBufferLen = sizeof(errBuf) };
+    CompileCtx subCc { .LateBind = true, .Arg = function_arg(func), .ArgValue = arg, .Inline = state,
+                       .Text = callee };
+
+    const uint32_t nodesBefore = ast_stats().NodesBuilt;
+
+    state->Stack[state->Depth++] = callee;
+    advance_token(sub);
+    Node* body = parse_tree(sub, subCc);
+    --state->Depth;
+
+    if (sub.Error || !accept(sub, Token::Eof))
+        return nullptr;
+
+    const int bodyNodes = int(ast_stats().NodesBuilt - nodesBefore);
+    const int growth = bodyNodes + subCc.ArgUses * count_nodes(arg, state->Budget);
+    if ((bodyNodes > kMaxInlineNodes) || (growth > state->Budget))
+        return nullptr;
+
+    state->Budget -= growth;
+    return body;
 }
 
-// postfix ::= primary | primary "!" | symbol "(" expression ")" | symbol
-double parse_postfix(ParseCtx& ctx)
+//-------------------------------------------------------------------------------------------------
+
+// the grammar, loosest first:
+//
+//   add      ::= mul | add "+" mul | add "-" mul
+//   mul      ::= unary | mul "*" unary | mul "/" unary | unary mul
+//   unary    ::= exponent | "+" unary | "-" unary
+//   exponent ::= postfix [ "^" postfix ]
+//   postfix  ::= primary ["!"] | symbol "(" add ")" ["!"] | symbol ["!"] | derivative ["!"]
+//   derivative ::= "d" "(" symbol "," add ")"
+//   primary  ::= number | "-" number | "(" add ")"
+//
+// "unary mul", the implicit multiply, is only allowed when the mul starts with a number or a
+// bracket and has no "*" or "/" in it, as in 2pi/3 or (1+4)(3sin(x)). its right side is the
+// whole rest of the mul, so 2pi/3 is 2 * (pi/3)
+//
+// it's parsed without recursion: operators that are still waiting for their right side are kept
+// on a stack. brackets, calls and d( go on the stack as well, and so does the op that started the
+// current mul, which keeps track of whether an implicit multiply is allowed. nothing else recurses
+// on the tree either, so brackets can go as deep as the line is long
+
+enum class Pending : uint8_t
 {
-    char errBuf[20+kMaxSymbolLength+1];
+    // brackets of some kind, which hold an add
+    Top,
+    Paren,
+    Call,       // Name(
+    Deriv,      // d(Name,
 
-    double val = 1.0 / 0.0;
-    if (peek(ctx, Token::Symbol))
-    {
-        const int sym_name_pos = ctx.CurrIx;
+    // waiting for a mul
+    Add, Sub,
+    ImplicitMul,
 
-        char symbol[kMaxSymbolLength];
-        strcpy(symbol, ctx.TokenSymbol);
-        expect(ctx, Token::Symbol);
+    // waiting for a unary
+    Mul, Div,
+    Neg,
 
-        // if this is a (, we have a fn call. else it's a named value
-        if (accept(ctx, Token::LParen))
-        {
-            double arg1 = parse_expression(ctx);
-            if (!expect(ctx, Token::RParen))
-                return 0.0;
+    // waiting for a postfix
+    Pow,
+};
 
-            if (!eval_function(symbol, arg1, val, ctx))
-            {
-                if (ctx.Error)
-                    return 0.0;
+struct PendingOp
+{
+    Pending Kind = Pending::Top;
 
-                ctx.CurrIx = sym_name_pos;
-                sprintf(errBuf, "unknown func: %s", symbol);
-                on_parse_error(ctx, errBuf);
-                return 0.0;
-            }
-        }
-        else
-        {
-            if (!eval_named_value(symbol, val))
-            {
-                ctx.CurrIx = sym_name_pos;
-                sprintf(errBuf, "unknown named val: %s", symbol);
-                on_parse_error(ctx, errBuf);
-                return 0.0;
-            }
-        }
+    // for the mul that follows an op waiting for a mul
+    bool ImplicitMulAllowed = false;
+    bool HadInfix = false;
+
+    SymId Name = kNoSymId;
+    int NamePos = 0;    // where to point errors about Name
+
+    Node* Left = nullptr;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+struct ExprState
+{
+    // parse_expression compiles into these, so their buffers get reused. an expression can be
+    // worked out in the middle of another, so there's one per level
+    std::deque<Program> Programs;
+    size_t ProgramsInUse = 0;
+
+    // the ops waiting in every parse that's going on. a parse can start in the middle of another,
+    // when a call is inlined
+    std::vector<PendingOp> PendingOps;
+};
+
+ExprState* create_expr_state()
+{
+    return new ExprState;
+}
+
+void destroy_expr_state(ExprState* state)
+{
+    delete state;
+}
+
+static ExprState& expr_state()
+{
+    return *calc_context().Expr;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the ops for one parse, which are the ones above where the stack was when it started
+struct ParseStack
+{
+    std::vector<PendingOp>& Ops;
+    const size_t Base;
+
+    ParseStack() : Ops(expr_state().PendingOps), Base(Ops.size()) {}
+    ~ParseStack() { Ops.resize(Base); }
+
+    PendingOp& top() { return Ops.back(); }
+    void pop() { Ops.pop_back(); }
+};
+
+static void push_op(ParseStack& stack, Pending kind, Node* left, ParseCtx& ctx)
+{
+    stack.Ops.emplace_back();
+
+    PendingOp& op = stack.top();
+    op.Kind = kind;
+    op.Left = left;
+
+    // if it's waiting for an add or a mul, this is the first token of the mul
+    op.ImplicitMulAllowed = peek(ctx, Token::Number) || peek(ctx, Token::LParen);
+}
+
+// a symbol that isn't being called: the arg or a named value
+static Node* parse_named(SymId symbol, int symNamePos, ParseCtx& ctx, CompileCtx& cc)
+{
+    if (symbol == cc.Arg)
+    {
+        ++cc.ArgUses;
+        return cc.ArgValue ? cc.ArgValue : new_node(NodeKind::Arg);
+    }
+
+    double val;
+    if (!eval_named_value(symbol, val) && !cc.LateBind)
+    {
+        char errBuf[20+kMaxSymbolLength+1];
+        ctx.CurrIx = symNamePos;
+        sprintf(errBuf, "unknown named val: %s", interned_name(symbol));
+        on_parse_error(ctx, errBuf);
+        return nullptr;
     }
-    else
+
+    Node* node = new_node(NodeKind::Sym);
+    node->Name = symbol;
+    node->Pos = { .Text = cc.Text, .Ix = symNamePos };
+
+    if (!is_constant(symbol))
+        note_use(cc, symbol);
+    return node;
+}
+
+// func(arg), once the ")" has been eaten
+static Node* make_call(SymId func, int funcNamePos, Node* arg, ParseCtx& ctx, CompileCtx& cc)
+{
+    const int builtinIx = find_builtin_func(func);
+    if (builtinIx >= 0)
     {
-        val = parse_primary(ctx);
+        Node* node = new_node(NodeKind::Call, arg);
+        node->BuiltinIx = uint8_t(builtinIx);
+        return node;
     }
 
-    if (accept(ctx, Token::Factorial))
+    if (cc.LateBind || is_user_func(func))
     {
-        if (!compute_factorial(val))
+        Node* node = inline_call(func, arg, cc);
+        if (!node)
         {
-            on_parse_error(ctx, "need a positive integer");
-            return 0.0;
+            node = new_node(NodeKind::CallUser, arg);
+            node->Name = func;
+            node->Pos = { .Text = cc.Text, .Ix = funcNamePos };
         }
+        return node;
     }
 
-    return val;
+    char errBuf[20+kMaxSymbolLength+1];
+    ctx.CurrIx = funcNamePos;
+    sprintf(errBuf, "unknown func: %s", interned_name(func));
+    on_parse_error(ctx, errBuf);
+    return nullptr;
 }
 
-// exponent ::= postfix [ "**" postfix ]
-double parse_exponent(ParseCtx& ctx)
+// d(func, arg), once the ")" has been eaten
+static Node* make_derivative(SymId func, int funcNamePos, Node* arg, ParseCtx& ctx, CompileCtx& cc)
 {
-    double val = parse_postfix(ctx);
-    if (ctx.Error)
-        return 0;
-
-    if (accept(ctx, Token::Exponent))
+    if (find_builtin_func(func) < 0)
     {
-        double power = parse_postfix(ctx);
-        if (ctx.Error)
-            return 0;
+        if (!cc.LateBind && !is_user_func(func))
+        {
+            char errBuf[20+kMaxSymbolLength+1];
+            ctx.CurrIx = funcNamePos;
+            sprintf(errBuf, "unknown func: %s", interned_name(func));
+            on_parse_error(ctx, errBuf);
+            return nullptr;
+        }
 
-        val = std::pow(val, power);
+        note_use(cc, func);
     }
 
-    return val;
+    Node* node = new_node(NodeKind::Deriv, arg);
+    node->Name = func;
+    node->Pos = { .Text = cc.Text, .Ix = funcNamePos };
+    return node;
 }
 
-// unary = exponent | "+" unary | "-" unary
-double parse_unary(ParseCtx& ctx)
+// parses an add, stopping at the first token that can't continue it. returns null on errors
+static Node* parse_tree(ParseCtx& ctx, CompileCtx& cc)
 {
-    if (accept(ctx, Token::Plus))
-        return parse_unary(ctx);
-    if (accept(ctx, Token::Minus))
-        return -1.0 * parse_unary(ctx);
+    ParseStack stack;
+    push_op(stack, Pending::Top, nullptr, ctx);
 
-    return parse_exponent(ctx);
-}
+    // each time round parses an operand, then everything after it up to the next operand
+    for (;;)
+    {
+        // the exponent of a "^" is a postfix, which can't have signs in front
+        if (stack.top().Kind != Pending::Pow)
+        {
+            for (;;)
+            {
+                if (accept(ctx, Token::Plus))
+                    continue;
+                if (peek(ctx, Token::Minus))
+                {
+                    accept(ctx, Token::Minus);
+                    push_op(stack, Pending::Neg, nullptr, ctx);
+                    continue;
+                }
+                break;
+            }
+        }
 
-// mul ::= unary | mul "*" unary | mul "/" unary | unary mul
-double parse_mul(ParseCtx& ctx)
-{
-    bool allowed_implicit_mul = peek(ctx, Token::Number) || peek(ctx, Token::LParen);
+        Node* node = nullptr;
+        if (peek(ctx, Token::Symbol))
+        {
+            const int symNamePos = ctx.CurrIx;
 
-    double val = parse_unary(ctx);
+            const SymId symbol = ctx.TokenSymbolId;
+            expect(ctx, Token::Symbol);
 
-    bool had_infix = false;
-    while (!ctx.Error && (peek(ctx, Token::Times) || peek(ctx, Token::Divide)))
-    {
-        had_infix = true;
+            // d(f, x) is the slope of f at x. anything else is an ordinary call, so d can still
+            // be a user function, eg. d(3)
+            const bool isDerivative = (symbol == find_interned("d")) && peek(ctx, Token::LParen)
+                && (peek_ahead(ctx, 1) == Token::Symbol) && (peek_ahead(ctx, 2) == Token::Comma);
+            if (isDerivative && accept(ctx, Token::LParen))
+            {
+                const int funcNamePos = ctx.CurrIx;
+                SymId func;
+                if (!expect_symbol(ctx, func) || !expect(ctx, Token::Comma))
+                    return nullptr;
+
+                push_op(stack, Pending::Deriv, nullptr, ctx);
+                stack.top().Name = func;
+                stack.top().NamePos = funcNamePos;
+                continue;
+            }
 
-        if (accept(ctx, Token::Times))
+            if (accept(ctx, Token::LParen))
+            {
+                push_op(stack, Pending::Call, nullptr, ctx);
+                stack.top().Name = symbol;
+                stack.top().NamePos = symNamePos;
+                continue;
+            }
+
+            node = parse_named(symbol, symNamePos, ctx, cc);
+        }
+        else if (accept(ctx, Token::LParen))
         {
-            val = val * parse_unary(ctx);
+            push_op(stack, Pending::Paren, nullptr, ctx);
+            continue;
         }
-        else if (accept(ctx, Token::Divide))
+        else if (accept(ctx, Token::Minus))
         {
-            val = val / parse_unary(ctx);
+            node = new_const(-expect_number(ctx));
+        }
+        else
+        {
+            node = new_const(expect_number(ctx));
         }
-    }
 
-    // 2pi / (1+4)(3sin(x)) case
-    if (allowed_implicit_mul && !had_infix)
-    {
-        if (peek(ctx, Token::Symbol) || peek(ctx, Token::LParen))
+        if (ctx.Error)
+            return nullptr;
+
+        // node is a postfix now. this loop goes round again each time a bracket is closed, since
+        // that makes another postfix
+        for (;;)
         {
-            val *= parse_mul(ctx);
+            if (accept(ctx, Token::Factorial))
+            {
+                node = new_node(NodeKind::Fact, node);
+                node->Pos = { .Text = cc.Text, .Ix = ctx.CurrIx };
+            }
+
+            // exponent
+            if (stack.top().Kind == Pending::Pow)
+            {
+                node = new_node(NodeKind::Pow, stack.top().Left, node);
+                stack.pop();
+            }
+            else if (peek(ctx, Token::Exponent))
+            {
+                accept(ctx, Token::Exponent);
+                push_op(stack, Pending::Pow, node, ctx);
+                break;
+            }
+
+            // unary
+            while (stack.top().Kind == Pending::Neg)
+            {
+                node = new_node(NodeKind::Neg, node);
+                stack.pop();
+            }
+
+            // mul. what's on top after this is the op waiting for the mul
+            if ((stack.top().Kind == Pending::Mul) || (stack.top().Kind == Pending::Div))
+            {
+                node = new_node((stack.top().Kind == Pending::Mul) ? NodeKind::Mul : NodeKind::Div, stack.top().Left, node);
+                stack.pop();
+            }
+
+            if (peek(ctx, Token::Times) || peek(ctx, Token::Divide))
+            {
+                stack.top().HadInfix = true;
+
+                const Pending kind = peek(ctx, Token::Times) ? Pending::Mul : Pending::Div;
+                advance_token(ctx);
+                if (ctx.Error)
+                    return nullptr;
+                push_op(stack, kind, node, ctx);
+                break;
+            }
+
+            if (stack.top().ImplicitMulAllowed && !stack.top().HadInfix
+                && (peek(ctx, Token::Symbol) || peek(ctx, Token::LParen)))
+            {
+                push_op(stack, Pending::ImplicitMul, node, ctx);
+                break;
+            }
+
+            // the right side of an implicit multiply is the rest of the mul it's in, so they all
+            // end together
+            while (stack.top().Kind == Pending::ImplicitMul)
+            {
+                node = new_node(NodeKind::Mul, stack.top().Left, node);
+                stack.pop();
+            }
+
+            // add
+            if ((stack.top().Kind == Pending::Add) || (stack.top().Kind == Pending::Sub))
+            {
+                node = new_node((stack.top().Kind == Pending::Add) ? NodeKind::Add : NodeKind::Sub, stack.top().Left, node);
+                stack.pop();
+            }
+
+            if (peek(ctx, Token::Plus) || peek(ctx, Token::Minus))
+            {
+                const Pending kind = peek(ctx, Token::Plus) ? Pending::Add : Pending::Sub;
+                advance_token(ctx);
+                if (ctx.Error)
+                    return nullptr;
+                push_op(stack, kind, node, ctx);
+                break;
+            }
+
+            // the add is done, so whatever it's in is closed
+            const PendingOp closed = stack.top();
+            stack.pop();
+
+            if (closed.Kind == Pending::Top)
+                return node;
+
+            if (!expect(ctx, Token::RParen))
+                return nullptr;
+
+            if (closed.Kind == Pending::Call)
+                node = make_call(closed.Name, closed.NamePos, node, ctx, cc);
+            else if (closed.Kind == Pending::Deriv)
+                node = make_derivative(closed.Name, closed.NamePos, node, ctx, cc);
+
+            if (ctx.Error)
+                return nullptr;
         }
     }
-
-    return val;
 }
 
-// add ::= mul | add "+" mul | add "-" mul
-double parse_add(ParseCtx& ctx)
-{
-    double val = parse_mul(ctx);
+//-------------------------------------------------------------------------------------------------
 
-    while (!ctx.Error && (peek(ctx, Token::Plus) || peek(ctx, Token::Minus)))
+// children first, A before B
+static void emit_tree(Node* root, Program& prog, ParseCtx& ctx)
+{
+    static const Op kNodeOps[] =
     {
-        if (accept(ctx, Token::Plus))
+        Op::Const, Op::Arg, Op::Sym,
+        Op::Call, Op::CallUser, Op::Deriv,
+        Op::Neg,
+        Op::Add, Op::Sub,
+        Op::Mul, Op::Div,
+        Op::Pow,
+        Op::Fact,
+    };
+    static_assert((sizeof(kNodeOps) / sizeof(kNodeOps[0])) == size_t(NodeKind::Fact) + 1);
+
+    TreeWalk walk;
+    walk.push(root);
+
+    WalkStep step;
+    while (!ctx.Error && walk.pop(step))
+    {
+        Node* node = step.At;
+
+        // on the way down
+        if (step.Tag == 0)
         {
-            val = val + parse_mul(ctx);
+            // a shared value that's already been worked out
+            if (node->Temp != kNoTemp)
+            {
+                emit_temp(prog, Op::Load, node->Temp, ctx);
+                continue;
+            }
+
+            walk.push(node, nullptr, 1);
+            if (node->B && (node->B != node->A))
+                walk.push(node->B);
+            if (node->A)
+                walk.push(node->A);
+            continue;
         }
-        else if (accept(ctx, Token::Minus))
+
+        prog.EmitPos = node->Pos;
+        if (node->B && (node->B == node->A))
+            emit_op(prog, Op::Dup, ctx);        // a shared subtree, eg. x^2 after simplify_tree
+
+        switch (node->Kind)
+        {
+        case NodeKind::Const:       emit_const(prog, node->Value, ctx);                 break;
+        case NodeKind::Sym:
+        case NodeKind::CallUser:
+        case NodeKind::Deriv:       emit_named(prog, kNodeOps[int(node->Kind)], node->Name, ctx);  break;
+        case NodeKind::Call:        emit_call(prog, node->BuiltinIx, ctx);              break;
+        default:                    emit_op(prog, kNodeOps[int(node->Kind)], ctx);      break;
+        }
+
+        // keep shared values for later, unless they're as cheap to push again. when the temps run
+        // out, later uses just work the value out again
+        const bool isLeaf = (node->Kind == NodeKind::Const) || (node->Kind == NodeKind::Arg);
+        if ((node->Uses > 1) && !isLeaf && (prog.NumTemps < kMaxProgramTemps))
         {
-            val = val - parse_mul(ctx);
+            node->Temp = prog.NumTemps;
+            emit_temp(prog, Op::Store, node->Temp, ctx);
         }
     }
+}
+
+// parses the rest of ctx's input as far as it makes sense, and compiles it into prog
+static bool compile(ParseCtx& ctx, CompileCtx& cc, Program& prog)
+{
+    reset_program(prog);
+
+    Node* root = parse_tree(ctx, cc);
+    if (ctx.Error)
+        return false;
+
+    root = fold_constants(root);
+    if (cc.LateBind)
+    {
+        root = simplify_tree(root);
+
+        int numShared = 0;
+        root = share_subtrees(root, numShared);
+        prog.NodesShared = uint16_t(numShared);
+    }
 
-    return val;
+    emit_tree(root, prog, ctx);
+    return !ctx.Error;
+}
+
+bool compile_expression(ParseCtx& ctx, Program& prog, SymId arg, SymId self, std::vector<SymId>* outUses)
+{
+    InlineState state;
+    state.Uses = outUses;
+    if (self != kNoSymId)
+        state.Stack[state.Depth++] = self;
+
+    CompileCtx cc { .LateBind = true, .Arg = arg, .Inline = &state, .Text = self };
+    return compile(ctx, cc, prog);
 }
 
+Node* parse_function_body(const char* def, SymId arg, Node* argValue, ParseCtx& ctx)
+{
+    ParseCtx sub { .InBuffer = def, .ResBuffer = ctx.ResBuffer, .ResBufferLen = ctx.ResBufferLen };
+    CompileCtx cc { .LateBind = true, .Arg = arg, .ArgValue = argValue };
+
+    advance_token(sub);
+    Node* body = parse_tree(sub, cc);
+    if (!sub.Error && !accept(sub, Token::Eof))
+        on_parse_error(sub, "trailing nonsense");
+
+    if (sub.Error)
+    {
+        ctx.Error = true;
+        return nullptr;
+    }
+    return body;
+}
 
 double parse_expression(ParseCtx& ctx)
 {
-    return parse_add(ctx);
+    ExprState& state = expr_state();
+
+    if (state.ProgramsInUse == state.Programs.size())
+        state.Programs.emplace_back();
+    Program& prog = state.Programs[state.ProgramsInUse++];
+
+    CompileCtx cc { .LateBind = false, .Arg = kNoSymId };
+    double val = 0.0;
+    if (!compile(ctx, cc, prog) || !run_program(prog, 0.0, val, ctx))
+        val = 0.0;
+
+    --state.ProgramsInUse;
+    return val;
 }
 
 //-------------------------------------------------------------------------------------------------
-
@@ -1,12 +1,35 @@
 #pragma once
 
+#include "intern.h"
+
+#include <vector>
+
 //-------------------------------------------------------------------------------------------------
 
+struct Node;
 struct ParseCtx;
+struct Program;
 
 //-------------------------------------------------------------------------------------------------
 
+struct ExprState;
+ExprState* create_expr_state();
+void destroy_expr_state(ExprState* state);
+
+// compiles and immediately runs an expression
 double parse_expression(ParseCtx& ctx);
 
-//-------------------------------------------------------------------------------------------------
+// compiles a function body to run later. unknown names are resolved when the program is run,
+// and arg refers to the function's own argument. calls to small user functions are inlined,
+// except for calls to self, the function being defined. user values are folded in as they are
+// now. if outUses is given it gets every user name the body depends on, directly or through an
+// inlined body, so it can be recompiled when one of them changes
+bool compile_expression(ParseCtx& ctx, Program& prog, SymId arg, SymId self = kNoSymId,
+                        std::vector<SymId>* outUses = nullptr);
+
+// parses def as the body of a function of arg into a tree, exactly as written: nothing is folded,
+// simplified or inlined. if argValue is given it stands in for the arg. errors are reported to
+// ctx, and give null
+Node* parse_function_body(const char* def, SymId arg, Node* argValue, ParseCtx& ctx);
 
+//-------------------------------------------------------------------------------------------------
@@ -1,33 +1,420 @@
 #include "format.h"
 
+#include "context.h"
+#include "numparse.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 //-------------------------------------------------------------------------------------------------
 
-void dtostr_human(double d, char* s, int sLen)
+void set_format_digits(int digits)
 {
-    snprintf(s, sLen, "%.8g", d);
-    s[sLen-1] = 0;
+    calc_context().FormatDigits = (digits < 1) ? kShortestDigits
+        : (digits > kMaxFormatDigits) ? kMaxFormatDigits : digits;
+}
 
-    // trim off trailing zeroes
-    char* dot = strchr(s, '.');
-    if (!dot)
-        return;
+int format_digits()
+{
+    return calc_context().FormatDigits;
+}
+
+//-------------------------------------------------------------------------------------------------
 
-    char* e = strchr(s, 'e');
-    if (e)
-        return; // this is fiddly. TODO
+// a positive number as 0.Digits * 10^(Exp+1), ie. with the point after the first digit it's
+// Digits * 10^Exp. there are no trailing zeros, and zero itself is "0"
+struct DecimalDigits
+{
+    char Digits[kMaxFormatDigits+2] = {0};
+    int NumDigits = 0;
+    int Exp = 0;
+};
+
+static void trim_zeros(DecimalDigits& dec)
+{
+    while ((dec.NumDigits > 1) && (dec.Digits[dec.NumDigits-1] == '0'))
+        --dec.NumDigits;
+    dec.Digits[dec.NumDigits] = 0;
+}
 
-    char* z = s + strlen(s) - 1;
-    while (z >= dot && *z == '0')
+//-------------------------------------------------------------------------------------------------
+
+// the shortest digits come from Grisu2: the double and the halfway points to its neighbours are
+// scaled by a power of 10 so that their integer parts fit in 32 bits, then digits are
+// generated until the number is known to within the gap between the neighbours. it always reads
+// back exactly, and is the shortest that does for nearly every double. see Loitsch, "Printing
+// floating-point numbers quickly and accurately with integers"
+
+struct DiyFp
+{
+    uint64_t F = 0;
+    int E = 0;
+};
+
+static DiyFp diy_mul(DiyFp a, DiyFp b)
+{
+    uint64_t hi, lo;
+    mul_64x64(a.F, b.F, hi, lo);
+
+    // rounded
+    hi += (lo >> 63);
+    return { hi, a.E + b.E + 64 };
+}
+
+static DiyFp diy_normalize(DiyFp v)
+{
+    const int lz = __builtin_clzll(v.F);
+    return { v.F << lz, v.E - lz };
+}
+
+// moves the digits at the end back towards w while that stays inside the gap and gets closer
+static void grisu_round(DecimalDigits& dec, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t wpMinusW)
+{
+    char& last = dec.Digits[dec.NumDigits-1];
+    while ((rest < wpMinusW) && (delta - rest >= tenKappa)
+        && ((rest + tenKappa < wpMinusW) || (wpMinusW - rest > rest + tenKappa - wpMinusW)))
     {
-        *z = 0;
-        --z;
+        --last;
+        rest += tenKappa;
     }
-    if (z == dot)
-        *z = 0;
+}
+
+static int count_digits(uint32_t n)
+{
+    int count = 1;
+    for (; n >= 10; n /= 10)
+        ++count;
+    return count;
+}
+
+static const uint64_t kPow10_64[] =
+{
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull,
+};
+constexpr int kNumPow10_64 = int(sizeof(kPow10_64) / sizeof(kPow10_64[0]));
+
+static void grisu_digits(DiyFp w, DiyFp mp, uint64_t delta, DecimalDigits& dec, int& k)
+{
+    const DiyFp one { uint64_t(1) << -mp.E, mp.E };
+    const uint64_t wpMinusW = mp.F - w.F;
+
+    uint32_t p1 = uint32_t(mp.F >> -one.E);
+    uint64_t p2 = mp.F & (one.F - 1);
+
+    dec.NumDigits = 0;
+
+    // the integer part
+    for (int kappa = count_digits(p1); kappa > 0; )
+    {
+        const uint32_t d = p1 / uint32_t(kPow10_64[kappa-1]);
+        p1 %= uint32_t(kPow10_64[kappa-1]);
+
+        if (d || dec.NumDigits)
+            dec.Digits[dec.NumDigits++] = char('0' + d);
+        --kappa;
+
+        const uint64_t rest = (uint64_t(p1) << -one.E) + p2;
+        if (rest <= delta)
+        {
+            k += kappa;
+            grisu_round(dec, delta, rest, kPow10_64[kappa] << -one.E, wpMinusW);
+            return;
+        }
+    }
+
+    // and the fraction
+    for (int kappa = 0; ; )
+    {
+        p2 *= 10;
+        delta *= 10;
+
+        const char d = char(p2 >> -one.E);
+        if (d || dec.NumDigits)
+            dec.Digits[dec.NumDigits++] = char('0' + d);
+        p2 &= one.F - 1;
+        --kappa;
+
+        if (p2 < delta)
+        {
+            k += kappa;
+            grisu_round(dec, delta, p2, one.F, (-kappa < kNumPow10_64) ? wpMinusW * kPow10_64[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+// d must be finite and above zero
+static void shortest_digits(double d, DecimalDigits& dec)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+
+    constexpr uint64_t kHiddenBit = uint64_t(1) << 52;
+    const int biasedExp = int(bits >> 52);
+    const uint64_t mantissa = bits & (kHiddenBit - 1);
+
+    const DiyFp v = (biasedExp == 0) ? DiyFp { mantissa, -1074 } : DiyFp { mantissa | kHiddenBit, biasedExp - 1075 };
+
+    // the halfway points to the doubles either side, with the same exponent. the gap below is
+    // half as big at a power of 2
+    DiyFp plus { (v.F << 1) + 1, v.E - 1 };
+    while (!(plus.F & (kHiddenBit << 1)))
+    {
+        plus.F <<= 1;
+        --plus.E;
+    }
+    plus.F <<= 10;
+    plus.E -= 10;
+
+    DiyFp minus = (v.F == kHiddenBit) ? DiyFp { (v.F << 2) - 1, v.E - 2 } : DiyFp { (v.F << 1) - 1, v.E - 1 };
+    minus.F <<= minus.E - plus.E;
+    minus.E = plus.E;
+
+    // a power of 10 that puts the scaled binary exponent in [-35, -32], so the integer part is
+    // as big as it can be and still fit in 32 bits
+    const int mk = int(ceil((-36 - plus.E) * 0.30102999566398114));
+    DiyFp cached;
+    cached_pow10(mk, cached.F, cached.E);
+
+    const DiyFp w = diy_mul(diy_normalize(v), cached);
+    DiyFp wPlus = diy_mul(plus, cached);
+    DiyFp wMinus = diy_mul(minus, cached);
+
+    // stay inside the gap whichever way the products were rounded
+    ++wMinus.F;
+    --wPlus.F;
+
+    int k = -mk;
+    grisu_digits(w, wPlus, wPlus.F - wMinus.F, dec, k);
+
+    dec.Exp = dec.NumDigits - 1 + k;
+    trim_zeros(dec);
+}
+
+// d must be finite and above zero. rounded to nearest, ties to even, by printf
+static void rounded_digits(double d, int numDigits, DecimalDigits& dec)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*e", numDigits - 1, d);
+
+    const char* in = buf;
+    dec.NumDigits = 0;
+    for (; *in && *in != 'e'; ++in)
+    {
+        if (*in != '.')
+            dec.Digits[dec.NumDigits++] = *in;
+    }
+    dec.Exp = (*in == 'e') ? atoi(in + 1) : 0;
+    trim_zeros(dec);
+}
+
+// dec cut down to numDigits, and either left there or moved up by one in its last digit
+static void shortened_digits(const DecimalDigits& dec, int numDigits, bool up, DecimalDigits& out)
+{
+    out = dec;
+    out.NumDigits = numDigits;
+    if (up)
+    {
+        int i = numDigits - 1;
+        for (; (i >= 0) && (out.Digits[i] == '9'); --i)
+            out.Digits[i] = '0';
+        if (i >= 0)
+        {
+            ++out.Digits[i];
+        }
+        else
+        {
+            out.Digits[0] = '1';
+            ++out.Exp;
+        }
+    }
+    trim_zeros(out);
+}
+
+// the most digits the shortest digits can be rounded to, with the three after them saying which
+// way d rounds
+constexpr int kMaxGuardedDigits = 12;
+
+static bool near_halfway(const DecimalDigits& dec, int numDigits)
+{
+    char guard[4] = {'0', '0', '0', 0};
+    for (int i = 0; (i < 3) && (numDigits + i < dec.NumDigits); ++i)
+        guard[i] = dec.Digits[numDigits + i];
+    return !strcmp(guard, "499") || !strcmp(guard, "500");
+}
+
+static bool reads_back_as(const DecimalDigits& dec, double d)
+{
+    char buf[40];
+    memcpy(buf, dec.Digits, dec.NumDigits);
+    char* curr = buf + dec.NumDigits;
+    int exp = dec.Exp - dec.NumDigits + 1;
+    *(curr++) = 'e';
+    if (exp < 0)
+    {
+        *(curr++) = '-';
+        exp = -exp;
+    }
+    char expDigits[8];
+    int numExpDigits = 0;
+    do
+    {
+        expDigits[numExpDigits++] = char('0' + exp % 10);
+        exp /= 10;
+    } while (exp);
+    while (numExpDigits)
+        *(curr++) = expDigits[--numExpDigits];
+    *curr = 0;
+
+    // subnormals are out of range, but still come back right
+    double val;
+    bool outOfRange;
+    read_number(buf, val, outOfRange);
+    return val == d;
 }
 
 //-------------------------------------------------------------------------------------------------
 
+// lays dec out like %g with the given precision would
+static int put_decimal(const DecimalDigits& dec, bool negative, int precision, char* out)
+{
+    char* curr = out;
+    if (negative)
+        *(curr++) = '-';
+
+    if ((dec.Exp < -4) || (dec.Exp >= precision))
+    {
+        *(curr++) = dec.Digits[0];
+        if (dec.NumDigits > 1)
+        {
+            *(curr++) = '.';
+            memcpy(curr, dec.Digits + 1, dec.NumDigits - 1);
+            curr += dec.NumDigits - 1;
+        }
+
+        curr += sprintf(curr, "e%c%02d", (dec.Exp < 0) ? '-' : '+', abs(dec.Exp));
+        return int(curr - out);
+    }
+
+    if (dec.Exp < 0)
+    {
+        *(curr++) = '0';
+        *(curr++) = '.';
+        for (int i = -1; i > dec.Exp; --i)
+            *(curr++) = '0';
+        memcpy(curr, dec.Digits, dec.NumDigits);
+        curr += dec.NumDigits;
+    }
+    else
+    {
+        for (int i = 0; i <= dec.Exp || i < dec.NumDigits; ++i)
+        {
+            if (i == dec.Exp + 1)
+                *(curr++) = '.';
+            *(curr++) = (i < dec.NumDigits) ? dec.Digits[i] : '0';
+        }
+    }
+
+    *curr = 0;
+    return int(curr - out);
+}
+
+static void format_number(double d, int numDigits, char* s, int sLen)
+{
+    if (sLen <= 0)
+        return;
+
+    if (!std::isfinite(d))
+    {
+        snprintf(s, sLen, "%g", d);
+        return;
+    }
+
+    const bool negative = std::signbit(d);
+    d = fabs(d);
+
+    DecimalDigits dec;
+    if (d == 0.0)
+    {
+        dec.Digits[0] = '0';
+        dec.NumDigits = 1;
+    }
+    else if (numDigits == kShortestDigits)
+    {
+        // Grisu2 now and then gives a digit or two more than it needs. the numbers that read back
+        // as d are a range that the digits are in, so if any shorter form is in it, so is one of
+        // the two either side of the digits
+        shortest_digits(d, dec);
+        for (int n = 15; n < dec.NumDigits; ++n)
+        {
+            // the nearer one first
+            const bool upFirst = (dec.Digits[n] >= '5');
+            DecimalDigits shorter;
+            shortened_digits(dec, n, upFirst, shorter);
+            if (!reads_back_as(shorter, d))
+                shortened_digits(dec, n, !upFirst, shorter);
+            if (reads_back_as(shorter, d))
+            {
+                dec = shorter;
+                break;
+            }
+        }
+        // it shouldn't ever be wrong, but reading it back is cheap enough to make sure
+        if (!reads_back_as(dec, d))
+            rounded_digits(d, kMaxFormatDigits, dec);
+
+        // past 2^53 the digits can stop before the units, and the zeros written after them
+        // wouldn't be the real ones, eg. 2^56 would be 72057594037927940. integers that are
+        // written out in full get all their digits
+        if ((dec.Exp >= dec.NumDigits) && (dec.Exp < kMaxFormatDigits) && (d >= 0x1p53))
+            rounded_digits(d, dec.Exp + 1, dec);
+    }
+    else
+    {
+        // with up to 15 digits, the shortest is also the correctly rounded one whenever it's
+        // short enough, which saves printing. subnormals have too few bits for that
+        const bool tryShortest = (numDigits <= 15) && (d >= DBL_MIN);
+        if (tryShortest)
+            shortest_digits(d, dec);
+
+        if (!tryShortest)
+        {
+            rounded_digits(d, numDigits, dec);
+        }
+        else if (dec.NumDigits > numDigits)
+        {
+            // the shortest digits are within a unit in the last place of d, which is under a
+            // thousandth of the last digit kept, so they round the same way as d unless they're
+            // too near halfway
+            if ((numDigits <= kMaxGuardedDigits) && !near_halfway(dec, numDigits))
+                shortened_digits(dec, numDigits, dec.Digits[numDigits] >= '5', dec);
+            else
+                rounded_digits(d, numDigits, dec);
+        }
+    }
+
+    char buf[40];
+    const int len = put_decimal(dec, negative, (numDigits == kShortestDigits) ? kMaxFormatDigits : numDigits, buf);
+    const int copyLen = (len < sLen) ? len : sLen - 1;
+    memcpy(s, buf, copyLen);
+    s[copyLen] = 0;
+}
+
+void dtostr_human(double d, char* s, int sLen)
+{
+    format_number(d, calc_context().FormatDigits, s, sLen);
+}
+
+void dtostr_shortest(double d, char* s, int sLen)
+{
+    format_number(d, kShortestDigits, s, sLen);
+}
+
+//-------------------------------------------------------------------------------------------------
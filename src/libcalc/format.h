@@ -1,9 +1,22 @@
 #pragma once
 
+//-------------------------------------------------------------------------------------------------
+
+// how many significant digits numbers are written with, like printf's %g. kShortestDigits means
+// as few as it takes to read back as exactly the same double
+constexpr int kShortestDigits = 0;
+constexpr int kDefaultDigits = 8;
+constexpr int kMaxFormatDigits = 17;
+
+void set_format_digits(int digits);
+int format_digits();
 
 //-------------------------------------------------------------------------------------------------
 
+// d with the current number of digits, laid out like %g without any trailing zeros
 void dtostr_human(double d, char* s, int sLen);
 
-//-------------------------------------------------------------------------------------------------
+// d with as few digits as read back as exactly the same double
+void dtostr_shortest(double d, char* s, int sLen);
 
+//-------------------------------------------------------------------------------------------------
@@ -1,17 +1,29 @@
 #include "funcs.h"
 
+#include "bytecode.h"
+#include "context.h"
+#include "deps.h"
+#include "dual.h"
 #include "expr.h"
+#include "interval.h"
+#include "jit.h"
+#include "libcalc.h"
 #include "maths.h"
 #include "parser.h"
 #include "symbols.h"
+#include "vmaths.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <vector>
 
 //-----------------------------------------------------------------------------------------------
 
-constexpr int kMaxFuncDefLen = 255;
-constexpr int kMaxUserFuncs = 10;
+constexpr int kMaxCallDepth = 16;
+
+constexpr int kDefaultMemoSize = 256;
+constexpr int kMaxMemoSize = 1 << 16;
 
 //-----------------------------------------------------------------------------------------------
 
@@ -24,110 +36,394 @@ struct FunctionDef
     const char* Name = nullptr;
     const char* Args = "d";
     CalcDoubleFn FuncPtr = nullptr;
+
+    // optional array version, used when evaluating in batches
+    CalcDoubleVecFn VecFuncPtr = nullptr;
+
+    // every value it takes over a range of args, used for plotting
+    CalcIntervalFn IntervalFuncPtr = nullptr;
+
+    // the value and its derivative together
+    CalcDualFn DualFuncPtr = nullptr;
+
+    // the derivative as an expression in x, used by deriv. sinc's has a hole at 0 when written
+    // out, so it leaves it to the dual version
+    const char* Slope = nullptr;
+
+    // functions added with register_calc_func only come with the double version. the others run
+    // RegisteredCode[CodeIx] instead, compiled from the def they were registered with
+    int CodeIx = -1;
+};
+
+// an optional cache of a function's results, keyed on the arg's bit pattern and direct mapped.
+// entries are tagged with the epoch they were stored in, so clearing is just a bump of the epoch
+struct MemoEntry
+{
+    uint64_t ArgBits = 0;
+    double Val = 0.0;
+    uint32_t Epoch = 0;
+};
+
+struct MemoCache
+{
+    std::vector<MemoEntry> Entries;
+    int IndexShift = 63;        // 64 - log2(size)
+    uint32_t Epoch = 1;
+
+    uint32_t Hits = 0;
+    uint32_t Misses = 0;
 };
 
 struct UserFunction
 {
-    char Name[kMaxSymbolLength+1] = {0};
-    char Arg[kMaxSymbolLength+1] = {0};
+    SymId Name = kNoSymId;
+    SymId Arg = kNoSymId;
+
+    // the source text lives in DefArena
+    uint32_t DefOffset = 0;
+    uint32_t DefLen = 0;
+
+    Program Code;
+    JitFn Jit = nullptr;
 
-    char Def[kMaxFuncDefLen+1] = {0};
+    // set when something the body was compiled with has changed. it's compiled again the next
+    // time it's looked up
+    bool Stale = false;
 
-    bool IsUsed = false;
+    // empty unless turned on with the memo command
+    mutable MemoCache Memo;
 };
 
 //-----------------------------------------------------------------------------------------------
 
-FunctionDef gFunctions[] =
+static const FunctionDef kFunctions[] =
+{
+    { .Name = "sin", .FuncPtr = (CalcDoubleFn)sin, .VecFuncPtr = vsin, .IntervalFuncPtr = isin,
+      .DualFuncPtr = dsin, .Slope = "cos(x)" },
+    { .Name = "cos", .FuncPtr = (CalcDoubleFn)cos, .VecFuncPtr = vcos, .IntervalFuncPtr = icos,
+      .DualFuncPtr = dcos, .Slope = "-sin(x)" },
+    { .Name = "tan", .FuncPtr = (CalcDoubleFn)tan, .VecFuncPtr = vtan, .IntervalFuncPtr = itan,
+      .DualFuncPtr = dtan, .Slope = "1 + tan(x)^2" },
+    { .Name = "sinc", .FuncPtr = (CalcDoubleFn)sinc, .VecFuncPtr = vsinc, .IntervalFuncPtr = isinc,
+      .DualFuncPtr = dsinc, .Slope = "d(sinc, x)" },
+
+    { .Name = "asin", .FuncPtr = (CalcDoubleFn)asin, .VecFuncPtr = vasin, .IntervalFuncPtr = iasin,
+      .DualFuncPtr = dasin, .Slope = "1 / sqrt(1 - x^2)" },
+    { .Name = "acos", .FuncPtr = (CalcDoubleFn)acos, .VecFuncPtr = vacos, .IntervalFuncPtr = iacos,
+      .DualFuncPtr = dacos, .Slope = "-1 / sqrt(1 - x^2)" },
+    { .Name = "atan", .FuncPtr = (CalcDoubleFn)atan, .VecFuncPtr = vatan, .IntervalFuncPtr = iatan,
+      .DualFuncPtr = datan, .Slope = "1 / (1 + x^2)" },
+
+    { .Name = "ln", .FuncPtr = (CalcDoubleFn)log, .VecFuncPtr = vln, .IntervalFuncPtr = iln,
+      .DualFuncPtr = dln, .Slope = "1 / x" },
+    { .Name = "log", .FuncPtr = (CalcDoubleFn)log10, .VecFuncPtr = vlog10, .IntervalFuncPtr = ilog10,
+      .DualFuncPtr = dlog10, .Slope = "1 / (x * ln(10))" },
+    { .Name = "sqrt", .FuncPtr = (CalcDoubleFn)sqrt, .VecFuncPtr = vsqrt, .IntervalFuncPtr = isqrt,
+      .DualFuncPtr = dsqrt, .Slope = "0.5 / sqrt(x)" },
+};
+constexpr int kNumFunctions = sizeof(kFunctions) / sizeof(kFunctions[0]);
+
+// builtins are numbered by a byte in Programs
+constexpr int kMaxBuiltinFuncs = 256;
+
+struct FunctionsState
 {
-    { .Name = "sin", .FuncPtr = (CalcDoubleFn)sin },
-    { .Name = "cos", .FuncPtr = (CalcDoubleFn)cos },
-    { .Name = "tan", .FuncPtr = (CalcDoubleFn)tan },
-    { .Name = "sinc", .FuncPtr = (CalcDoubleFn)sinc },
+    // kFunctions followed by any registered ones
+    std::vector<FunctionDef> Functions;
 
-    { .Name = "asin", .FuncPtr = (CalcDoubleFn)asin },
-    { .Name = "acos", .FuncPtr = (CalcDoubleFn)acos },
-    { .Name = "atan", .FuncPtr = (CalcDoubleFn)atan },
+    std::vector<Program> RegisteredCode;
+    std::vector<std::vector<char>> RegisteredNames;
 
-    { .Name = "ln", .FuncPtr = (CalcDoubleFn)log },
-    { .Name = "log", .FuncPtr = (CalcDoubleFn)log10 },
-    { .Name = "sqrt", .FuncPtr = (CalcDoubleFn)sqrt },
+    std::vector<UserFunction> UserFuncs;
+
+    // definitions are packed end to end, each with a terminating 0. redefining a function leaves
+    // its old text behind, which gets squeezed out once there's more dead text than live
+    std::vector<char> DefArena;
+    size_t DeadDefBytes = 0;
+
+    IdIndex BuiltinFuncIx;
+    IdIndex UserFuncIx;
+
+    int CallDepth = 0;
 };
-constexpr int kNumFunctions = sizeof(gFunctions) / sizeof(gFunctions[0]);
 
+FunctionsState* create_functions_state()
+{
+    return new FunctionsState;
+}
+
+void destroy_functions_state(FunctionsState* state)
+{
+    for (UserFunction& func : state->UserFuncs)
+        jit_free(func.Jit);
+    delete state;
+}
 
-UserFunction gUserFuncs[kMaxUserFuncs];
+static FunctionsState& func_state()
+{
+    return *calc_context().Functions;
+}
 
 //-----------------------------------------------------------------------------------------------
 
-static UserFunction* find_or_alloc_userfunc(const char* name)
+void init_functions()
 {
-    UserFunction* free_func = nullptr;
+    FunctionsState& state = func_state();
 
-    for (UserFunction& func : gUserFuncs)
+    state.BuiltinFuncIx = IdIndex();
+    state.UserFuncIx = IdIndex();
+
+    state.Functions.assign(kFunctions, kFunctions + kNumFunctions);
+    state.RegisteredCode.clear();
+    state.RegisteredNames.clear();
+
+    for (int i=0; i<kNumFunctions; ++i)
     {
-        if (!func.IsUsed)
-        {
-            if (!free_func)
-                free_func = &func;
-            continue;
-        }
+        const SymId id = intern(state.Functions[i].Name);
+        if (id != kNoSymId)
+            state.BuiltinFuncIx.Set(id, i);
+    }
+
+    for (UserFunction& func : state.UserFuncs)
+        jit_free(func.Jit);
+    state.UserFuncs.clear();
+
+    state.DefArena.clear();
+    state.DeadDefBytes = 0;
+}
 
-        if (strcmp(name, func.Name) == 0)
-            return &func;
+static UserFunction* find_or_alloc_userfunc(SymId name)
+{
+    FunctionsState& state = func_state();
+
+    if (name == kNoSymId)
+        return nullptr;
+
+    const int ix = state.UserFuncIx.Find(name);
+    if (ix >= 0)
+        return &state.UserFuncs[ix];
+
+    state.UserFuncIx.Set(name, int(state.UserFuncs.size()));
+    state.UserFuncs.emplace_back();
+    state.UserFuncs.back().Name = name;
+    return &state.UserFuncs.back();
+}
+
+static void compact_def_arena()
+{
+    FunctionsState& state = func_state();
+
+    std::vector<char> packed;
+    packed.reserve(state.DefArena.size() - state.DeadDefBytes);
+
+    for (UserFunction& func : state.UserFuncs)
+    {
+        const uint32_t offset = uint32_t(packed.size());
+        packed.insert(packed.end(), &state.DefArena[func.DefOffset], &state.DefArena[func.DefOffset] + func.DefLen + 1);
+        func.DefOffset = offset;
     }
 
-    if (free_func)
+    state.DefArena.swap(packed);
+    state.DeadDefBytes = 0;
+}
+
+static void store_def(UserFunction& func, const char* def, bool isRedefinition)
+{
+    FunctionsState& state = func_state();
+
+    if (isRedefinition)
+        state.DeadDefBytes += func.DefLen + 1;
+
+    func.DefLen = uint32_t(strlen(def));
+    func.DefOffset = uint32_t(state.DefArena.size());
+    state.DefArena.insert(state.DefArena.end(), def, def + func.DefLen + 1);
+
+    if (state.DeadDefBytes > state.DefArena.size() / 2)
+        compact_def_arena();
+}
+
+// compiles func's body into its Code, and records what it uses
+static bool compile_function(UserFunction& func, ParseCtx& ctx)
+{
+    // compile before touching func so a bad definition leaves the old one alone
+    Program code;
+    std::vector<SymId> uses;
+    advance_token(ctx);
+    if (!compile_expression(ctx, code, func.Arg, func.Name, &uses))
+        return false;
+    if (!accept(ctx, Token::Eof))
     {
-        strcpy(free_func->Name, name);
-        free_func->IsUsed = true;
-        return free_func;
+        on_parse_error(ctx, "trailing nonsense");
+        return false;
     }
 
-    return nullptr;
+    func.Code = std::move(code);
+    func.Stale = false;
+    ++func.Memo.Epoch;
+    set_uses(func.Name, uses);
+
+    jit_free(func.Jit);
+    func.Jit = jit_compile(func.Code);
+    return true;
+}
+
+// the body was compiled with things that have changed since, like an inlined function or the
+// value of a user symbol
+static void refresh_function(UserFunction& func)
+{
+    char errBuf[64];
+    ParseCtx ctx { .InBuffer = &func_state().DefArena[func.DefOffset], .ResBuffer = errBuf, .ResBufferLen = sizeof(errBuf) };
+    compile_function(func, ctx);
+}
+
+void mark_function_stale(SymId name)
+{
+    FunctionsState& state = func_state();
+
+    const int ix = state.UserFuncIx.Find(name);
+    if (ix < 0)
+        return;
+
+    UserFunction& func = state.UserFuncs[ix];
+    func.Stale = true;
+    ++func.Memo.Epoch;
 }
 
-bool define_function(const char* name, const char* arg, ParseCtx& ctx)
+bool define_function(SymId name, SymId arg, ParseCtx& ctx)
 {
+    // the arg would hide the constant inside the body, which is never what anyone wants
+    if (is_constant(arg))
+    {
+        on_parse_error(ctx, "can't redefine a constant");
+        return false;
+    }
+
+    // compile into a scratch function so a bad redefinition leaves the old one alone
+    UserFunction scratch;
+    scratch.Name = name;
+    scratch.Arg = arg;
+    if (!compile_function(scratch, ctx))
+        return false;
+
+    const bool isRedefinition = (func_state().UserFuncIx.Find(name) >= 0);
     UserFunction* func = find_or_alloc_userfunc(name);
     if (!func)
     {
+        jit_free(scratch.Jit);
         on_parse_error(ctx, "too many user funcs");
         return false;
     }
 
-    strcpy(func->Arg, arg);
+    func->Arg = arg;
+    store_def(*func, ctx.InBuffer, isRedefinition);
+    func->Code = std::move(scratch.Code);
+    func->Stale = false;
+    ++func->Memo.Epoch;
+
+    jit_free(func->Jit);
+    func->Jit = scratch.Jit;
+
+    definition_changed(name);
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+
+bool register_calc_func(CalcContext* calc, const char* name, calc_func fn, const char* def)
+{
+    if (!calc)
+        return false;
+
+    ContextScope scope(calc);
+    FunctionsState& state = func_state();
+
+    if (!name || !*name || !fn || !def || (int(state.Functions.size()) == kMaxBuiltinFuncs))
+        return false;
+
+    // named the way the parser reads names
+    std::vector<char> lowered(name, name + strlen(name) + 1);
+    std::transform(lowered.begin() + 1, lowered.end(), lowered.begin() + 1, to_lower_sym);
+
+    const SymId id = intern(lowered.data());
+    if ((id == kNoSymId) || (find_builtin_func(id) >= 0) || is_constant(id))
+        return false;
+
+    char errBuf[64];
+    ParseCtx ctx { .InBuffer = def, .ResBuffer = errBuf, .ResBufferLen = sizeof(errBuf) };
+    Program code;
+    advance_token(ctx);
+    if (!compile_expression(ctx, code, intern("x")) || !accept(ctx, Token::Eof))
+        return false;
+
+    state.RegisteredCode.push_back(std::move(code));
+    state.RegisteredNames.push_back(std::move(lowered));
 
-    if (strlen(ctx.InBuffer) > kMaxFuncDefLen)
+    FunctionDef func;
+    func.Name = state.RegisteredNames.back().data();
+    func.FuncPtr = fn;
+    func.CodeIx = int(state.RegisteredCode.size()) - 1;
+
+    state.BuiltinFuncIx.Set(id, int(state.Functions.size()));
+    state.Functions.push_back(func);
+    return true;
+}
+
+int find_builtin_func(SymId name)
+{
+    return func_state().BuiltinFuncIx.Find(name);
+}
+
+double call_builtin_func(int builtinIx, double arg1)
+{
+    return func_state().Functions[builtinIx].FuncPtr(arg1);
+}
+
+const char* builtin_func_name(int builtinIx)
+{
+    return func_state().Functions[builtinIx].Name;
+}
+
+const char* builtin_func_slope(int builtinIx)
+{
+    return func_state().Functions[builtinIx].Slope;
+}
+
+// returns the slot arg would be kept in, and its bits to compare with the slot's
+static MemoEntry& memo_slot(MemoCache& memo, double arg, uint64_t& outArgBits)
+{
+    memcpy(&outArgBits, &arg, sizeof(outArgBits));
+
+    // fibonacci hashing, since nearby args differ in bits all over the place
+    const uint64_t hash = outArgBits * 0x9e3779b97f4a7c15ull;
+    return memo.Entries[hash >> memo.IndexShift];
+}
+
+static bool memo_lookup(MemoCache& memo, const MemoEntry& slot, uint64_t argBits, double& outVal)
+{
+    if ((slot.Epoch != memo.Epoch) || (slot.ArgBits != argBits))
     {
-        on_parse_error(ctx, "function def too long");
+        ++memo.Misses;
         return false;
     }
 
-    strcpy(func->Def, ctx.InBuffer);
+    ++memo.Hits;
+    outVal = slot.Val;
     return true;
 }
 
-//-----------------------------------------------------------------------------------------------
-
-bool eval_function(const char* name, double arg1, double& outVal, ParseCtx& ctx)
+bool eval_function(SymId name, double arg1, double& outVal, ParseCtx& ctx)
 {
-    for (const FunctionDef& func : gFunctions)
+    const int builtinIx = find_builtin_func(name);
+    if (builtinIx >= 0)
     {
-        if (strcmp(func.Name, name) == 0)
-        {
-            outVal = func.FuncPtr(arg1);
-            return true;
-        }
+        outVal = call_builtin_func(builtinIx, arg1);
+        return true;
     }
 
-    for (const UserFunction& func : gUserFuncs)
+    if (const UserFunction* func = lookup_user_func(name))
     {
-        if (func.IsUsed && (strcmp(func.Name, name) == 0))
-        {
-            outVal = eval_user_func(&func, arg1, ctx);
-            return !ctx.Error;
-        }
+        outVal = eval_user_func(func, arg1, ctx);
+        return !ctx.Error;
     }
 
     outVal = 0.0;
@@ -136,58 +432,332 @@ bool eval_function(const char* name, double arg1, double& outVal, ParseCtx& ctx)
 
 double eval_user_func(const UserFunction* func, double arg1, ParseCtx& ctx)
 {
+    FunctionsState& state = func_state();
+
     if (!func)
     {
         on_parse_error(ctx, "missing function");
         return 0.0f;
     }
 
-    define_value(func->Arg, arg1, ctx);
+    if (func->Stale)
+    {
+        on_parse_error(ctx, "can't recompile function");
+        return 0.0;
+    }
 
-    ParseCtx innerCtx { .InBuffer = func->Def, .ResBuffer = ctx.ResBuffer, .ResBufferLen = ctx.ResBufferLen };
-    advance_token(innerCtx);
-    double val = parse_expression(innerCtx);
+    MemoCache& memo = func->Memo;
+    MemoEntry* slot = nullptr;
+    uint64_t argBits = 0;
+    double val = 0.0;
+    if (!memo.Entries.empty())
+    {
+        slot = &memo_slot(memo, arg1, argBits);
+        if (memo_lookup(memo, *slot, argBits, val))
+            return val;
+    }
 
-    if (innerCtx.Error)
-        ctx.Error = true;
+    if (state.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return 0.0;
+    }
 
-    undef_value(func->Arg);
+    ++state.CallDepth;
+    if (func->Jit && jit_enabled())
+        val = func->Jit(arg1, &ctx);
+    else if (!run_program(func->Code, arg1, val, ctx))
+        val = 0.0;
+    --state.CallDepth;
+
+    if (slot && !ctx.Error)
+        *slot = { .ArgBits = argBits, .Val = val, .Epoch = memo.Epoch };
 
     return val;
 }
 
 //-----------------------------------------------------------------------------------------------
 
-bool is_user_func(const char* name)
+void call_builtin_func_batch(int builtinIx, const double* args, double* outVals, int count)
 {
-    return (lookup_user_func(name) != nullptr);
+    FunctionsState& state = func_state();
+
+    if (const CalcDoubleVecFn vecFn = state.Functions[builtinIx].VecFuncPtr)
+    {
+        vecFn(args, outVals, count);
+        return;
+    }
+
+    const CalcDoubleFn fn = state.Functions[builtinIx].FuncPtr;
+    for (int i=0; i<count; ++i)
+        outVals[i] = fn(args[i]);
 }
 
-const UserFunction* lookup_user_func(const char* name)
+bool eval_function_batch(SymId name, const double* args, double* outVals, int count, ParseCtx& ctx)
 {
-    for (const UserFunction& func : gUserFuncs)
+    const int builtinIx = find_builtin_func(name);
+    if (builtinIx >= 0)
     {
-        if (func.IsUsed && (strcmp(func.Name, name) == 0))
-            return &func;
+        call_builtin_func_batch(builtinIx, args, outVals, count);
+        return true;
     }
 
-    return nullptr;
+    if (const UserFunction* func = lookup_user_func(name))
+        return eval_user_func_batch(func, args, outVals, count, ctx);
+
+    return false;
+}
+
+// answers what it can from the cache, and runs the rest as a smaller batch. the batch results
+// aren't stored, since the vector maths can be an ulp or so off what f(x) gives (see vmaths.h),
+// and the cache has to give back exactly what f(x) would
+static bool run_memo_batch(const UserFunction* func, const double* args, double* outVals, int count, ParseCtx& ctx)
+{
+    constexpr int kChunk = 64;
+
+    MemoCache& memo = func->Memo;
+    for (int start = 0; start < count; start += kChunk)
+    {
+        const int chunkLen = (count - start < kChunk) ? (count - start) : kChunk;
+
+        double missArgs[kChunk];
+        double missVals[kChunk];
+        int missIx[kChunk];
+        int numMisses = 0;
+
+        for (int i = start; i < start + chunkLen; ++i)
+        {
+            uint64_t argBits;
+            const double arg = args[i];
+            const MemoEntry& slot = memo_slot(memo, arg, argBits);
+            if (!memo_lookup(memo, slot, argBits, outVals[i]))
+            {
+                missArgs[numMisses] = arg;
+                missIx[numMisses] = i;
+                ++numMisses;
+            }
+        }
+
+        if (numMisses == 0)
+            continue;
+
+        if (!run_program_batch(func->Code, missArgs, missVals, numMisses, ctx))
+            return false;
+
+        for (int j = 0; j < numMisses; ++j)
+            outVals[missIx[j]] = missVals[j];
+    }
+
+    return true;
+}
+
+bool eval_user_func_batch(const UserFunction* func, const double* args, double* outVals, int count, ParseCtx& ctx)
+{
+    FunctionsState& state = func_state();
+
+    if (!func)
+    {
+        on_parse_error(ctx, "missing function");
+        return false;
+    }
+
+    if (func->Stale)
+    {
+        on_parse_error(ctx, "can't recompile function");
+        return false;
+    }
+
+    if (state.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return false;
+    }
+
+    ++state.CallDepth;
+    const bool ok = func->Memo.Entries.empty() ? run_program_batch(func->Code, args, outVals, count, ctx)
+                                               : run_memo_batch(func, args, outVals, count, ctx);
+    --state.CallDepth;
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------
+
+Dual call_builtin_func_dual(int builtinIx, const Dual& arg1)
+{
+    FunctionsState& state = func_state();
+
+    const FunctionDef& def = state.Functions[builtinIx];
+    if (def.DualFuncPtr)
+        return def.DualFuncPtr(arg1);
+
+    // nothing shows the error, and its position is in the def it was registered with, which is gone
+    ParseCtx ctx { .InBuffer = "" };
+    Dual res;
+    if (!run_program_dual(state.RegisteredCode[def.CodeIx], arg1, res, ctx))
+        return { .Val = NAN, .Deriv = NAN };
+    return res;
+}
+
+bool eval_function_dual(SymId name, const Dual& arg1, Dual& outVal, ParseCtx& ctx)
+{
+    const int builtinIx = find_builtin_func(name);
+    if (builtinIx >= 0)
+    {
+        outVal = call_builtin_func_dual(builtinIx, arg1);
+        return true;
+    }
+
+    if (const UserFunction* func = lookup_user_func(name))
+        return eval_user_func_dual(func, arg1, outVal, ctx);
+
+    return false;
+}
+
+// the memo cache only has values, so it isn't used here
+bool eval_user_func_dual(const UserFunction* func, const Dual& arg1, Dual& outVal, ParseCtx& ctx)
+{
+    FunctionsState& state = func_state();
+
+    if (!func)
+    {
+        on_parse_error(ctx, "missing function");
+        return false;
+    }
+
+    if (func->Stale)
+    {
+        on_parse_error(ctx, "can't recompile function");
+        return false;
+    }
+
+    if (state.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return false;
+    }
+
+    ++state.CallDepth;
+    const bool ok = run_program_dual(func->Code, arg1, outVal, ctx);
+    --state.CallDepth;
+
+    return ok;
+}
+
+bool eval_derivative(SymId name, double arg1, double& outVal, ParseCtx& ctx)
+{
+    Dual res;
+    if (!eval_function_dual(name, { .Val = arg1, .Deriv = 1.0 }, res, ctx))
+    {
+        outVal = 0.0;
+        return false;
+    }
+
+    outVal = res.Deriv;
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+
+Interval call_builtin_func_interval(int builtinIx, const Interval& arg1)
+{
+    FunctionsState& state = func_state();
+
+    const FunctionDef& def = state.Functions[builtinIx];
+    if (def.IntervalFuncPtr)
+        return def.IntervalFuncPtr(arg1);
+
+    // if it can't be run over the range, all that's known is it could be anything
+    ParseCtx ctx { .InBuffer = "" };
+    Interval res;
+    if (!run_program_interval(state.RegisteredCode[def.CodeIx], arg1, res, ctx))
+        return { .Lo = -HUGE_VAL, .Hi = HUGE_VAL, .Cont = false };
+    return res;
+}
+
+bool eval_function_interval(SymId name, const Interval& arg1, Interval& outVal, ParseCtx& ctx)
+{
+    const int builtinIx = find_builtin_func(name);
+    if (builtinIx >= 0)
+    {
+        outVal = call_builtin_func_interval(builtinIx, arg1);
+        return true;
+    }
+
+    if (const UserFunction* func = lookup_user_func(name))
+        return eval_user_func_interval(func, arg1, outVal, ctx);
+
+    return false;
+}
+
+// the memo cache is keyed on single args, so it isn't used here
+bool eval_user_func_interval(const UserFunction* func, const Interval& arg1, Interval& outVal, ParseCtx& ctx)
+{
+    FunctionsState& state = func_state();
+
+    if (!func)
+    {
+        on_parse_error(ctx, "missing function");
+        return false;
+    }
+
+    if (func->Stale)
+    {
+        on_parse_error(ctx, "can't recompile function");
+        return false;
+    }
+
+    if (state.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return false;
+    }
+
+    ++state.CallDepth;
+    const bool ok = run_program_interval(func->Code, arg1, outVal, ctx);
+    --state.CallDepth;
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------
+
+bool is_user_func(SymId name)
+{
+    return (lookup_user_func(name) != nullptr);
+}
+
+const UserFunction* lookup_user_func(SymId name)
+{
+    FunctionsState& state = func_state();
+
+    const int ix = state.UserFuncIx.Find(name);
+    if (ix < 0)
+        return nullptr;
+
+    UserFunction& func = state.UserFuncs[ix];
+    if (func.Stale)
+        refresh_function(func);
+
+    return &func;
 }
 
 //-----------------------------------------------------------------------------------------------
 
 BuiltinFunctionIt function_builtin_begin()
 {
-    return gFunctions;
+    return func_state().Functions.data();
 }
 
 BuiltinFunctionIt function_next(BuiltinFunctionIt it)
 {
+    FunctionsState& state = func_state();
+
     if (!it)
         return nullptr;
 
     ++it;
-    if (it >= (gFunctions + kNumFunctions))
+    if (it >= (state.Functions.data() + state.Functions.size()))
         return nullptr;
 
     return it;
@@ -202,41 +772,110 @@ const char* function_name(BuiltinFunctionIt it)
 
 UserFunctionIt function_user_begin()
 {
-    UserFunctionIt it = gUserFuncs;
-    if (!it->IsUsed)
-        it = function_next(it);
+    FunctionsState& state = func_state();
 
-    return it;
+    return state.UserFuncs.empty() ? nullptr : state.UserFuncs.data();
 }
 
 UserFunctionIt function_next(UserFunctionIt it)
 {
+    FunctionsState& state = func_state();
+
     if (!it)
         return nullptr;
 
-    for (++it; it <= gUserFuncs + kMaxUserFuncs; ++it)
-    {
-        if (it->IsUsed)
-            return it;
-    }
+    ++it;
+    if (it >= state.UserFuncs.data() + state.UserFuncs.size())
+        return nullptr;
 
-    return nullptr;
+    return it;
 }
 
 const char* function_name(UserFunctionIt it)
 {
-    if (!it || !it->IsUsed)
+    if (!it)
         return "<undefined>";
 
-    return it->Name;
+    return interned_name(it->Name);
 }
 
 const char* function_def(UserFunctionIt it)
 {
-    if (!it || !it->IsUsed)
+    if (!it)
         return "<undefined>";
 
-    return it->Def;
+    return &func_state().DefArena[it->DefOffset];
+}
+
+SymId function_arg(UserFunctionIt it)
+{
+    return it ? it->Arg : kNoSymId;
+}
+
+int function_nodes_shared(UserFunctionIt it)
+{
+    return it ? it->Code.NodesShared : 0;
+}
+
+int function_memo_size(UserFunctionIt it)
+{
+    return it ? int(it->Memo.Entries.size()) : 0;
+}
+
+void function_memo_stats(UserFunctionIt it, uint32_t& outHits, uint32_t& outMisses)
+{
+    outHits = it ? it->Memo.Hits : 0;
+    outMisses = it ? it->Memo.Misses : 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+
+bool set_memo_size(SymId name, int size)
+{
+    FunctionsState& state = func_state();
+
+    const int ix = state.UserFuncIx.Find(name);
+    if (ix < 0)
+        return false;
+
+    MemoCache& memo = state.UserFuncs[ix].Memo;
+    if (size < 0)
+        size = kDefaultMemoSize;
+    if (size > kMaxMemoSize)
+        size = kMaxMemoSize;
+
+    // at least 2 entries, since a shift by 64 isn't allowed
+    int bits = 1;
+    while ((1 << bits) < size)
+        ++bits;
+    const size_t numEntries = (size == 0) ? 0 : (size_t(1) << bits);
+
+    // asking for the size it already is keeps what's cached, and the stats
+    if (memo.Entries.size() == numEntries)
+        return true;
+
+    memo = MemoCache();
+    if (numEntries == 0)
+        return true;
+
+    memo.Entries.resize(numEntries);
+    memo.IndexShift = 64 - bits;
+    return true;
+}
+
+bool clear_memo(SymId name)
+{
+    FunctionsState& state = func_state();
+
+    const int ix = state.UserFuncIx.Find(name);
+    if (ix < 0)
+        return false;
+
+    MemoCache& memo = state.UserFuncs[ix].Memo;
+    ++memo.Epoch;
+    memo.Hits = 0;
+    memo.Misses = 0;
+    return true;
 }
 
 
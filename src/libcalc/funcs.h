@@ -1,22 +1,69 @@
 #pragma once
 
+#include "intern.h"
+
 //-------------------------------------------------------------------------------------------------
 
+struct Dual;
+struct Interval;
 struct ParseCtx;
 struct UserFunction;
 
 //-------------------------------------------------------------------------------------------------
 
-bool eval_function(const char* name, double arg1, double& outVal, ParseCtx& ctx);
+bool eval_function(SymId name, double arg1, double& outVal, ParseCtx& ctx);
+
+// returns -1 if there's no builtin with that name
+int find_builtin_func(SymId name);
+double call_builtin_func(int builtinIx, double arg1);
+const char* builtin_func_name(int builtinIx);
+
+// the builtin's derivative written as an expression in x, see deriv.h
+const char* builtin_func_slope(int builtinIx);
+
+// batch versions evaluate count args in one go. args and outVals may be the same array
+void call_builtin_func_batch(int builtinIx, const double* args, double* outVals, int count);
+bool eval_function_batch(SymId name, const double* args, double* outVals, int count, ParseCtx& ctx);
+bool eval_user_func_batch(const UserFunction* func, const double* args, double* outVals, int count, ParseCtx& ctx);
 
 double eval_user_func(const UserFunction* func, double arg1, ParseCtx& ctx);
 
+// dual number versions give the derivative along with the value, see dual.h
+Dual call_builtin_func_dual(int builtinIx, const Dual& arg1);
+bool eval_function_dual(SymId name, const Dual& arg1, Dual& outVal, ParseCtx& ctx);
+bool eval_user_func_dual(const UserFunction* func, const Dual& arg1, Dual& outVal, ParseCtx& ctx);
+
+// the slope of builtin or user function name at arg1. false if there's no such function
+bool eval_derivative(SymId name, double arg1, double& outVal, ParseCtx& ctx);
+
+// interval versions give every value the function takes over a range of args, see interval.h
+Interval call_builtin_func_interval(int builtinIx, const Interval& arg1);
+bool eval_function_interval(SymId name, const Interval& arg1, Interval& outVal, ParseCtx& ctx);
+bool eval_user_func_interval(const UserFunction* func, const Interval& arg1, Interval& outVal, ParseCtx& ctx);
+
 //-------------------------------------------------------------------------------------------------
 
-bool define_function(const char* name, const char* arg, ParseCtx& ctx);
+struct FunctionsState;
+FunctionsState* create_functions_state();
+void destroy_functions_state(FunctionsState* state);
+
+void init_functions();
+
+// compiles the rest of ctx's input as the body of function name(arg)
+bool define_function(SymId name, SymId arg, ParseCtx& ctx);
+
+bool is_user_func(SymId name);
+const UserFunction* lookup_user_func(SymId name);
+
+// the function will be compiled again before it's next used, see deps.h
+void mark_function_stale(SymId name);
 
-bool is_user_func(const char* name);
-const UserFunction* lookup_user_func(const char* name);
+// each user function can keep a cache of its results, which is off by default. size is rounded
+// up to a power of 2 (at least 2), negative gives the default size and 0 turns the cache off.
+// setting the size it already has leaves the cache alone; only clear_memo empties it. both
+// return false if there's no such function
+bool set_memo_size(SymId name, int size);
+bool clear_memo(SymId name);
 
 //-------------------------------------------------------------------------------------------------
 
@@ -34,6 +81,10 @@ UserFunctionIt function_user_begin();
 UserFunctionIt function_next(UserFunctionIt it);
 const char* function_name(UserFunctionIt it);
 const char* function_def(UserFunctionIt it);
+SymId function_arg(UserFunctionIt it);
+int function_nodes_shared(UserFunctionIt it);   // how much smaller common subexpressions made it
+int function_memo_size(UserFunctionIt it);
+void function_memo_stats(UserFunctionIt it, uint32_t& outHits, uint32_t& outMisses);
 
 //-------------------------------------------------------------------------------------------------
 
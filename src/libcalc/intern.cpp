@@ -0,0 +1,218 @@
+#include "intern.h"
+
+#include "context.h"
+#include "parser.h"
+
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+// names of the builtin constants, functions and commands. these have fixed ids and are found
+// with a perfect hash, so looking one up costs a single strcmp. anything missing from here still
+// works, it just gets interned like a user name
+static constexpr const char* kBuiltinNames[] =
+{
+    // symbols.cpp
+    "pi", "e",
+
+    // funcs.cpp
+    "sin", "cos", "tan", "sinc",
+    "asin", "acos", "atan",
+    "ln", "log", "sqrt",
+    "d", "deriv",
+
+    // commands
+    "help", "list", "stats", "memo", "g",
+    "dd", "pd", "df", "pf", "ds", "ps",
+    "jit",
+};
+constexpr int kNumBuiltinNames = sizeof(kBuiltinNames) / sizeof(kBuiltinNames[0]);
+
+constexpr int kBuiltinHashSize = 128;
+static_assert(kNumBuiltinNames < kBuiltinHashSize / 2);
+
+//-------------------------------------------------------------------------------------------------
+
+// fnv-1a
+static constexpr uint32_t hash_name(const char* name, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (; *name; ++name)
+    {
+        h ^= uint8_t(*name);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+struct BuiltinHash
+{
+    uint32_t Seed = 0;
+    int8_t Slots[kBuiltinHashSize] = {};
+};
+
+// tries seeds until every builtin name lands in its own slot
+static constexpr BuiltinHash make_builtin_hash()
+{
+    BuiltinHash bh;
+    for (uint32_t seed = 1; ; ++seed)
+    {
+        for (int8_t& slot : bh.Slots)
+            slot = -1;
+
+        bool collided = false;
+        for (int i = 0; i < kNumBuiltinNames && !collided; ++i)
+        {
+            int8_t& slot = bh.Slots[hash_name(kBuiltinNames[i], seed) & (kBuiltinHashSize - 1)];
+            collided = (slot >= 0);
+            slot = int8_t(i);
+        }
+
+        if (!collided)
+        {
+            bh.Seed = seed;
+            return bh;
+        }
+    }
+}
+
+static constexpr BuiltinHash kBuiltinHash = make_builtin_hash();
+
+//-------------------------------------------------------------------------------------------------
+
+// everything else goes in an open addressed table of ids, which is kept at most half full.
+// the names themselves are packed end to end, and the ones past NumKept are given back at the
+// end of the statement
+struct InternState
+{
+    std::vector<char> NameChars;
+    std::vector<uint32_t> NameOffsets;
+    size_t NumKept = 0;
+
+    std::vector<SymId> UserHash;
+};
+
+InternState* create_intern_state()
+{
+    return new InternState;
+}
+
+void destroy_intern_state(InternState* state)
+{
+    delete state;
+}
+
+static InternState& intern_state()
+{
+    return *calc_context().Intern;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static SymId find_builtin(const char* name)
+{
+    const int ix = kBuiltinHash.Slots[hash_name(name, kBuiltinHash.Seed) & (kBuiltinHashSize - 1)];
+    if (ix >= 0 && strcmp(kBuiltinNames[ix], name) == 0)
+        return SymId(ix);
+
+    return kNoSymId;
+}
+
+// returns the slot holding name, or the empty slot it should go in
+static SymId* find_user_slot(const char* name)
+{
+    InternState& state = intern_state();
+
+    if (state.UserHash.empty())
+        state.UserHash.resize(64, kNoSymId);
+
+    const size_t mask = state.UserHash.size() - 1;
+    for (uint32_t ix = hash_name(name, 0); ; ++ix)
+    {
+        SymId* slot = &state.UserHash[ix & mask];
+        if (*slot == kNoSymId || strcmp(interned_name(*slot), name) == 0)
+            return slot;
+    }
+}
+
+static void grow_user_hash()
+{
+    InternState& state = intern_state();
+
+    state.UserHash.assign(state.UserHash.size() * 2, kNoSymId);
+
+    for (size_t i = 0; i < state.NameOffsets.size(); ++i)
+        *find_user_slot(&state.NameChars[state.NameOffsets[i]]) = SymId(kNumBuiltinNames + i);
+}
+
+SymId find_interned(const char* name)
+{
+    const SymId id = find_builtin(name);
+    if (id != kNoSymId)
+        return id;
+
+    return *find_user_slot(name);
+}
+
+SymId intern(const char* name)
+{
+    const SymId id = find_builtin(name);
+    if (id != kNoSymId)
+        return id;
+
+    SymId* slot = find_user_slot(name);
+    if (*slot != kNoSymId)
+        return *slot;
+
+    InternState& state = intern_state();
+
+    const size_t numIds = kNumBuiltinNames + state.NameOffsets.size();
+    if (numIds >= kNoSymId)
+        return kNoSymId;
+
+    const size_t len = strlen(name);
+    state.NameOffsets.push_back(uint32_t(state.NameChars.size()));
+    state.NameChars.insert(state.NameChars.end(), name, name + len);
+    state.NameChars.push_back(0);
+
+    *slot = SymId(numIds);
+
+    if (2 * state.NameOffsets.size() > state.UserHash.size())
+        grow_user_hash();
+
+    return SymId(numIds);
+}
+
+void keep_interned_names()
+{
+    InternState& state = intern_state();
+    state.NumKept = state.NameOffsets.size();
+}
+
+void drop_unkept_names()
+{
+    InternState& state = intern_state();
+
+    // newest first, so each slot that's emptied is one no older name had to probe past
+    while (state.NameOffsets.size() > state.NumKept)
+    {
+        *find_user_slot(&state.NameChars[state.NameOffsets.back()]) = kNoSymId;
+        state.NameChars.resize(state.NameOffsets.back());
+        state.NameOffsets.pop_back();
+    }
+}
+
+const char* interned_name(SymId id)
+{
+    if (id < kNumBuiltinNames)
+        return kBuiltinNames[id];
+
+    const InternState& state = intern_state();
+    const size_t userIx = id - kNumBuiltinNames;
+    if (userIx < state.NameOffsets.size())
+        return &state.NameChars[state.NameOffsets[userIx]];
+
+    return "<unknown>";
+}
+
+//-------------------------------------------------------------------------------------------------
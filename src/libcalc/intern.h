@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+// every identifier gets turned into a small integer once, when it's lexed, and everything after
+// that - symbol values, functions, commands - is looked up by indexing with the id
+using SymId = uint16_t;
+
+constexpr SymId kNoSymId = 0xffff;
+
+//-------------------------------------------------------------------------------------------------
+
+// ids are per CalcContext
+struct InternState;
+InternState* create_intern_state();
+void destroy_intern_state(InternState* state);
+
+// returns kNoSymId if we've run out of ids
+SymId intern(const char* name);
+
+// names interned while a statement runs are only there for that statement, unless something
+// that outlives it - a definition - keeps them. eval_statement keeps whatever came in between
+// statements, and drops the rest when it's done, so lexing names never uses up ids by itself
+void keep_interned_names();
+void drop_unkept_names();
+
+// returns kNoSymId if name has never been interned
+SymId find_interned(const char* name);
+
+// the pointer is only good until the next name is interned
+const char* interned_name(SymId id);
+
+//-------------------------------------------------------------------------------------------------
+
+// maps ids to an index into some other table, growing as bigger ids turn up
+struct IdIndex
+{
+    std::vector<uint32_t> Ix;   // 1 + index, or 0 if the id isn't in the table
+
+    int Find(SymId id) const
+    {
+        return (id < Ix.size()) ? int(Ix[id]) - 1 : -1;
+    }
+
+    void Set(SymId id, int ix)
+    {
+        if (id >= Ix.size())
+            Ix.resize(id + 1, 0);
+        Ix[id] = uint32_t(1 + ix);
+    }
+
+    void Clear(SymId id)
+    {
+        if (id < Ix.size())
+            Ix[id] = 0;
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
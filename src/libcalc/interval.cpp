@@ -0,0 +1,426 @@
+#include "interval.h"
+
+#include "bytecode.h"
+#include "funcs.h"
+#include "maths.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+//-------------------------------------------------------------------------------------------------
+
+// the most negative value sinc takes, near x = 4.49
+constexpr double kSincMin = -0.21723362821122166;
+
+//-------------------------------------------------------------------------------------------------
+
+static Interval empty_interval()
+{
+    return { .Lo = NAN, .Hi = NAN, .Cont = false };
+}
+
+// what's left when nothing useful is known, eg. across a pole
+static Interval whole_line()
+{
+    return { .Lo = -INFINITY, .Hi = INFINITY, .Cont = false };
+}
+
+static Interval span_of(double a, double b, double c, double d, bool cont)
+{
+    return {
+        .Lo = std::min(std::min(a, b), std::min(c, d)),
+        .Hi = std::max(std::max(a, b), std::max(c, d)),
+        .Cont = cont
+    };
+}
+
+// 0 * inf is 0 here rather than nan, since an end at inf stands for "as big as you like"
+static double mul_ends(double a, double b)
+{
+    return (a == 0.0 || b == 0.0) ? 0.0 : a * b;
+}
+
+// clips in to [lo, hi], where a function is defined. false if there's nothing left
+static bool clip_domain(const Interval& in, double lo, double hi, Interval& out)
+{
+    if (is_empty(in) || in.Hi < lo || in.Lo > hi)
+        return false;
+
+    out.Lo = std::max(in.Lo, lo);
+    out.Hi = std::min(in.Hi, hi);
+    out.Cont = in.Cont && (in.Lo >= lo) && (in.Hi <= hi);
+    return true;
+}
+
+// true if [lo, hi] holds phase + 2pi k for some integer k
+static bool holds_phase(double lo, double hi, double phase)
+{
+    const double k = std::ceil((lo - phase) / (2*pi));
+    return (phase + k*2*pi) <= hi;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static Interval iadd(const Interval& a, const Interval& b)
+{
+    if (is_empty(a) || is_empty(b))
+        return empty_interval();
+
+    return { .Lo = a.Lo + b.Lo, .Hi = a.Hi + b.Hi, .Cont = a.Cont && b.Cont };
+}
+
+static Interval isub(const Interval& a, const Interval& b)
+{
+    if (is_empty(a) || is_empty(b))
+        return empty_interval();
+
+    return { .Lo = a.Lo - b.Hi, .Hi = a.Hi - b.Lo, .Cont = a.Cont && b.Cont };
+}
+
+static Interval imul(const Interval& a, const Interval& b)
+{
+    if (is_empty(a) || is_empty(b))
+        return empty_interval();
+
+    return span_of(mul_ends(a.Lo, b.Lo), mul_ends(a.Lo, b.Hi), mul_ends(a.Hi, b.Lo), mul_ends(a.Hi, b.Hi),
+                   a.Cont && b.Cont);
+}
+
+static Interval idiv(const Interval& a, const Interval& b)
+{
+    if (is_empty(a) || is_empty(b))
+        return empty_interval();
+
+    // dividing by exactly 0 is never drawn, and anywhere near it is a pole
+    if (b.Lo == 0.0 && b.Hi == 0.0)
+        return empty_interval();
+    if (b.Lo <= 0.0 && b.Hi >= 0.0)
+        return whole_line();
+
+    const Interval recip = { .Lo = 1.0 / b.Hi, .Hi = 1.0 / b.Lo, .Cont = b.Cont };
+    return imul(a, recip);
+}
+
+static Interval ipow_int(const Interval& a, int n)
+{
+    const double lo = std::pow(a.Lo, n);
+    const double hi = std::pow(a.Hi, n);
+
+    if ((n & 1) || a.Lo >= 0.0)
+        return { .Lo = lo, .Hi = hi, .Cont = a.Cont };
+    if (a.Hi <= 0.0)
+        return { .Lo = hi, .Hi = lo, .Cont = a.Cont };
+
+    return { .Lo = 0.0, .Hi = std::max(lo, hi), .Cont = a.Cont };
+}
+
+static Interval ipow(const Interval& a, const Interval& b)
+{
+    if (is_empty(a) || is_empty(b))
+        return empty_interval();
+
+    const bool bIsPoint = (b.Lo == b.Hi);
+    if (bIsPoint && b.Lo == std::trunc(b.Lo) && std::fabs(b.Lo) < 64.0)
+    {
+        const int n = int(b.Lo);
+        if (n == 0)
+            return { .Lo = 1.0, .Hi = 1.0, .Cont = a.Cont && b.Cont };
+        if (n < 0)
+            return idiv(interval_point(1.0), ipow_int(a, -n));
+
+        Interval res = ipow_int(a, n);
+        res.Cont = res.Cont && b.Cont;
+        return res;
+    }
+
+    // with a positive base, pow only ever goes one way in each arg, so the corners bound it
+    if (a.Lo > 0.0 || (a.Lo == 0.0 && b.Lo > 0.0))
+    {
+        return span_of(std::pow(a.Lo, b.Lo), std::pow(a.Lo, b.Hi), std::pow(a.Hi, b.Lo), std::pow(a.Hi, b.Hi),
+                       a.Cont && b.Cont);
+    }
+
+    // a negative base to a fractional power is nan
+    if (a.Hi < 0.0 && bIsPoint)
+        return empty_interval();
+
+    return whole_line();
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Interval isin(const Interval& in)
+{
+    if (is_empty(in))
+        return empty_interval();
+    if (in.Hi - in.Lo >= 2*pi)
+        return { .Lo = -1.0, .Hi = 1.0, .Cont = in.Cont };
+
+    const double a = sin(in.Lo);
+    const double b = sin(in.Hi);
+    return {
+        .Lo = holds_phase(in.Lo, in.Hi, -pi/2) ? -1.0 : std::min(a, b),
+        .Hi = holds_phase(in.Lo, in.Hi, pi/2) ? 1.0 : std::max(a, b),
+        .Cont = in.Cont
+    };
+}
+
+Interval icos(const Interval& in)
+{
+    if (is_empty(in))
+        return empty_interval();
+    if (in.Hi - in.Lo >= 2*pi)
+        return { .Lo = -1.0, .Hi = 1.0, .Cont = in.Cont };
+
+    const double a = cos(in.Lo);
+    const double b = cos(in.Hi);
+    return {
+        .Lo = holds_phase(in.Lo, in.Hi, pi) ? -1.0 : std::min(a, b),
+        .Hi = holds_phase(in.Lo, in.Hi, 0.0) ? 1.0 : std::max(a, b),
+        .Cont = in.Cont
+    };
+}
+
+Interval itan(const Interval& in)
+{
+    if (is_empty(in))
+        return empty_interval();
+
+    // the poles are pi apart, at pi/2 + k pi
+    const double k = std::ceil((in.Lo - pi/2) / pi);
+    if ((in.Hi - in.Lo >= pi) || (pi/2 + k*pi <= in.Hi))
+        return whole_line();
+
+    return { .Lo = tan(in.Lo), .Hi = tan(in.Hi), .Cont = in.Cont };
+}
+
+Interval isinc(const Interval& in)
+{
+    if (is_empty(in))
+        return empty_interval();
+    if (in.Lo > 0.0 || in.Hi < 0.0)
+        return idiv(isin(in), in);
+
+    // around 0 it's at most 1, and it only falls as |x| grows out to pi
+    const double furthest = std::max(-in.Lo, in.Hi);
+    const double lo = (furthest <= pi) ? sinc(furthest) : kSincMin;
+    return { .Lo = lo, .Hi = 1.0, .Cont = in.Cont };
+}
+
+Interval iasin(const Interval& in)
+{
+    Interval dom;
+    if (!clip_domain(in, -1.0, 1.0, dom))
+        return empty_interval();
+
+    return { .Lo = asin(dom.Lo), .Hi = asin(dom.Hi), .Cont = dom.Cont };
+}
+
+Interval iacos(const Interval& in)
+{
+    Interval dom;
+    if (!clip_domain(in, -1.0, 1.0, dom))
+        return empty_interval();
+
+    return { .Lo = acos(dom.Hi), .Hi = acos(dom.Lo), .Cont = dom.Cont };
+}
+
+Interval iatan(const Interval& in)
+{
+    if (is_empty(in))
+        return empty_interval();
+
+    return { .Lo = atan(in.Lo), .Hi = atan(in.Hi), .Cont = in.Cont };
+}
+
+// ln(0) is -inf, which is fine as the end of an interval
+Interval iln(const Interval& in)
+{
+    Interval dom;
+    if (!clip_domain(in, 0.0, INFINITY, dom))
+        return empty_interval();
+
+    return { .Lo = log(dom.Lo), .Hi = log(dom.Hi), .Cont = dom.Cont && (dom.Lo > 0.0) };
+}
+
+Interval ilog10(const Interval& in)
+{
+    Interval dom;
+    if (!clip_domain(in, 0.0, INFINITY, dom))
+        return empty_interval();
+
+    return { .Lo = log10(dom.Lo), .Hi = log10(dom.Hi), .Cont = dom.Cont && (dom.Lo > 0.0) };
+}
+
+Interval isqrt(const Interval& in)
+{
+    Interval dom;
+    if (!clip_domain(in, 0.0, INFINITY, dom))
+        return empty_interval();
+
+    return { .Lo = sqrt(dom.Lo), .Hi = sqrt(dom.Hi), .Cont = dom.Cont };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+bool run_program_interval(const Program& prog, const Interval& arg, Interval& outVal, ParseCtx& ctx)
+{
+    char errBuf[20+kMaxSymbolLength+1];
+
+    Interval localStack[kMaxProgramStack];
+    std::vector<Interval> bigStack;
+    Interval* stack = localStack;
+    if (prog.MaxDepth > kMaxProgramStack)
+    {
+        bigStack.resize(prog.MaxDepth);
+        stack = bigStack.data();
+    }
+
+    Interval* top = stack - 1;
+    Interval temps[kMaxProgramTemps];
+
+    const Instr* in = prog.Code.data();
+    const Instr* inEnd = in + prog.Code.size();
+    for (; in != inEnd; ++in)
+    {
+        switch (in->Code)
+        {
+        case Op::Const:
+            *(++top) = interval_point(prog.Consts[in->Operand]);
+            break;
+
+        case Op::Arg:
+            *(++top) = arg;
+            break;
+
+        case Op::Sym:
+        {
+            double val;
+            if (!eval_named_value(prog.Names[in->Operand], val))
+            {
+                sprintf(errBuf, "unknown named val: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            *(++top) = interval_point(val);
+            break;
+        }
+
+        case Op::Dup:
+            ++top;
+            *top = top[-1];
+            break;
+
+        case Op::Load:
+            *(++top) = temps[in->Operand];
+            break;
+
+        case Op::Store:
+            temps[in->Operand] = *top;
+            break;
+
+        case Op::Call:
+            *top = call_builtin_func_interval(in->Operand, *top);
+            break;
+
+        case Op::CallUser:
+            if (!eval_function_interval(prog.Names[in->Operand], *top, *top, ctx))
+            {
+                if (ctx.Error)
+                    return false;
+
+                sprintf(errBuf, "unknown func: %s", interned_name(prog.Names[in->Operand]));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            break;
+
+        case Op::Deriv:
+        {
+            // only a single arg is worked out properly. otherwise all that's known is that the
+            // slope is unbroken wherever the function is, since the builtins are all smooth
+            // inside their domains
+            const SymId name = prog.Names[in->Operand];
+            if (top->Lo == top->Hi)
+            {
+                double slope;
+                if (!eval_derivative(name, top->Lo, slope, ctx))
+                {
+                    if (ctx.Error)
+                        return false;
+
+                    sprintf(errBuf, "unknown func: %s", interned_name(name));
+                    on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                    return false;
+                }
+                *top = { .Lo = slope, .Hi = slope, .Cont = top->Cont };
+                break;
+            }
+
+            Interval vals;
+            if (!eval_function_interval(name, *top, vals, ctx))
+            {
+                if (ctx.Error)
+                    return false;
+
+                sprintf(errBuf, "unknown func: %s", interned_name(name));
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], errBuf);
+                return false;
+            }
+            *top = is_empty(vals) ? empty_interval() : Interval { .Lo = -INFINITY, .Hi = INFINITY, .Cont = vals.Cont };
+            break;
+        }
+
+        case Op::Neg:
+            *top = { .Lo = -top->Hi, .Hi = -top->Lo, .Cont = top->Cont };
+            break;
+
+        case Op::Add:   --top;  *top = iadd(top[0], top[1]);    break;
+        case Op::Sub:   --top;  *top = isub(top[0], top[1]);    break;
+        case Op::Mul:   --top;  *top = imul(top[0], top[1]);    break;
+        case Op::Div:   --top;  *top = idiv(top[0], top[1]);    break;
+        case Op::Pow:   --top;  *top = ipow(top[0], top[1]);    break;
+
+        case Op::Fact:
+        {
+            if (is_empty(*top))
+                break;
+
+            // only defined on whole numbers, so over a range it's broken everywhere. saying so
+            // leaves the plot to sample it, which reports the error if it hits a bad arg
+            if (top->Lo != top->Hi)
+            {
+                *top = whole_line();
+                break;
+            }
+
+            double val = top->Lo;
+            if (!compute_factorial(val))
+            {
+                on_run_error(ctx, prog.Sites[in - prog.Code.data()], "need a positive integer");
+                return false;
+            }
+            top->Lo = val;
+            top->Hi = val;
+            break;
+        }
+
+        default:
+            on_parse_error(ctx, "corrupt program");
+            return false;
+        }
+    }
+
+    if (top != stack)
+    {
+        on_parse_error(ctx, "corrupt program");
+        return false;
+    }
+
+    outVal = *top;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
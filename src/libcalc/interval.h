@@ -0,0 +1,55 @@
+#pragma once
+
+#include "parser.h"
+
+//-------------------------------------------------------------------------------------------------
+
+struct Program;
+
+// every value a function takes for args in some range. Cont says the function was defined and
+// continuous over the whole range, so its graph there is one unbroken piece. an empty interval
+// means it was defined nowhere in the range
+//
+// the ends aren't rounded outwards, so a result can be an ulp or so narrower than the truth. that
+// doesn't matter when it's only being drawn
+struct Interval
+{
+    double Lo = 0.0;
+    double Hi = 0.0;
+    bool Cont = true;
+};
+
+inline Interval interval_point(double v)
+{
+    return { .Lo = v, .Hi = v };
+}
+
+inline bool is_empty(const Interval& v)
+{
+    return !(v.Lo <= v.Hi);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// interval versions of the builtin maths functions
+typedef Interval (*CalcIntervalFn)(const Interval& in);
+
+Interval isin(const Interval& in);
+Interval icos(const Interval& in);
+Interval itan(const Interval& in);
+Interval isinc(const Interval& in);
+Interval iasin(const Interval& in);
+Interval iacos(const Interval& in);
+Interval iatan(const Interval& in);
+Interval iln(const Interval& in);
+Interval ilog10(const Interval& in);
+Interval isqrt(const Interval& in);
+
+//-------------------------------------------------------------------------------------------------
+
+// runs the program over a whole range of args at once. it fails in the same ways run_program
+// does. a factorial of a range of values is unbounded and broken, since it's only defined on
+// whole numbers
+bool run_program_interval(const Program& prog, const Interval& arg, Interval& outVal, ParseCtx& ctx);
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,411 @@
+#include "jit.h"
+
+#include "bytecode.h"
+#include "cmd.h"
+#include "context.h"
+#include "expr.h"
+#include "funcs.h"
+#include "libcalc.h"
+#include "maths.h"
+#include "parser.h"
+#include "symbols.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if MLN_JIT_X64
+#include <sys/mman.h>
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+#if MLN_JIT_X64
+constexpr bool kJitByDefault = true;
+#else
+constexpr bool kJitByDefault = false;
+#endif
+
+void init_jit()
+{
+    calc_context().JitEnabled = kJitByDefault;
+}
+
+bool jit_enabled()
+{
+    return calc_context().JitEnabled;
+}
+
+//-------------------------------------------------------------------------------------------------
+#if MLN_JIT_X64
+
+// the generated code is a straight translation of the stack machine: every stack slot has a fixed
+// place in the native frame, arithmetic is done inline with sse2, and anything that can fail goes
+// through one of the helpers below, which report errors the same way run_program would.
+// r12 holds the ParseCtx for the whole call, and after each helper ctx->Error is checked so the
+// first error stops the program just like it does in the interpreter. the helpers that report
+// errors are also passed the op's SourcePos, packed into an immediate by pack_pos
+
+static uint64_t pack_pos(SourcePos pos)
+{
+    return (uint64_t(pos.Text) << 32) | uint32_t(pos.Ix);
+}
+
+static SourcePos unpack_pos(uint64_t bits)
+{
+    return { .Text = SymId(bits >> 32), .Ix = int32_t(uint32_t(bits)) };
+}
+
+static double jit_sym(SymId name, ParseCtx* ctx, uint64_t pos)
+{
+    double val = 0.0;
+    if (!eval_named_value(name, val))
+    {
+        char errBuf[20+kMaxSymbolLength+1];
+        sprintf(errBuf, "unknown named val: %s", interned_name(name));
+        on_run_error(*ctx, unpack_pos(pos), errBuf);
+    }
+    return val;
+}
+
+static double jit_call_user(double arg, SymId name, ParseCtx* ctx, uint64_t pos)
+{
+    double val = 0.0;
+    if (!eval_function(name, arg, val, *ctx) && !ctx->Error)
+    {
+        char errBuf[20+kMaxSymbolLength+1];
+        sprintf(errBuf, "unknown func: %s", interned_name(name));
+        on_run_error(*ctx, unpack_pos(pos), errBuf);
+    }
+    return val;
+}
+
+static double jit_deriv(double arg, SymId name, ParseCtx* ctx, uint64_t pos)
+{
+    double val = 0.0;
+    if (!eval_derivative(name, arg, val, *ctx) && !ctx->Error)
+    {
+        char errBuf[20+kMaxSymbolLength+1];
+        sprintf(errBuf, "unknown func: %s", interned_name(name));
+        on_run_error(*ctx, unpack_pos(pos), errBuf);
+    }
+    return val;
+}
+
+static double jit_fact(double val, ParseCtx* ctx, uint64_t pos)
+{
+    if (!compute_factorial(val))
+        on_run_error(*ctx, unpack_pos(pos), "need a positive integer");
+    return val;
+}
+
+static double jit_pow(double a, double b)
+{
+    return std::pow(a, b);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// each mapping starts with this, followed by the code
+struct JitBlock
+{
+    size_t Size;
+};
+constexpr size_t kJitCodeOffset = (sizeof(JitBlock) + 15) & ~size_t(15);
+
+// longest encoding of any one op, plus room for the prologue and epilogues
+constexpr int kMaxBytesPerOp = 64;
+constexpr int kMaxJitOverhead = 64;
+
+// the stack slots live in the native frame, so deeper programs are left to the interpreter
+constexpr int kMaxJitStack = 256;
+
+constexpr int kCtxErrorOffset = offsetof(ParseCtx, Error);
+static_assert(kCtxErrorOffset < 128, "ctx->Error needs to be reachable with a disp8");
+
+struct Emitter
+{
+    uint8_t* Code = nullptr;
+    int Len = 0;
+
+    // rel32 fields that need pointing at the error exit
+    std::vector<int> BailFixups;
+
+    void Byte(uint8_t b)                { Code[Len++] = b; }
+    void Bytes(std::initializer_list<uint8_t> bs)  { for (uint8_t b : bs) Byte(b); }
+    void U32(uint32_t v)                { memcpy(Code + Len, &v, sizeof(v)); Len += sizeof(v); }
+    void U64(uint64_t v)                { memcpy(Code + Len, &v, sizeof(v)); Len += sizeof(v); }
+    void Ptr(const void* p)             { U64(uint64_t(uintptr_t(p))); }
+
+    // <op> with a [rsp+disp32] memory operand; prefix is the opcode bytes, reg the modrm reg field
+    void RspOperand(std::initializer_list<uint8_t> prefix, int reg, int disp)
+    {
+        Bytes(prefix);
+        Byte(uint8_t(0x84 | (reg << 3)));
+        Byte(0x24);
+        U32(uint32_t(disp));
+    }
+
+    void LoadXmm(int xmm, int disp)     { RspOperand({ 0xf2, 0x0f, 0x10 }, xmm, disp); }    // movsd xmmN, [rsp+disp]
+    void StoreXmm0(int disp)            { RspOperand({ 0xf2, 0x0f, 0x11 }, 0, disp); }      // movsd [rsp+disp], xmm0
+    void ArithXmm0(uint8_t op, int disp){ RspOperand({ 0xf2, 0x0f, op }, 0, disp); }        // addsd etc xmm0, [rsp+disp]
+
+    void MovRaxImm(uint64_t v)          { Bytes({ 0x48, 0xb8 }); U64(v); }
+    void MovEdiImm(uint32_t v)          { Byte(0xbf); U32(v); }
+    void MovRdiR12()                    { Bytes({ 0x4c, 0x89, 0xe7 }); }
+    void MovRsiR12()                    { Bytes({ 0x4c, 0x89, 0xe6 }); }
+    void MovRsiImm(uint64_t v)          { Bytes({ 0x48, 0xbe }); U64(v); }
+    void MovRdxImm(uint64_t v)          { Bytes({ 0x48, 0xba }); U64(v); }
+
+    void Call(const void* fn)
+    {
+        Bytes({ 0x48, 0xb8 }); Ptr(fn);     // mov rax, fn
+        Bytes({ 0xff, 0xd0 });              // call rax
+    }
+
+    // cmp byte [r12+Error], 0 ; jne bail
+    void CheckError()
+    {
+        Bytes({ 0x41, 0x80, 0x7c, 0x24, uint8_t(kCtxErrorOffset), 0x00 });
+        Bytes({ 0x0f, 0x85 });
+        BailFixups.push_back(Len);
+        U32(0);
+    }
+};
+
+static int slot_disp(int slot)
+{
+    return slot * int(sizeof(double));
+}
+
+JitFn jit_compile(const Program& prog)
+{
+    if (prog.Code.empty() || (prog.MaxDepth > kMaxJitStack))
+        return nullptr;
+
+    const size_t pageSize = 4096;
+    const size_t wantSize = kJitCodeOffset + kMaxJitOverhead + prog.Code.size() * kMaxBytesPerOp;
+    const size_t mapSize = (wantSize + pageSize - 1) & ~(pageSize - 1);
+
+    void* mem = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    JitBlock* block = static_cast<JitBlock*>(mem);
+    block->Size = mapSize;
+
+    // the arg lives just above the stack slots, and the temps above that
+    const int argDisp = slot_disp(prog.MaxDepth);
+    const int tempsDisp = argDisp + int(sizeof(double));
+    const int frameSize = (tempsDisp + slot_disp(prog.NumTemps) + 15) & ~15;
+
+    Emitter e;
+    e.Code = static_cast<uint8_t*>(mem) + kJitCodeOffset;
+
+    e.Bytes({ 0x41, 0x54 });                            // push r12
+    e.Bytes({ 0x48, 0x81, 0xec }); e.U32(frameSize);    // sub rsp, frameSize
+    e.Bytes({ 0x49, 0x89, 0xfc });                      // mov r12, rdi
+    e.StoreXmm0(argDisp);
+
+    int top = -1;
+    for (size_t ix = 0; ix < prog.Code.size(); ++ix)
+    {
+        const Instr& in = prog.Code[ix];
+        switch (in.Code)
+        {
+        case Op::Const:
+        {
+            uint64_t bits;
+            memcpy(&bits, &prog.Consts[in.Operand], sizeof(bits));
+            e.MovRaxImm(bits);
+            ++top;
+            e.Bytes({ 0x48, 0x89, 0x84, 0x24 }); e.U32(slot_disp(top));    // mov [rsp+top], rax
+            break;
+        }
+
+        case Op::Arg:
+            ++top;
+            e.LoadXmm(0, argDisp);
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::Sym:
+            ++top;
+            e.MovEdiImm(prog.Names[in.Operand]);
+            e.MovRsiR12();
+            e.MovRdxImm(pack_pos(prog.Sites[ix]));
+            e.Call((const void*)jit_sym);
+            e.CheckError();
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::Dup:
+            e.LoadXmm(0, slot_disp(top));
+            ++top;
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::Load:
+            ++top;
+            e.LoadXmm(0, tempsDisp + slot_disp(in.Operand));
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::Store:
+            e.LoadXmm(0, slot_disp(top));
+            e.StoreXmm0(tempsDisp + slot_disp(in.Operand));
+            break;
+
+        case Op::Call:
+            e.LoadXmm(0, slot_disp(top));
+            e.MovEdiImm(in.Operand);
+            e.Call((const void*)call_builtin_func);
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::CallUser:
+        case Op::Deriv:
+            e.LoadXmm(0, slot_disp(top));
+            e.MovEdiImm(prog.Names[in.Operand]);
+            e.MovRsiR12();
+            e.MovRdxImm(pack_pos(prog.Sites[ix]));
+            e.Call((in.Code == Op::CallUser) ? (const void*)jit_call_user : (const void*)jit_deriv);
+            e.CheckError();
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::Neg:
+            e.Bytes({ 0x48, 0x8b, 0x84, 0x24 }); e.U32(slot_disp(top));    // mov rax, [rsp+top]
+            e.Bytes({ 0x48, 0x0f, 0xba, 0xf8, 63 });                        // btc rax, 63
+            e.Bytes({ 0x48, 0x89, 0x84, 0x24 }); e.U32(slot_disp(top));    // mov [rsp+top], rax
+            break;
+
+        case Op::Add:
+        case Op::Sub:
+        case Op::Mul:
+        case Op::Div:
+        {
+            const uint8_t op = (in.Code == Op::Add) ? 0x58 : (in.Code == Op::Sub) ? 0x5c : (in.Code == Op::Mul) ? 0x59 : 0x5e;
+            --top;
+            e.LoadXmm(0, slot_disp(top));
+            e.ArithXmm0(op, slot_disp(top + 1));
+            e.StoreXmm0(slot_disp(top));
+            break;
+        }
+
+        case Op::Pow:
+            --top;
+            e.LoadXmm(0, slot_disp(top));
+            e.LoadXmm(1, slot_disp(top + 1));
+            e.Call((const void*)jit_pow);
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        case Op::Fact:
+            e.LoadXmm(0, slot_disp(top));
+            e.MovRdiR12();
+            e.MovRsiImm(pack_pos(prog.Sites[ix]));
+            e.Call((const void*)jit_fact);
+            e.CheckError();
+            e.StoreXmm0(slot_disp(top));
+            break;
+
+        default:
+            munmap(mem, mapSize);
+            return nullptr;
+        }
+    }
+
+    if (top != 0)
+    {
+        munmap(mem, mapSize);
+        return nullptr;
+    }
+
+    e.LoadXmm(0, slot_disp(0));
+    e.Bytes({ 0x48, 0x81, 0xc4 }); e.U32(frameSize);    // add rsp, frameSize
+    e.Bytes({ 0x41, 0x5c });                            // pop r12
+    e.Byte(0xc3);                                       // ret
+
+    // errors return 0, same as eval_user_func
+    const int bailAt = e.Len;
+    for (int fixup : e.BailFixups)
+    {
+        const uint32_t rel = uint32_t(bailAt - (fixup + 4));
+        memcpy(e.Code + fixup, &rel, sizeof(rel));
+    }
+    e.Bytes({ 0x66, 0x0f, 0x57, 0xc0 });                // xorpd xmm0, xmm0
+    e.Bytes({ 0x48, 0x81, 0xc4 }); e.U32(frameSize);
+    e.Bytes({ 0x41, 0x5c });
+    e.Byte(0xc3);
+
+    if (mprotect(mem, mapSize, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(mem, mapSize);
+        return nullptr;
+    }
+
+    return reinterpret_cast<JitFn>(e.Code);
+}
+
+void jit_free(JitFn fn)
+{
+    if (!fn)
+        return;
+
+    void* mem = reinterpret_cast<uint8_t*>(fn) - kJitCodeOffset;
+    munmap(mem, static_cast<JitBlock*>(mem)->Size);
+}
+
+#else   // MLN_JIT_X64
+
+JitFn jit_compile(const Program&)
+{
+    return nullptr;
+}
+
+void jit_free(JitFn)
+{
+}
+
+#endif  // MLN_JIT_X64
+//-------------------------------------------------------------------------------------------------
+
+// jit ::= "jit" ["on" | "off"]
+static bool cmd_jit(ParseCtx& ctx)
+{
+#if MLN_JIT_X64
+    if (peek(ctx, Token::Symbol))
+    {
+        char option[kMaxSymbolLength+1];
+        expect_symbol(ctx, option);
+
+        if (strcmp(option, "on") == 0)
+            calc_context().JitEnabled = true;
+        else if (strcmp(option, "off") == 0)
+            calc_context().JitEnabled = false;
+        else
+        {
+            on_parse_error(ctx, "expected on or off");
+            return false;
+        }
+    }
+
+    calc_puts(jit_enabled() ? "jit is on\n" : "jit is off\n");
+    return true;
+#else
+    (void)ctx;
+    calc_puts("no jit on this platform\n");
+    return true;
+#endif
+}
+
+void register_jit_commands()
+{
+    register_calc_cmd(cmd_jit, "jit", "jit [on | off]", "native code for user funcs");
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "platform.h"
+
+//-------------------------------------------------------------------------------------------------
+
+// native code generation is only done for 64-bit PCs with mmap
+#if MLN_TARGET_PC && defined(__x86_64__) && !defined(_WIN32)
+#define MLN_JIT_X64 1
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+struct ParseCtx;
+struct Program;
+
+// a compiled program takes the same arg as run_program, and reports errors through ctx exactly like
+// run_program does, returning 0 once one has happened
+typedef double (*JitFn)(double arg, ParseCtx* ctx);
+
+// returns null if the program can't be compiled here, in which case keep using run_program
+JitFn jit_compile(const Program& prog);
+void jit_free(JitFn fn);
+
+// on by default where there's a jit, and per CalcContext
+void init_jit();
+bool jit_enabled();
+
+void register_jit_commands();
+
+//-------------------------------------------------------------------------------------------------
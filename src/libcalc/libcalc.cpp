@@ -1,11 +1,18 @@
 #include "libcalc.h"
 
+#include "ast.h"
+#include "cells.h"
 #include "chaos.h"
 #include "cmd.h"
+#include "context.h"
+#include "deps.h"
+#include "deriv.h"
 #include "expr.h"
 #include "format.h"
 #include "funcs.h"
+#include "jit.h"
 #include "parser.h"
+#include "platform.h"
 #include "plot.h"
 #include "symbols.h"
 
@@ -13,15 +20,19 @@
 #include <cstring>
 #include <iostream>
 
+#if MLN_TARGET_PC
+#include <chrono>
+#endif
+
 //-------------------------------------------------------------------------------------------------
 
-calc_puts_func calc_puts_fn;
+MLN_THREAD_LOCAL CalcContext* gCurrentContext = nullptr;
 
 void calc_puts(const char* str)
 {
-    if (calc_puts_fn)
+    if (gCurrentContext && gCurrentContext->Puts)
     {
-        calc_puts_fn(str);
+        gCurrentContext->Puts(str, gCurrentContext->PutsUser);
     }
 }
 
@@ -30,13 +41,16 @@ void calc_puts(const char* str)
 // assignment ::= "->" | "="
 // f[x] assignment expression
 // x assignment expression
-// definition ::= symbol [lparen symbol rparen] assignment expression
+// x := expression
+// x = deriv f
+// definition ::= symbol [lparen symbol rparen] assignment expression | symbol ":=" expression
+//              | symbol "=" "deriv" symbol
 bool parse_definition(ParseCtx& ctx)
 {
-    char name[kMaxSymbolLength+1];
+    SymId name;
 
     bool isFunction = false;
-    char arg[kMaxSymbolLength+1];
+    SymId arg = kNoSymId;
 
     if (!expect_symbol(ctx, name))
         return false;
@@ -51,9 +65,23 @@ bool parse_definition(ParseCtx& ctx)
             return false;
     }
 
-    // we need to cache the pointer to the rest of the string now before we advance token
-    // otherwise the function def will miss the first token
-    const char* postAssignBuf = ctx.InBuffer + ctx.CurrIx;
+    // the definition is the rest of the input after the assignment, which has to be picked out
+    // before the assignment is eaten
+    const ParseCtx defCtx = input_after_next(ctx);
+
+    if (!isFunction && accept(ctx, Token::Bind))
+    {
+        // a cell, which keeps its expression rather than just the value
+        ParseCtx innerCtx = defCtx;
+        if (!define_cell(name, innerCtx))
+        {
+            ctx.Error = true;
+            return false;
+        }
+
+        skip_to_eof(ctx);
+        return true;
+    }
 
     if (!accept(ctx, Token::Map) && !expect(ctx, Token::Equals))
         return false;
@@ -61,23 +89,35 @@ bool parse_definition(ParseCtx& ctx)
     if (isFunction)
     {
         // the remainder of the expression becomes the registered implementation of function <name>
-        ParseCtx innerCtx {
-            .InBuffer = postAssignBuf,
-            .ResBuffer = ctx.ResBuffer,
-            .ResBufferLen = ctx.ResBufferLen
-        };
+        ParseCtx innerCtx = defCtx;
         if (!define_function(name, arg, innerCtx))
+        {
+            ctx.Error = true;
             return false;
+        }
 
         // we've eaten all the rest of the input
-        ctx.NextToken = Token::Eof;
+        skip_to_eof(ctx);
     }
     else
     {
+        // unless deriv is just a value being used in an expression
+        if (peek(ctx, Token::Symbol) && (ctx.TokenSymbolId == find_interned("deriv"))
+            && (peek_ahead(ctx, 1) == Token::Symbol))
+        {
+            expect(ctx, Token::Symbol);
+
+            SymId func;
+            if (!expect_symbol(ctx, func))
+                return false;
+            return define_derivative(name, func, ctx);
+        }
+
         const double val = parse_expression(ctx);
         if (ctx.Error)
             return false;
 
+        undef_cell(name);
         return define_value(name, val, ctx);
     }
 
@@ -111,10 +151,11 @@ bool parse_axis(ParseCtx& ctx, PlotAxis& axis)
 
 
 // g f -pi<x<pi, -1<y<1
-// cmd_graph ::= "g" symbol [axis ["," axis]]
+// g f' draws f's derivative over the top
+// cmd_graph ::= "g" symbol ["'"] [axis ["," axis]]
 bool cmd_graph_y(ParseCtx& ctx)
 {
-    char func_name[kMaxSymbolLength+1];
+    SymId func_name;
     if (!expect_symbol(ctx, func_name))
     {
         on_parse_error(ctx, "need user func name for y=f(x)");
@@ -126,6 +167,8 @@ bool cmd_graph_y(ParseCtx& ctx)
         return false;
     }
 
+    const bool withDeriv = accept(ctx, Token::Prime);
+
     PlotAxis x { .Name = "x" };
     PlotAxis y { .Name = "y" };
 
@@ -152,7 +195,7 @@ bool cmd_graph_y(ParseCtx& ctx)
             break;
     }
 
-    if (!draw_plot(func_name, &x, &y, ctx))
+    if (!draw_plot(func_name, &x, &y, withDeriv, ctx))
         return false;
 
     return true;
@@ -160,14 +203,10 @@ bool cmd_graph_y(ParseCtx& ctx)
 
 //-------------------------------------------------------------------------------------------------
 
-bool try_parse_command(ParseCtx& ctx)
+// the command name hasn't been eaten yet
+bool parse_command(ParseCtx& ctx)
 {
-    if (!peek(ctx, Token::Symbol))
-        return false;
-
-    const CommandDef* cmd = lookup_command(ctx.TokenSymbol);
-    if (!cmd)
-        return false;
+    const CommandDef* cmd = lookup_command(ctx.TokenSymbolId);
 
     // eat the command name symbol
     expect(ctx, Token::Symbol);
@@ -183,46 +222,135 @@ bool try_parse_command(ParseCtx& ctx)
 
 //-------------------------------------------------------------------------------------------------
 
-void calc_init(calc_puts_func puts_func)
+enum class Statement : uint8_t
 {
-    calc_puts_fn = puts_func;
+    Definition,
+    Command,
+    Expression,
+};
 
+static bool is_assignment(Token t)
+{
+    return (t == Token::Equals) || (t == Token::Map) || (t == Token::Bind);
+}
+
+// statement ::= definition | command | expression
+//
+// the first few tokens are enough to tell which: a definition is a name, maybe with a bracketed
+// arg, and then an assignment. a command starts with a command's name, unless it's a user function
+// of the same name being called
+static Statement classify_statement(const ParseCtx& ctx)
+{
+    if (!peek(ctx, Token::Symbol))
+        return Statement::Expression;
+
+    const Token next = peek_ahead(ctx, 1);
+    if (is_assignment(next))
+        return Statement::Definition;
+    if ((next == Token::LParen) && (peek_ahead(ctx, 2) == Token::Symbol)
+        && (peek_ahead(ctx, 3) == Token::RParen) && is_assignment(peek_ahead(ctx, 4)))
+        return Statement::Definition;
+
+    // eg. df(1) after df = deriv f
+    if (lookup_command(ctx.TokenSymbolId)
+        && !(is_user_func(ctx.TokenSymbolId) && (next == Token::LParen)))
+        return Statement::Command;
+
+    return Statement::Expression;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+CalcContext* calc_create(calc_puts_func puts_func, void* user)
+{
+    CalcContext* calc = new CalcContext;
+    calc->Puts = puts_func;
+    calc->PutsUser = user;
+
+    calc->Intern = create_intern_state();
+    calc->Parser = create_parser_state();
+    calc->Ast = create_ast_state();
+    calc->Expr = create_expr_state();
+    calc->Symbols = create_symbols_state();
+    calc->Functions = create_functions_state();
+    calc->Cells = create_cells_state();
+    calc->Deps = create_deps_state();
+    calc->Commands = create_commands_state();
+
+    ContextScope scope(calc);
+
+    init_deps();
+    init_cells();
+    init_symbols();
+    init_functions();
     init_commands();
+    init_jit();
 
-    register_calc_cmd(cmd_graph_y, "g", "g fn [lo<x<hi] [, lo<y<hi]", "graph of y=fn(x)");
+    register_calc_cmd(cmd_graph_y, "g", "g fn['] [lo<x<hi] [, lo<y<hi]", "graph of y=fn(x), and fn'(x) with '");
 
     register_chaos_commands();
+    register_jit_commands();
+
+    return calc;
+}
+
+void calc_destroy(CalcContext* calc)
+{
+    if (!calc)
+        return;
+
+    destroy_commands_state(calc->Commands);
+    destroy_deps_state(calc->Deps);
+    destroy_cells_state(calc->Cells);
+    destroy_functions_state(calc->Functions);
+    destroy_symbols_state(calc->Symbols);
+    destroy_expr_state(calc->Expr);
+    destroy_ast_state(calc->Ast);
+    destroy_parser_state(calc->Parser);
+    destroy_intern_state(calc->Intern);
+
+    delete calc;
 }
 
 //-------------------------------------------------------------------------------------------------
 
-bool calc_eval(const char* expr, char* resBuffer, int resBufferLen)
+static bool eval_statement(const char* expr, char* resBuffer, int resBufferLen)
 {
-    if (!resBuffer)
-        return false;
     *resBuffer = 0;
 
+    reset_ast();
+    reset_tokens();
+
+    // anything registered since the last statement stays
+    keep_interned_names();
+
     ParseCtx parseCtx { .InBuffer=expr, .ResBuffer=resBuffer, .ResBufferLen=resBufferLen };
     advance_token(parseCtx);
 
-    // scan the expression to see if it's something unusual
-    const bool isDefinition = (strchr(expr, '=') != nullptr) || (strstr(expr, "->") != nullptr);
-
     bool shouldPrintResult = false;
     double result = 0.0;
 
-    if (isDefinition && parse_definition(parseCtx))
-    {
-        strcpy(resBuffer, "  ok.");
-    }
-    else if (try_parse_command(parseCtx))
+    EvalStats& stats = calc_context().Eval;
+
+    switch (classify_statement(parseCtx))
     {
+    case Statement::Definition:
+        ++stats.Definitions;
+        if (parse_definition(parseCtx))
+            strcpy(resBuffer, "  ok.");
+        break;
+
+    case Statement::Command:
         // commands are expected to manage their own feedback
-    }
-    else
-    {
+        ++stats.Commands;
+        parse_command(parseCtx);
+        break;
+
+    case Statement::Expression:
+        ++stats.Expressions;
         result = parse_expression(parseCtx);
         shouldPrintResult = !parseCtx.Error;
+        break;
     }
 
     if (!accept(parseCtx, Token::Eof))
@@ -235,8 +363,33 @@ bool calc_eval(const char* expr, char* resBuffer, int resBufferLen)
         dtostr_human(result, resBuffer + introLen, resBufferLen - introLen);
     }
 
+    drop_unkept_names();
     return !parseCtx.Error;
 }
 
+bool calc_eval(CalcContext* calc, const char* expr, char* resBuffer, int resBufferLen)
+{
+    if (!calc || !resBuffer)
+        return false;
+
+    ContextScope scope(calc);
+
+#if MLN_TARGET_PC
+    const auto start = std::chrono::steady_clock::now();
+#endif
 
+    const bool ok = eval_statement(expr, resBuffer, resBufferLen);
 
+#if MLN_TARGET_PC
+    calc->Eval.Nanos += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+#endif
+
+    return ok;
+}
+
+const EvalStats& eval_stats()
+{
+    return calc_context().Eval;
+}
+
+//-------------------------------------------------------------------------------------------------
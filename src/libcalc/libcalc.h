@@ -12,22 +12,37 @@ extern "C" {
 
 //-------------------------------------------------------------------------------------------------
 
-// used to specify a printing function that the calc can use
-typedef void (*calc_puts_func)(const char* str);
+// one calculator: its symbols, functions, commands, plot and output. contexts don't share
+// anything, so different ones can be used on different threads at the same time. one context
+// must only be used by one thread at a time
+typedef struct CalcContext CalcContext;
 
-// print a string through the registered puts fn
+// used to specify a printing function that the calc can use. user is what was given to
+// calc_create along with it
+typedef void (*calc_puts_func)(const char* str, void* user);
+
+// print a string through the puts fn of the context that's evaluating
 void calc_puts(const char* str);
 
 //-------------------------------------------------------------------------------------------------
 
 typedef bool (calc_cmd_func)(const char* args);
 
-void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage, const char* help);
+void register_calc_cmd(CalcContext* calc, calc_cmd_func func, const char* name, const char* usage, const char* help);
+
+typedef double (*calc_func)(double x);
+
+// adds a builtin function of x, eg. one compiled ahead of time with static_expr.h. fn gives its
+// values, and def is the same function written as an expression in x, which plotting and
+// derivatives work from. like commands, these are registered after calc_create
+bool register_calc_func(CalcContext* calc, const char* name, calc_func fn, const char* def);
 
 //-------------------------------------------------------------------------------------------------
 
-void calc_init(calc_puts_func puts_func);
-bool calc_eval(const char* expr, char* resBuffer, int resBufferLen);
+CalcContext* calc_create(calc_puts_func puts_func, void* user);
+void calc_destroy(CalcContext* calc);
+
+bool calc_eval(CalcContext* calc, const char* expr, char* resBuffer, int resBufferLen);
 
 //-------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------
@@ -46,8 +61,9 @@ typedef struct
 } Plot;
 
 
-const Plot* get_plot(); // returns null if a plot hasn't been created since reset_plot()
-void reset_plot();
+// returns null if a plot hasn't been created since reset_plot()
+const Plot* get_plot(CalcContext* calc);
+void reset_plot(CalcContext* calc);
 
 //-------------------------------------------------------------------------------------------------
 
@@ -0,0 +1,314 @@
+#include "numparse.h"
+
+#include "parser.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+// most numbers are read with the Eisel-Lemire method: the digits are multiplied by a 128 bit
+// approximation of the right power of 10, which is nearly always enough to tell how the exact
+// product rounds. the few it can't tell about, and anything out of range or in hex, go to
+// strtod, which is slow but never wrong
+
+constexpr int kSmallestPow5 = kMinCachedPow10;
+constexpr int kLargestPow5 = kMaxCachedPow10;
+
+// made by tools/genpow5.py
+extern "C" const uint64_t pow5_128[kLargestPow5 - kSmallestPow5 + 1][2];
+
+// 10^q for anything bigger is infinite
+constexpr int kMaxExp10 = 308;
+
+// more digits than this might not fit in 64 bits
+constexpr int kMaxDigits = 19;
+
+constexpr int kMantissaBits = 52;
+
+// powers of 10 that are exact as doubles
+static const double kExactPow10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+constexpr int kMaxExactPow10 = 22;
+
+//-------------------------------------------------------------------------------------------------
+
+static bool is_digit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+void mul_64x64(uint64_t a, uint64_t b, uint64_t& outHi, uint64_t& outLo)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    outHi = uint64_t(r >> 64);
+    outLo = uint64_t(r);
+#else
+    const uint64_t aLo = uint32_t(a), aHi = a >> 32;
+    const uint64_t bLo = uint32_t(b), bHi = b >> 32;
+
+    const uint64_t ll = aLo * bLo;
+    const uint64_t lh = aLo * bHi;
+    const uint64_t hl = aHi * bLo;
+    const uint64_t hh = aHi * bHi;
+
+    const uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+    outLo = (mid << 32) | uint32_t(ll);
+    outHi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+static int count_leading_zeros(uint64_t v)
+{
+    return __builtin_clzll(v);
+}
+
+static int floor_log2_pow10(int q)
+{
+    return ((152170 + 65536) * q) >> 16;
+}
+
+void cached_pow10(int q, uint64_t& outF, int& outE)
+{
+    const uint64_t* pow5 = pow5_128[q - kSmallestPow5];
+    outF = pow5[0] + (pow5[1] >> 63);
+    outE = floor_log2_pow10(q) - 63;
+
+    // rounding up carried out of the top
+    if (outF == 0)
+    {
+        outF = uint64_t(1) << 63;
+        ++outE;
+    }
+}
+
+// w * 10^q, if it's a normal double and the product is close enough to tell how it rounds.
+// w can't be 0
+static bool eisel_lemire(uint64_t w, int64_t q, double& outVal)
+{
+    if ((q < kSmallestPow5) || (q > kMaxExp10))
+        return false;
+
+    const int lz = count_leading_zeros(w);
+    w <<= lz;
+
+    // the top 55 bits are the mantissa, the implicit 1 and two more for rounding. if the bits
+    // below those are all 1s, the next 64 bits of the power could carry into them
+    const uint64_t* pow5 = pow5_128[q - kSmallestPow5];
+    uint64_t hi, lo;
+    mul_64x64(w, pow5[0], hi, lo);
+
+    constexpr uint64_t kPrecisionMask = ~uint64_t(0) >> (kMantissaBits + 3);
+    if ((hi & kPrecisionMask) == kPrecisionMask)
+    {
+        uint64_t hi2, lo2;
+        mul_64x64(w, pow5[1], hi2, lo2);
+
+        lo += hi2;
+        if (hi2 > lo)
+            ++hi;
+    }
+
+    // still too close to call. below 5^55 the power is exact, so there's nothing more to know
+    if ((lo == ~uint64_t(0)) && ((q < -27) || (q > 55)))
+        return false;
+
+    const int upperBit = int(hi >> 63);
+    uint64_t mantissa = hi >> (upperBit + 64 - kMantissaBits - 3);
+
+    // floor(log2(10^q)), plus where the product's top bit landed, plus the bias
+    int power2 = floor_log2_pow10(int(q)) + 63 + upperBit - lz + 1023;
+
+    // subnormals, and things that round to zero
+    if (power2 <= 0)
+        return false;
+
+    // exactly half way, which is only possible when 5^q is small enough to be exact. ties go
+    // to even rather than up
+    if ((lo <= 1) && (q >= -4) && (q <= 23) && ((mantissa & 3) == 1))
+    {
+        if ((mantissa << (upperBit + 64 - kMantissaBits - 3)) == hi)
+            mantissa &= ~uint64_t(1);
+    }
+
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+
+    // rounding up carried into the next power of 2
+    if (mantissa >= (uint64_t(2) << kMantissaBits))
+    {
+        mantissa = uint64_t(1) << kMantissaBits;
+        ++power2;
+    }
+    mantissa &= ~(uint64_t(1) << kMantissaBits);
+
+    if (power2 >= 0x7ff)
+        return false;
+
+    const uint64_t bits = mantissa | (uint64_t(power2) << kMantissaBits);
+    memcpy(&outVal, &bits, sizeof(outVal));
+    return true;
+}
+
+// w * 10^q correctly rounded, if it can be done quickly
+static bool decimal_to_double(uint64_t w, int64_t q, double& outVal)
+{
+    if (w == 0)
+    {
+        outVal = 0.0;
+        return true;
+    }
+
+    // both exact, so the one rounding is the right one
+    if ((w <= (uint64_t(1) << 53)) && (q >= -kMaxExactPow10) && (q <= kMaxExactPow10))
+    {
+        outVal = (q < 0) ? (double(w) / kExactPow10[-q]) : (double(w) * kExactPow10[q]);
+        return true;
+    }
+
+    return eisel_lemire(w, q, outVal);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the part strtod would read
+static const char* read_decimal(const char* in, double& outVal, bool& outOutOfRange)
+{
+    outOutOfRange = false;
+
+    // hex, which strtod takes care of
+    if ((in[0] == '0') && ((in[1] == 'x') || (in[1] == 'X')))
+    {
+        char* end = nullptr;
+        errno = 0;
+        outVal = strtod(in, &end);
+        outOutOfRange = (errno != 0);
+        return end ? end : in;
+    }
+
+    // the first kMaxDigits significant digits, and the power of 10 that goes with them
+    const char* p = in;
+    uint64_t w = 0;
+    int numDigits = 0;
+    int64_t exp10 = 0;
+    bool sawDigit = false;
+    bool truncated = false;
+
+    for (; is_digit(*p); ++p)
+    {
+        sawDigit = true;
+        const int d = *p - '0';
+        if (numDigits < kMaxDigits)
+        {
+            w = w * 10 + d;
+            numDigits += (w != 0) ? 1 : 0;
+        }
+        else
+        {
+            ++exp10;
+            truncated |= (d != 0);
+        }
+    }
+
+    if (*p == '.')
+    {
+        ++p;
+        for (; is_digit(*p); ++p)
+        {
+            sawDigit = true;
+            const int d = *p - '0';
+            if (numDigits < kMaxDigits)
+            {
+                w = w * 10 + d;
+                numDigits += (w != 0) ? 1 : 0;
+                --exp10;
+            }
+            else
+            {
+                truncated |= (d != 0);
+            }
+        }
+    }
+
+    if (!sawDigit)
+    {
+        outVal = 0.0;
+        return in;
+    }
+
+    // an exponent only counts if it has digits
+    if ((*p == 'e') || (*p == 'E'))
+    {
+        const char* e = p + 1;
+        const bool negative = (*e == '-');
+        if ((*e == '-') || (*e == '+'))
+            ++e;
+
+        if (is_digit(*e))
+        {
+            int64_t exp = 0;
+            for (; is_digit(*e); ++e)
+            {
+                // anything this big is out of range whatever the digits are
+                if (exp < 1000000)
+                    exp = exp * 10 + (*e - '0');
+            }
+
+            exp10 += negative ? -exp : exp;
+            p = e;
+        }
+    }
+
+    // with digits left over, the value is somewhere between w and w+1. if both of those round
+    // the same way, so does it
+    if (decimal_to_double(w, exp10, outVal))
+    {
+        double upper;
+        if (!truncated || (decimal_to_double(w + 1, exp10, upper) && (upper == outVal)))
+            return p;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    outVal = strtod(in, &end);
+    outOutOfRange = (errno != 0);
+    return end ? end : in;
+}
+
+const char* read_number(const char* in, double& outVal, bool& outOutOfRange)
+{
+    in = read_decimal(in, outVal, outOutOfRange);
+    if (outOutOfRange)
+        return in;
+
+    // handle scale units
+    const char c = in[0];
+    const char nc = c ? in[1] : 0;
+    if (c && !is_symbol_char(nc, false))
+    {
+        switch (c)
+        {
+        case 'G':   outVal *= 1.0e9;     break;
+        case 'M':   outVal *= 1.0e6;     break;
+        case 'k':   outVal *= 1.0e3;     break;
+        case 'm':   outVal *= 1.0e-3;    break;
+        case 'u':   outVal *= 1.0e-6;    break;
+        case 'n':   outVal *= 1.0e-9;    break;
+        case 'p':   outVal *= 1.0e-12;   break;
+        default:
+            return in; // no suffix
+        }
+
+        ++in;
+    }
+
+    return in;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+//-------------------------------------------------------------------------------------------------
+
+// reads a number the way strtod does, followed by an optional scale suffix: G M k m u n p.
+// returns where it stopped, which is in itself if there's no number there
+//
+// outOfRange is set for values that aren't a normal double, which is when strtod would set
+// errno. the suffix isn't read then
+//
+// the value is always the correctly rounded one, so exactly what strtod gives. the scale is
+// then multiplied in, as it always has been, so 3m is 3 * 0.001 rather than 3e-3
+const char* read_number(const char* in, double& outVal, bool& outOutOfRange);
+
+//-------------------------------------------------------------------------------------------------
+
+// 10^q as f * 2^e, with f's top bit set, correct to within about half a unit in f. q can be from
+// kMinCachedPow10 to kMaxCachedPow10
+constexpr int kMinCachedPow10 = -342;
+constexpr int kMaxCachedPow10 = 332;
+void cached_pow10(int q, uint64_t& outF, int& outE);
+
+// the full 128 bit product
+void mul_64x64(uint64_t a, uint64_t b, uint64_t& outHi, uint64_t& outLo);
+
+//-------------------------------------------------------------------------------------------------
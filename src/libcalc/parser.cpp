@@ -1,10 +1,13 @@
 #include "parser.h"
 
+#include "context.h"
+#include "numparse.h"
+
 #include <algorithm>
-#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 //-------------------------------------------------------------------------------------------------
 
@@ -18,33 +21,17 @@ const char* kTokenNames[] =
     "^",
     "(",")",
     "!",
+    "'",
     "<",">",
     "=",
     "->",
+    ":=",
     ",",
 };
 static_assert((sizeof(kTokenNames) / sizeof(kTokenNames[0])) == size_t(Token::COUNT));
 
 //-------------------------------------------------------------------------------------------------
 
-inline bool is_symbol_char(char c, bool leading)
-{
-    if ((c >= 'A' && c <= 'Z') || ((c >= 'a') && (c <= 'z')))
-        return true;
-    if (c == '_')
-        return true;
-
-    if (leading)
-        return false;
-
-    if (c >= '0' && c <= '9')
-        return true;
-
-    return false;
-}
-
-//-------------------------------------------------------------------------------------------------
-
 void on_parse_error(ParseCtx& ctx, const char* msg)
 {
     // only one error at a time pls
@@ -107,156 +94,288 @@ void on_parse_error(ParseCtx& ctx, const char* msg)
 
 //-------------------------------------------------------------------------------------------------
 
-void parse_number(ParseCtx& ctx)
+// a token that couldn't be lexed. the error is only reported once the parser gets to it, since
+// it might never, eg. in the text after a command
+enum class LexError : uint8_t
 {
-    const char* start = ctx.InBuffer + ctx.CurrIx;
-    char* end = nullptr;
+    None,
+    ScaryNumber,
+    SymbolTooLong,
+    TooManyNames,
+};
 
-    errno = 0;
-    ctx.TokenNumber = strtod(start, &end);
-    ctx.NextToken = Token::Number;
+static const char* const kLexErrorMsgs[] =
+{
+    nullptr,
+    "scary number",
+    "symbol too long",
+    "too many names",
+};
 
-    if (end)
-        ctx.CurrIx = end - ctx.InBuffer;
+struct LexToken
+{
+    Token Kind = Token::Invalid;
+    LexError Error = LexError::None;
 
-    if (errno)
-    {
-        on_parse_error(ctx, "scary number");
-        ctx.NextToken = Token::Invalid;
-        return;
-    }
+    // a token that doesn't get anywhere, like Eof or a number that's just ".", would only ever be
+    // followed by itself, so it ends the line. the parser never goes past it
+    bool Last = false;
+
+    int32_t Offset = 0;     // where CurrIx goes when it's the next token
 
-    // handle scale units
-    const char c = ctx.InBuffer[ctx.CurrIx];
-    const char nc = c ? ctx.InBuffer[ctx.CurrIx+1] : 0;
-    if (c && !is_symbol_char(nc, false))
+    union
     {
-        switch (c)
-        {
-        case 'G':   ctx.TokenNumber *= 1.0e9;     break;
-        case 'M':   ctx.TokenNumber *= 1.0e6;     break;
-        case 'k':   ctx.TokenNumber *= 1.0e3;     break;
-        case 'm':   ctx.TokenNumber *= 1.0e-3;    break;
-        case 'u':   ctx.TokenNumber *= 1.0e-6;    break;
-        case 'n':   ctx.TokenNumber *= 1.0e-9;    break;
-        case 'p':   ctx.TokenNumber *= 1.0e-12;   break;
-        default:
-            return; // no suffix; don't increment CurrIx
-        }
+        double Number;
+        SymId SymbolId;
+    };
+};
 
-        ++ctx.CurrIx;
-    }
+// the tokens lexed since the last reset_tokens
+struct ParserState
+{
+    std::vector<LexToken> Tokens;
+};
+
+ParserState* create_parser_state()
+{
+    return new ParserState;
+}
+
+void destroy_parser_state(ParserState* state)
+{
+    delete state;
+}
+
+static ParserState& parser_state()
+{
+    return *calc_context().Parser;
+}
+
+static bool is_last_token(const LexToken& tok)
+{
+    return tok.Last;
+}
+
+void reset_tokens()
+{
+    parser_state().Tokens.clear();
 }
 
 //-------------------------------------------------------------------------------------------------
 
-char to_lower_sym(char c)
+static const char* lex_number(const char* in, LexToken& tok)
 {
-    if (c >= 'A' && c <= 'Z')
-        return (c + ('a' - 'A'));
-    return c;
+    bool outOfRange = false;
+    in = read_number(in, tok.Number, outOfRange);
+    tok.Kind = Token::Number;
+
+    if (outOfRange)
+    {
+        tok.Kind = Token::Invalid;
+        tok.Error = LexError::ScaryNumber;
+    }
+
+    return in;
 }
 
-void parse_symbol(ParseCtx& ctx)
+// on errors, the token is left pointing at the start of the symbol
+static const char* lex_symbol(const char* in, LexToken& tok)
 {
-    const char* in = ctx.InBuffer + ctx.CurrIx;
-    char* out = ctx.TokenSymbol;
-    const char* outEnd = ctx.TokenSymbol + kMaxSymbolLength - 1;
+    char symbol[kMaxSymbolLength+1];
+    char* out = symbol;
+    const char* outEnd = symbol + kMaxSymbolLength - 1;
 
+    const char* start = in;
     *(out++) = *(in++);
     while (out < outEnd && is_symbol_char(*in, false))
         *(out++) = to_lower_sym(*(in++));
 
     *out = 0;
-    
+
+    tok.Kind = Token::Invalid;
     if (is_symbol_char(*in, false))
     {
-        on_parse_error(ctx, "symbol too long");
-        return;
+        tok.Error = LexError::SymbolTooLong;
+        return start;
     }
 
-    ctx.CurrIx = (in - ctx.InBuffer);
-    ctx.NextToken = Token::Symbol;
-}
-
-//-------------------------------------------------------------------------------------------------
-
-void skip_whitespace(ParseCtx& ctx)
-{
-    const char* in = ctx.InBuffer + ctx.CurrIx;
-    for (; *in == ' ' || *in == '\t'; ++in, ++ctx.CurrIx)
+    tok.SymbolId = intern(symbol);
+    if (tok.SymbolId == kNoSymId)
     {
-        /**/
+        tok.Error = LexError::TooManyNames;
+        return start;
     }
+
+    tok.Kind = Token::Symbol;
+    return in;
 }
 
-void advance_token(ParseCtx& ctx)
+// the token starting at in. returns where the next one starts
+static const char* lex_token(const char* in, LexToken& tok)
 {
-    skip_whitespace(ctx);
-
-    const char c = ctx.InBuffer[ctx.CurrIx];
+    const char c = *in;
 
     switch (c)
     {
     case 0:
-        ctx.NextToken = Token::Eof;
-        return; // nb. return early so we don't increment currIx
+        tok.Kind = Token::Eof;
+        return in;
 
     case '0': case '1': case '2': case '3': case '4':
     case '5': case '6': case '7': case '8': case '9':
     case '.':
-        parse_number(ctx);
-        return; // nb. return early so we don't increment currIx again
+        return lex_number(in, tok);
 
-    case '+': ctx.NextToken = Token::Plus;      break;
-    case '*': ctx.NextToken = Token::Times;     break;
-    case '^': ctx.NextToken = Token::Exponent;  break;
-    case '/': ctx.NextToken = Token::Divide;    break;
+    case '+': tok.Kind = Token::Plus;      break;
+    case '*': tok.Kind = Token::Times;     break;
+    case '^': tok.Kind = Token::Exponent;  break;
+    case '/': tok.Kind = Token::Divide;    break;
 
     case '(':
     case '{':
     case '[':
-        ctx.NextToken = Token::LParen;
+        tok.Kind = Token::LParen;
         break;
 
     case ')':
     case '}':
     case ']':
-        ctx.NextToken = Token::RParen;
+        tok.Kind = Token::RParen;
         break;
 
-    case '<': ctx.NextToken = Token::LessThan;  break;
-    case '>': ctx.NextToken = Token::GreaterThan;  break;
+    case '<': tok.Kind = Token::LessThan;  break;
+    case '>': tok.Kind = Token::GreaterThan;  break;
 
-    case '!': ctx.NextToken = Token::Factorial; break;
-    case '=': ctx.NextToken = Token::Equals;    break;
-    case ',': ctx.NextToken = Token::Comma;     break;
+    case '!': tok.Kind = Token::Factorial; break;
+    case '\'': tok.Kind = Token::Prime;    break;
+    case '=': tok.Kind = Token::Equals;    break;
+    case ',': tok.Kind = Token::Comma;     break;
 
     case '-':
-    {
-        const char nextc = ctx.InBuffer[ctx.CurrIx+1];
-        if (nextc == '>')
+        if (in[1] == '>')
         {
-            ctx.NextToken = Token::Map;
-            ctx.CurrIx += 2;
-            return;
+            tok.Kind = Token::Map;
+            return in + 2;
         }
-        ctx.NextToken = Token::Minus;
+        tok.Kind = Token::Minus;
         break;
-    }
 
-    default:
-        if (is_symbol_char(c, true))
+    case ':':
+        if (in[1] != '=')
         {
-            parse_symbol(ctx);
-            return; // nb. return early so we don't increment currIx again
+            tok.Kind = Token::Invalid;
+            return in;
         }
+        tok.Kind = Token::Bind;
+        return in + 2;
 
-        ctx.NextToken = Token::Invalid;
-        return;
+    default:
+        if (is_symbol_char(c, true))
+            return lex_symbol(in, tok);
+
+        tok.Kind = Token::Invalid;
+        return in;
+    }
+
+    return in + 1;
+}
+
+// appends all of the tokens in text to the arena
+static void lex_line(const char* text)
+{
+    const char* in = text;
+    for (;;)
+    {
+        while (*in == ' ' || *in == '\t')
+            ++in;
+
+        const char* start = in;
+
+        LexToken tok;
+        tok.Number = 0.0;
+        in = lex_token(in, tok);
+        tok.Offset = int32_t(in - text);
+
+        // anything that can't be lexed stops the line as well
+        tok.Last = (tok.Kind == Token::Eof) || (tok.Kind == Token::Invalid) || (in == start);
+
+        parser_state().Tokens.push_back(tok);
+        if (is_last_token(tok))
+            return;
     }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void load_token(ParseCtx& ctx)
+{
+    const LexToken& tok = parser_state().Tokens[ctx.TokenIx];
+
+    ctx.NextToken = tok.Kind;
+    if (tok.Kind == Token::Number)
+        ctx.TokenNumber = tok.Number;
+    else if (tok.Kind == Token::Symbol)
+        ctx.TokenSymbolId = tok.SymbolId;
+    ctx.CurrIx = tok.Offset - ctx.TokenBase;
+
+    if (tok.Error != LexError::None)
+        on_parse_error(ctx, kLexErrorMsgs[int(tok.Error)]);
+}
+
+void advance_token(ParseCtx& ctx)
+{
+    ParserState& state = parser_state();
+
+    if (ctx.TokenIx < 0)
+    {
+        ctx.TokenIx = int(state.Tokens.size());
+        ctx.TokenBase = 0;
+        lex_line(ctx.InBuffer);
+    }
+    else if (!is_last_token(state.Tokens[ctx.TokenIx]))
+    {
+        ++ctx.TokenIx;
+    }
+
+    load_token(ctx);
+}
+
+void skip_to_eof(ParseCtx& ctx)
+{
+    if (ctx.TokenIx < 0)
+        return;
+
+    while (!is_last_token(parser_state().Tokens[ctx.TokenIx]))
+        ++ctx.TokenIx;
+
+    load_token(ctx);
+}
+
+Token peek_ahead(const ParseCtx& ctx, int n)
+{
+    ParserState& state = parser_state();
+
+    if (ctx.Error || (ctx.TokenIx < 0))
+        return Token::Invalid;
 
-    ++ctx.CurrIx;
+    int ix = ctx.TokenIx;
+    for (; n > 0 && !is_last_token(state.Tokens[ix]); --n)
+        ++ix;
+
+    return state.Tokens[ix].Kind;
+}
+
+ParseCtx input_after_next(const ParseCtx& ctx)
+{
+    ParseCtx rest { .InBuffer = ctx.InBuffer + ctx.CurrIx, .ResBuffer = ctx.ResBuffer, .ResBufferLen = ctx.ResBufferLen };
+
+    // its first advance steps on from ctx's next token
+    if (ctx.TokenIx >= 0 && !is_last_token(parser_state().Tokens[ctx.TokenIx]))
+    {
+        rest.TokenIx = ctx.TokenIx;
+        rest.TokenBase = ctx.TokenBase + ctx.CurrIx;
+    }
+    return rest;
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -308,7 +427,23 @@ bool expect_symbol(ParseCtx& ctx, char* outSymbolBuf)  // outSymbolBuf must be a
 
     if (ctx.NextToken == Token::Symbol)
     {
-        strcpy(outSymbolBuf, ctx.TokenSymbol);
+        strcpy(outSymbolBuf, interned_name(ctx.TokenSymbolId));
+        advance_token(ctx);
+        return true;
+    }
+
+    on_parse_error(ctx, "expected symbol");
+    return false;
+}
+
+bool expect_symbol(ParseCtx& ctx, SymId& outId)
+{
+    if (ctx.Error)
+        return false;
+
+    if (ctx.NextToken == Token::Symbol)
+    {
+        outId = ctx.TokenSymbolId;
         advance_token(ctx);
         return true;
     }
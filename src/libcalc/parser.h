@@ -1,5 +1,8 @@
 #pragma once
 
+#include "intern.h"
+
+#include <cstdint>
 
 //-----------------------------------------------------------------------------------------------
 
@@ -7,7 +10,7 @@ constexpr int kMaxSymbolLength = 23;
 
 //-----------------------------------------------------------------------------------------------
 
-enum class Token
+enum class Token : uint8_t
 {
     Invalid, Eof,
 
@@ -19,11 +22,13 @@ enum class Token
     Exponent,
     LParen, RParen,
     Factorial,
+    Prime,
 
     LessThan, GreaterThan,
     Equals,
 
     Map,
+    Bind,
     Comma,
 
     COUNT,
@@ -31,19 +36,34 @@ enum class Token
 
 //-----------------------------------------------------------------------------------------------
 
+// a line is lexed all at once, the first time its ParseCtx is advanced, and the parser then just
+// steps through the tokens. they're kept in an arena that's emptied at the start of every
+// calc_eval, like the ast's nodes
 struct ParseCtx
 {
     const char* InBuffer = nullptr;
-    int CurrIx = 0;
+    int CurrIx = 0;     // just past the next token, which is where errors point
 
     char* ResBuffer = nullptr;
     int ResBufferLen = 0;
     bool Error = false;
 
+    // the next token, copied out of the arena
     Token NextToken = Token::Invalid;
-
     double TokenNumber = 0.f;
-    char TokenSymbol[kMaxSymbolLength+1] = {0};
+    SymId TokenSymbolId = kNoSymId;
+
+    int TokenIx = -1;   // of the next token in the arena, or -1 if the input hasn't been lexed
+    int TokenBase = 0;  // where InBuffer starts in the text the tokens were lexed from
+};
+
+// where something was parsed from, so errors found once it's compiled can still point at it. Ix
+// is a CurrIx in the definition of user function Text, or in the line being run if that's
+// kNoSymId
+struct SourcePos
+{
+    SymId Text = kNoSymId;
+    int32_t Ix = 0;
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -52,10 +72,51 @@ bool accept(ParseCtx& ctx, Token t);
 bool expect(ParseCtx& ctx, Token t);
 double expect_number(ParseCtx& ctx);
 bool expect_symbol(ParseCtx& ctx, char* outSymbolBuf);  // outSymbolBuf must be at least kMaxSymbolLength+1 long
+bool expect_symbol(ParseCtx& ctx, SymId& outId);
 bool peek(const ParseCtx& ctx, Token t);
 
+// the token n after the next one, or the last one if the line runs out first
+Token peek_ahead(const ParseCtx& ctx, int n);
+
 void advance_token(ParseCtx& ctx);
+void skip_to_eof(ParseCtx& ctx);
 void on_parse_error(ParseCtx& ctx, const char* msg);
 
+// a ctx for the input after ctx's next token, as if that had been passed in on its own, that
+// reuses the tokens already lexed. it hasn't been advanced yet
+ParseCtx input_after_next(const ParseCtx& ctx);
+
+void reset_tokens();
+
+struct ParserState;
+ParserState* create_parser_state();
+void destroy_parser_state(ParserState* state);
+
+//-----------------------------------------------------------------------------------------------
+
+// which characters names are made of. only the first one keeps its case, the rest are lowered
+constexpr bool is_symbol_char(char c, bool leading)
+{
+    if ((c >= 'A' && c <= 'Z') || ((c >= 'a') && (c <= 'z')))
+        return true;
+    if (c == '_')
+        return true;
+
+    if (leading)
+        return false;
+
+    if (c >= '0' && c <= '9')
+        return true;
+
+    return false;
+}
+
+constexpr char to_lower_sym(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return (c + ('a' - 'A'));
+    return c;
+}
+
 //-----------------------------------------------------------------------------------------------
 
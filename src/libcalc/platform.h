@@ -18,3 +18,31 @@
 
 //-------------------------------------------------------------------------------------------------
 
+// MLN_DISPLAY_xxx is what animations draw to. building with MLN_HEADLESS leaves it out, eg. for
+// the command line calc, and then they don't draw at all
+
+#if MLN_TARGET_PC && !defined(MLN_HEADLESS)
+
+#define MLN_DISPLAY_SDL 1
+
+#elif MLN_TARGET_PICO
+
+#define MLN_DISPLAY_LCD 1
+
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+// MLN_THREAD_LOCAL is for state that's kept per thread, where there are threads
+
+#if MLN_TARGET_PC
+
+#define MLN_THREAD_LOCAL thread_local
+
+#else
+
+#define MLN_THREAD_LOCAL
+
+#endif
+
+//-------------------------------------------------------------------------------------------------
@@ -1,22 +1,36 @@
 #include "plot.h"
 
+#include "context.h"
+#include "dual.h"
 #include "funcs.h"
+#include "interval.h"
+
+#include <algorithm>
 
 //-------------------------------------------------------------------------------------------------
 
-static Plot gPlot;
-static Plot* gActivePlot = nullptr;
+// the curve is first tried this many columns at a time, to skip the parts that are off screen
+constexpr int kSpanColumns = 16;
+
+// how finely a column is cut up looking for where the curve breaks
+constexpr int kMaxSplits = 4;
 
 //-------------------------------------------------------------------------------------------------
 
-const Plot* get_plot()
+const Plot* get_plot(CalcContext* calc)
+{
+    return calc ? calc->ActivePlot : nullptr;
+}
+
+void reset_plot(CalcContext* calc)
 {
-    return gActivePlot;
+    if (calc)
+        calc->ActivePlot = nullptr;
 }
 
-void reset_plot()
+static Plot& plot_buf()
 {
-    gActivePlot = nullptr;
+    return calc_context().PlotBuf;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -25,55 +39,13 @@ static inline void safePlot(int x, int y, uint16_t col)
 {
     if (y >= 0 && y < MC_PLOT_HEIGHT)
     {
-        gPlot.Pixels[y * MC_PLOT_WIDTH + x] = col;
+        plot_buf().Pixels[y * MC_PLOT_WIDTH + x] = col;
     }
 }
 
-static void interpolateY(int startXi, int startYi, int endYi, uint16_t col)
-{
-    if (startYi > endYi)
-    {
-        // asymptote
-        if (startYi - endYi > MC_PLOT_HEIGHT)
-            return;
-
-        if (startYi > MC_PLOT_HEIGHT-1)
-            startYi = MC_PLOT_HEIGHT-1;
-        if (endYi < 0)
-            endYi = 0;
-        if (startYi <= endYi)
-            return;
-
-        const int midYi = (startYi + endYi) / 2;
-        for (int yi = startYi-1; yi > midYi; --yi)
-            safePlot(startXi, yi, col);
-        for (int yi = midYi; yi > endYi; --yi)
-            safePlot(startXi+1, yi, col);
-    }
-    else
-    {
-        // asymptote
-        if (startYi - endYi < -MC_PLOT_HEIGHT)
-            return;
-
-        if (startYi < 0)
-            startYi = 0;
-        if (endYi > MC_PLOT_HEIGHT-1)
-            endYi = MC_PLOT_HEIGHT-1;
-        if (startYi >= endYi)
-            return;
-
-        const int midYi = (startYi + endYi) / 2;
-        for (int yi = startYi+1; yi < midYi; ++yi)
-            safePlot(startXi, yi, col);
-        for (int yi = midYi; yi < endYi; ++yi)
-            safePlot(startXi+1, yi, col);
-    }
-};
-
 static void plot_hline_fast(int x0, int y, int x1, uint16_t col)
 {
-    uint16_t* pix = gPlot.Pixels + x0 + (y*MC_PLOT_WIDTH);
+    uint16_t* pix = plot_buf().Pixels + x0 + (y*MC_PLOT_WIDTH);
     const uint16_t* pixEnd = pix + (x1 - x0 + 1);
     while (pix != pixEnd)
         *(pix++) = col;
@@ -81,16 +53,187 @@ static void plot_hline_fast(int x0, int y, int x1, uint16_t col)
 
 static void plot_vline_fast(int x, int y0, int y1, uint16_t col)
 {
-    uint16_t* pix = gPlot.Pixels + x + (y0*MC_PLOT_WIDTH);
+    uint16_t* pix = plot_buf().Pixels + x + (y0*MC_PLOT_WIDTH);
     const uint16_t* pixEnd = pix + (y1 - y0 + 1) * MC_PLOT_WIDTH;
     for (; pix != pixEnd; pix += MC_PLOT_WIDTH)
         *pix= col;
 }
 
+//-------------------------------------------------------------------------------------------------
+
+// the curve is drawn from interval evaluations (see interval.h), a span of columns at a time. if
+// the function is continuous across a column, the column is filled between the values at its
+// edges. if it isn't, the column is cut up until the break is pinned down, so nothing is drawn
+// across a pole or past the end of a domain
+//
+// a derivative is drawn the same way, with its values worked out with dual numbers (see dual.h).
+// it's taken to be unbroken wherever the function is, but since its interval isn't known, no part
+// of it can be skipped for being off screen
+struct CurvePlot
+{
+    const UserFunction* Func;
+    const FastAxis& XAx;
+    const FastAxis& YAx;
+    uint16_t Col;
+    bool Deriv;
+    ParseCtx& Ctx;
+};
+
+// screen row for y, clamped first so huge values can't overflow
+static int row_of(const FastAxis& yAx, double y)
+{
+    const double range = yAx.Axis.Hi - yAx.Axis.Lo;
+    const double lo = yAx.Axis.Lo - range;
+    const double hi = yAx.Axis.Hi + range;
+    return yAx.ToScreen(real_t(y < lo ? lo : (y > hi ? hi : y)));
+}
+
+// false if ys is empty or all of it is above or below the plot
+static bool is_visible(const FastAxis& yAx, const Interval& ys)
+{
+    if (is_empty(ys))
+        return false;
+
+    return (row_of(yAx, ys.Lo) >= 0) && (row_of(yAx, ys.Hi) < MC_PLOT_HEIGHT);
+}
+
+// false if there's no point drawing any of a piece with values ys
+static bool worth_drawing(const CurvePlot& curve, const Interval& ys)
+{
+    return curve.Deriv ? !is_empty(ys) : is_visible(curve.YAx, ys);
+}
+
+static bool sample(const CurvePlot& curve, double x, double& outY)
+{
+    if (curve.Deriv)
+    {
+        Dual res;
+        if (!eval_user_func_dual(curve.Func, { .Val = x, .Deriv = 1.0 }, res, curve.Ctx))
+            return false;
+
+        outY = res.Deriv;
+        return true;
+    }
+
+    outY = eval_user_func(curve.Func, x, curve.Ctx);
+    return !curve.Ctx.Error;
+}
+
+static void plot_rows(int xi, int yi0, int yi1, uint16_t col)
+{
+    if (yi0 > yi1)
+        std::swap(yi0, yi1);
+    if (yi0 < 0)
+        yi0 = 0;
+    if (yi1 > MC_PLOT_HEIGHT-1)
+        yi1 = MC_PLOT_HEIGHT-1;
+
+    if (yi0 <= yi1)
+        plot_vline_fast(xi, yi0, yi1, col);
+}
+
+// for a piece of column xi the curve is unbroken across, so it passes through every height
+// between the values at its ends
+static void plot_edges(const CurvePlot& curve, int xi, double y0, double y1)
+{
+    if (y0 == y0 && y1 == y1)
+        plot_rows(xi, row_of(curve.YAx, y0), row_of(curve.YAx, y1), curve.Col);
+}
+
+// draws the part of the curve over [x0, x1], which is all or part of column xi. y0 and y1 are
+// its values at x0 and x1
+static bool draw_piece(CurvePlot& curve, int xi, double x0, double x1, double y0, double y1, int splits)
+{
+    Interval ys;
+    if (!eval_user_func_interval(curve.Func, { .Lo = x0, .Hi = x1 }, ys, curve.Ctx))
+        return false;
+
+    if (!worth_drawing(curve, ys))
+        return true;
+
+    if (ys.Cont)
+    {
+        plot_edges(curve, xi, y0, y1);
+        return true;
+    }
+
+    if (splits == kMaxSplits)
+    {
+        // the break is somewhere in here, too small to see. just mark the curve either side of it
+        if (y0 == y0)
+            safePlot(xi, row_of(curve.YAx, y0), curve.Col);
+        if (y1 == y1)
+            safePlot(xi, row_of(curve.YAx, y1), curve.Col);
+        return true;
+    }
+
+    const double midX = (x0 + x1) * 0.5;
+    double midY;
+    if (!sample(curve, midX, midY))
+        return false;
+
+    return draw_piece(curve, xi, x0, midX, y0, midY, splits + 1)
+        && draw_piece(curve, xi, midX, x1, midY, y1, splits + 1);
+}
+
+
+static bool draw_curve(CurvePlot& curve)
+{
+    const FastAxis& xAx = curve.XAx;
+
+    // column xi covers the args that round to it, so its edges are half a pixel either side
+    const auto columnEdge = [&](int xi) { return xAx.Axis.Lo + (xi - xAx.LoI - 0.5) * double(xAx.UnitsPerPix); };
+
+    for (int startXi = xAx.LoI; startXi <= xAx.HiI; startXi += kSpanColumns)
+    {
+        const int endXi = (startXi + kSpanColumns <= xAx.HiI) ? (startXi + kSpanColumns) : (xAx.HiI + 1);
+
+        // skip the whole span if the curve can't be on screen anywhere in it
+        Interval ys;
+        if (!eval_user_func_interval(curve.Func, { .Lo = columnEdge(startXi), .Hi = columnEdge(endXi) }, ys, curve.Ctx))
+            return false;
+
+        if (!worth_drawing(curve, ys))
+            continue;
+
+        // the values at the column edges, all in one batch if they're the function's own
+        double xs[kSpanColumns + 1];
+        double edgeYs[kSpanColumns + 1];
+        const int numEdges = endXi - startXi + 1;
+        for (int i = 0; i < numEdges; ++i)
+            xs[i] = columnEdge(startXi + i);
+
+        if (!curve.Deriv)
+        {
+            if (!eval_user_func_batch(curve.Func, xs, edgeYs, numEdges, curve.Ctx))
+                return false;
+        }
+        else
+        {
+            for (int i = 0; i < numEdges; ++i)
+            {
+                if (!sample(curve, xs[i], edgeYs[i]))
+                    return false;
+            }
+        }
+
+        for (int i = 0; i < numEdges - 1; ++i)
+        {
+            // if it's unbroken across the whole span it is across each column too, so there's no
+            // need to look at them one by one
+            if (ys.Cont)
+                plot_edges(curve, startXi + i, edgeYs[i], edgeYs[i + 1]);
+            else if (!draw_piece(curve, startXi + i, xs[i], xs[i + 1], edgeYs[i], edgeYs[i + 1], 0))
+                return false;
+        }
+    }
+
+    return true;
+}
 
-bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, ParseCtx& ctx)
+bool draw_plot(SymId func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, bool withDeriv, ParseCtx& ctx)
 {
-    if (!func_name || !xAxis || !yAxis)
+    if (!xAxis || !yAxis)
         return false;
 
     const UserFunction* func = lookup_user_func(func_name);
@@ -101,12 +244,13 @@ bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAx
     const uint16_t bgCol = 0x1862;
     const uint16_t axisCol = 0x39c4;
     const uint16_t lineCol = 0xff0a;
+    const uint16_t derivCol = 0x4e7f;
 
     const FastAxis xAx(*xAxis, border, MC_PLOT_WIDTH - border - 1);
     const FastAxis yAx(*yAxis, MC_PLOT_HEIGHT - border - 1, border);
 
     // clear our plot pixels
-    uint16_t* pix = gPlot.Pixels;
+    uint16_t* pix = plot_buf().Pixels;
     uint16_t* pixEnd = pix + (MC_PLOT_WIDTH * MC_PLOT_HEIGHT);
     for (; pix != pixEnd; ++pix)
         *pix = bgCol;
@@ -118,35 +262,19 @@ bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAx
     const int yZeroScr = int(xAx.ToScreenClamped(0));
     plot_vline_fast(yZeroScr, yAx.LoI, yAx.HiI, axisCol);
     
-    double lastY = eval_user_func(func, xAx.LoI, ctx);
-    int lastYi = -1;
-
-    for (int xi=xAx.LoI; xi<=xAx.HiI; ++xi)
+    // the derivative goes underneath, so the function itself is never hidden
+    if (withDeriv)
     {
-        const double x = xAx.FromScreen(xi);
-        const double y = eval_user_func(func, x, ctx);
-
-        const double yscr = yAx.ToScreen(y);
-        const int yi = int(yscr);
-
-        if (y == y)
-        {
-            safePlot(xi, yi, lineCol);
+        CurvePlot deriv { .Func = func, .XAx = xAx, .YAx = yAx, .Col = derivCol, .Deriv = true, .Ctx = ctx };
+        if (!draw_curve(deriv))
+            return false;
+    }
 
-            // interpolate if needed and if no nans
-            if (xi > xAx.LoI && lastY==lastY)
-            {
-                const int deltaYi = yi - lastYi;
-                if (deltaYi > 1 || deltaYi < -1)
-                   interpolateY(xi - 1, lastYi, yi, lineCol);
-            }
-        }
+    CurvePlot curve { .Func = func, .XAx = xAx, .YAx = yAx, .Col = lineCol, .Deriv = false, .Ctx = ctx };
+    if (!draw_curve(curve))
+        return false;
 
-        lastY = y;
-        lastYi = yi;
-    }
-    
-    gActivePlot = &gPlot;
+    calc_context().ActivePlot = &plot_buf();
 
     return true;
 }
@@ -76,7 +76,8 @@ struct FastAxis
 
 //-------------------------------------------------------------------------------------------------
 
-bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, ParseCtx& ctx);
+// withDeriv draws the function's derivative as well, in another colour
+bool draw_plot(SymId func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, bool withDeriv, ParseCtx& ctx);
 
 //-------------------------------------------------------------------------------------------------
 
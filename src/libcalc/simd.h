@@ -0,0 +1,321 @@
+#pragma once
+
+#include "platform.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+// VecD and VecF are the widest packs of doubles and floats the target compiles for:
+//   AVX2:  4 doubles, 8 floats
+//   SSE2:  2 doubles, 4 floats
+//   other: 1 of each, so everything written against them still works on the pico
+//
+// comparisons return masks of the same type, with every bit of a lane set where it's true
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MLN_SIMD_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MLN_SIMD_SSE2 1
+#else
+#define MLN_SIMD_NONE 1
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+#if MLN_SIMD_AVX2
+
+struct VecD
+{
+    static constexpr int Width = 4;
+    __m256d V;
+};
+
+struct VecF
+{
+    static constexpr int Width = 8;
+    __m256 V;
+};
+
+inline VecD vec_load(const double* p)       { return { _mm256_loadu_pd(p) }; }
+inline void vec_store(double* p, VecD a)    { _mm256_storeu_pd(p, a.V); }
+inline VecD vec_set1(double d)              { return { _mm256_set1_pd(d) }; }
+
+inline VecD operator+(VecD a, VecD b)       { return { _mm256_add_pd(a.V, b.V) }; }
+inline VecD operator-(VecD a, VecD b)       { return { _mm256_sub_pd(a.V, b.V) }; }
+inline VecD operator*(VecD a, VecD b)       { return { _mm256_mul_pd(a.V, b.V) }; }
+inline VecD operator/(VecD a, VecD b)       { return { _mm256_div_pd(a.V, b.V) }; }
+inline VecD operator-(VecD a)               { return { _mm256_xor_pd(a.V, _mm256_set1_pd(-0.0)) }; }
+
+inline VecD vec_sqrt(VecD a)                { return { _mm256_sqrt_pd(a.V) }; }
+inline VecD vec_round(VecD a)               { return { _mm256_round_pd(a.V, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+inline VecD vec_lt(VecD a, VecD b)          { return { _mm256_cmp_pd(a.V, b.V, _CMP_LT_OQ) }; }
+inline VecD vec_le(VecD a, VecD b)          { return { _mm256_cmp_pd(a.V, b.V, _CMP_LE_OQ) }; }
+inline VecD vec_eq(VecD a, VecD b)          { return { _mm256_cmp_pd(a.V, b.V, _CMP_EQ_OQ) }; }
+inline VecD vec_neq(VecD a, VecD b)         { return { _mm256_cmp_pd(a.V, b.V, _CMP_NEQ_UQ) }; }
+
+inline VecD vec_and(VecD a, VecD b)         { return { _mm256_and_pd(a.V, b.V) }; }
+inline VecD vec_or(VecD a, VecD b)          { return { _mm256_or_pd(a.V, b.V) }; }
+inline VecD vec_andnot(VecD a, VecD b)      { return { _mm256_andnot_pd(a.V, b.V) }; }
+inline VecD vec_select(VecD m, VecD a, VecD b)  { return { _mm256_blendv_pd(b.V, a.V, m.V) }; }
+inline int vec_movemask(VecD m)             { return _mm256_movemask_pd(m.V); }
+
+// splits positive normal x into m * 2^e with m in [1,2)
+inline VecD vec_split_exp(VecD x, VecD& e)
+{
+    const __m256i bits = _mm256_castpd_si256(x.V);
+    const __m256i expBits = _mm256_srli_epi64(bits, 52);
+    e.V = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(expBits, _mm256_set1_epi64x(0x4330000000000000ll))),
+        _mm256_set1_pd(4503599627370496.0 + 1023.0));
+
+    const __m256i mant = _mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffll));
+    return { _mm256_castsi256_pd(_mm256_or_si256(mant, _mm256_set1_epi64x(0x3ff0000000000000ll))) };
+}
+
+inline VecF vec_load(const float* p)        { return { _mm256_loadu_ps(p) }; }
+inline void vec_store(float* p, VecF a)     { _mm256_storeu_ps(p, a.V); }
+inline VecF vec_set1(float f)               { return { _mm256_set1_ps(f) }; }
+
+inline VecF operator+(VecF a, VecF b)       { return { _mm256_add_ps(a.V, b.V) }; }
+inline VecF operator-(VecF a, VecF b)       { return { _mm256_sub_ps(a.V, b.V) }; }
+inline VecF operator*(VecF a, VecF b)       { return { _mm256_mul_ps(a.V, b.V) }; }
+inline VecF operator/(VecF a, VecF b)       { return { _mm256_div_ps(a.V, b.V) }; }
+inline VecF operator-(VecF a)               { return { _mm256_xor_ps(a.V, _mm256_set1_ps(-0.0f)) }; }
+
+inline VecF vec_sqrt(VecF a)                { return { _mm256_sqrt_ps(a.V) }; }
+inline VecF vec_round(VecF a)               { return { _mm256_round_ps(a.V, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+inline VecF vec_lt(VecF a, VecF b)          { return { _mm256_cmp_ps(a.V, b.V, _CMP_LT_OQ) }; }
+inline VecF vec_le(VecF a, VecF b)          { return { _mm256_cmp_ps(a.V, b.V, _CMP_LE_OQ) }; }
+inline VecF vec_eq(VecF a, VecF b)          { return { _mm256_cmp_ps(a.V, b.V, _CMP_EQ_OQ) }; }
+inline VecF vec_neq(VecF a, VecF b)         { return { _mm256_cmp_ps(a.V, b.V, _CMP_NEQ_UQ) }; }
+
+inline VecF vec_and(VecF a, VecF b)         { return { _mm256_and_ps(a.V, b.V) }; }
+inline VecF vec_or(VecF a, VecF b)          { return { _mm256_or_ps(a.V, b.V) }; }
+inline VecF vec_andnot(VecF a, VecF b)      { return { _mm256_andnot_ps(a.V, b.V) }; }
+inline VecF vec_select(VecF m, VecF a, VecF b)  { return { _mm256_blendv_ps(b.V, a.V, m.V) }; }
+inline int vec_movemask(VecF m)             { return _mm256_movemask_ps(m.V); }
+
+inline VecF vec_split_exp(VecF x, VecF& e)
+{
+    const __m256i bits = _mm256_castps_si256(x.V);
+    e.V = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 23)), _mm256_set1_ps(127.0f));
+
+    const __m256i mant = _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff));
+    return { _mm256_castsi256_ps(_mm256_or_si256(mant, _mm256_set1_epi32(0x3f800000))) };
+}
+
+#elif MLN_SIMD_SSE2
+
+struct VecD
+{
+    static constexpr int Width = 2;
+    __m128d V;
+};
+
+struct VecF
+{
+    static constexpr int Width = 4;
+    __m128 V;
+};
+
+inline VecD vec_load(const double* p)       { return { _mm_loadu_pd(p) }; }
+inline void vec_store(double* p, VecD a)    { _mm_storeu_pd(p, a.V); }
+inline VecD vec_set1(double d)              { return { _mm_set1_pd(d) }; }
+
+inline VecD operator+(VecD a, VecD b)       { return { _mm_add_pd(a.V, b.V) }; }
+inline VecD operator-(VecD a, VecD b)       { return { _mm_sub_pd(a.V, b.V) }; }
+inline VecD operator*(VecD a, VecD b)       { return { _mm_mul_pd(a.V, b.V) }; }
+inline VecD operator/(VecD a, VecD b)       { return { _mm_div_pd(a.V, b.V) }; }
+inline VecD operator-(VecD a)               { return { _mm_xor_pd(a.V, _mm_set1_pd(-0.0)) }; }
+
+inline VecD vec_sqrt(VecD a)                { return { _mm_sqrt_pd(a.V) }; }
+
+// no roundpd before SSE4.1; adding and removing 1.5*2^52 rounds to nearest for |a| < 2^51
+inline VecD vec_round(VecD a)
+{
+    const __m128d magic = _mm_set1_pd(6755399441055744.0);
+    return { _mm_sub_pd(_mm_add_pd(a.V, magic), magic) };
+}
+
+inline VecD vec_lt(VecD a, VecD b)          { return { _mm_cmplt_pd(a.V, b.V) }; }
+inline VecD vec_le(VecD a, VecD b)          { return { _mm_cmple_pd(a.V, b.V) }; }
+inline VecD vec_eq(VecD a, VecD b)          { return { _mm_cmpeq_pd(a.V, b.V) }; }
+inline VecD vec_neq(VecD a, VecD b)         { return { _mm_cmpneq_pd(a.V, b.V) }; }
+
+inline VecD vec_and(VecD a, VecD b)         { return { _mm_and_pd(a.V, b.V) }; }
+inline VecD vec_or(VecD a, VecD b)          { return { _mm_or_pd(a.V, b.V) }; }
+inline VecD vec_andnot(VecD a, VecD b)      { return { _mm_andnot_pd(a.V, b.V) }; }
+inline VecD vec_select(VecD m, VecD a, VecD b)  { return { _mm_or_pd(_mm_and_pd(m.V, a.V), _mm_andnot_pd(m.V, b.V)) }; }
+inline int vec_movemask(VecD m)             { return _mm_movemask_pd(m.V); }
+
+// splits positive normal x into m * 2^e with m in [1,2)
+inline VecD vec_split_exp(VecD x, VecD& e)
+{
+    const __m128i bits = _mm_castpd_si128(x.V);
+    const __m128i expBits = _mm_srli_epi64(bits, 52);
+    e.V = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(expBits, _mm_set1_epi64x(0x4330000000000000ll))),
+        _mm_set1_pd(4503599627370496.0 + 1023.0));
+
+    const __m128i mant = _mm_and_si128(bits, _mm_set1_epi64x(0x000fffffffffffffll));
+    return { _mm_castsi128_pd(_mm_or_si128(mant, _mm_set1_epi64x(0x3ff0000000000000ll))) };
+}
+
+inline VecF vec_load(const float* p)        { return { _mm_loadu_ps(p) }; }
+inline void vec_store(float* p, VecF a)     { _mm_storeu_ps(p, a.V); }
+inline VecF vec_set1(float f)               { return { _mm_set1_ps(f) }; }
+
+inline VecF operator+(VecF a, VecF b)       { return { _mm_add_ps(a.V, b.V) }; }
+inline VecF operator-(VecF a, VecF b)       { return { _mm_sub_ps(a.V, b.V) }; }
+inline VecF operator*(VecF a, VecF b)       { return { _mm_mul_ps(a.V, b.V) }; }
+inline VecF operator/(VecF a, VecF b)       { return { _mm_div_ps(a.V, b.V) }; }
+inline VecF operator-(VecF a)               { return { _mm_xor_ps(a.V, _mm_set1_ps(-0.0f)) }; }
+
+inline VecF vec_sqrt(VecF a)                { return { _mm_sqrt_ps(a.V) }; }
+
+// 1.5*2^23 does the same job for floats, for |a| < 2^22
+inline VecF vec_round(VecF a)
+{
+    const __m128 magic = _mm_set1_ps(12582912.0f);
+    return { _mm_sub_ps(_mm_add_ps(a.V, magic), magic) };
+}
+
+inline VecF vec_lt(VecF a, VecF b)          { return { _mm_cmplt_ps(a.V, b.V) }; }
+inline VecF vec_le(VecF a, VecF b)          { return { _mm_cmple_ps(a.V, b.V) }; }
+inline VecF vec_eq(VecF a, VecF b)          { return { _mm_cmpeq_ps(a.V, b.V) }; }
+inline VecF vec_neq(VecF a, VecF b)         { return { _mm_cmpneq_ps(a.V, b.V) }; }
+
+inline VecF vec_and(VecF a, VecF b)         { return { _mm_and_ps(a.V, b.V) }; }
+inline VecF vec_or(VecF a, VecF b)          { return { _mm_or_ps(a.V, b.V) }; }
+inline VecF vec_andnot(VecF a, VecF b)      { return { _mm_andnot_ps(a.V, b.V) }; }
+inline VecF vec_select(VecF m, VecF a, VecF b)  { return { _mm_or_ps(_mm_and_ps(m.V, a.V), _mm_andnot_ps(m.V, b.V)) }; }
+inline int vec_movemask(VecF m)             { return _mm_movemask_ps(m.V); }
+
+inline VecF vec_split_exp(VecF x, VecF& e)
+{
+    const __m128i bits = _mm_castps_si128(x.V);
+    e.V = _mm_sub_ps(_mm_cvtepi32_ps(_mm_srli_epi32(bits, 23)), _mm_set1_ps(127.0f));
+
+    const __m128i mant = _mm_and_si128(bits, _mm_set1_epi32(0x007fffff));
+    return { _mm_castsi128_ps(_mm_or_si128(mant, _mm_set1_epi32(0x3f800000))) };
+}
+
+#else
+
+struct VecD
+{
+    static constexpr int Width = 1;
+    double V;
+};
+
+struct VecF
+{
+    static constexpr int Width = 1;
+    float V;
+};
+
+// masks are lanes with all bits set, same as the real SIMD versions
+template<typename T, typename BitsT>
+inline T vec_bits_op(T a, T b, BitsT (*op)(BitsT, BitsT))
+{
+    BitsT ab, bb;
+    memcpy(&ab, &a, sizeof(ab));
+    memcpy(&bb, &b, sizeof(bb));
+    const BitsT rb = op(ab, bb);
+    T r;
+    memcpy(&r, &rb, sizeof(r));
+    return r;
+}
+
+template<typename T, typename BitsT>
+inline T vec_mask(bool b)
+{
+    const BitsT bits = b ? ~BitsT(0) : BitsT(0);
+    T r;
+    memcpy(&r, &bits, sizeof(r));
+    return r;
+}
+
+inline VecD vec_load(const double* p)       { return { *p }; }
+inline void vec_store(double* p, VecD a)    { *p = a.V; }
+inline VecD vec_set1(double d)              { return { d }; }
+
+inline VecD operator+(VecD a, VecD b)       { return { a.V + b.V }; }
+inline VecD operator-(VecD a, VecD b)       { return { a.V - b.V }; }
+inline VecD operator*(VecD a, VecD b)       { return { a.V * b.V }; }
+inline VecD operator/(VecD a, VecD b)       { return { a.V / b.V }; }
+inline VecD operator-(VecD a)               { return { -a.V }; }
+
+inline VecD vec_sqrt(VecD a)                { return { std::sqrt(a.V) }; }
+inline VecD vec_round(VecD a)               { return { std::nearbyint(a.V) }; }
+
+inline VecD vec_lt(VecD a, VecD b)          { return { vec_mask<double, uint64_t>(a.V < b.V) }; }
+inline VecD vec_le(VecD a, VecD b)          { return { vec_mask<double, uint64_t>(a.V <= b.V) }; }
+inline VecD vec_eq(VecD a, VecD b)          { return { vec_mask<double, uint64_t>(a.V == b.V) }; }
+inline VecD vec_neq(VecD a, VecD b)         { return { vec_mask<double, uint64_t>(a.V != b.V) }; }
+
+inline VecD vec_and(VecD a, VecD b)     { return { vec_bits_op<double, uint64_t>(a.V, b.V, [](uint64_t x, uint64_t y) { return x & y; }) }; }
+inline VecD vec_or(VecD a, VecD b)      { return { vec_bits_op<double, uint64_t>(a.V, b.V, [](uint64_t x, uint64_t y) { return x | y; }) }; }
+inline VecD vec_andnot(VecD a, VecD b)  { return { vec_bits_op<double, uint64_t>(a.V, b.V, [](uint64_t x, uint64_t y) { return ~x & y; }) }; }
+inline int vec_movemask(VecD m)         { return std::signbit(m.V) ? 1 : 0; }
+inline VecD vec_select(VecD m, VecD a, VecD b)  { return vec_movemask(m) ? a : b; }
+
+// splits positive normal x into m * 2^e with m in [1,2)
+inline VecD vec_split_exp(VecD x, VecD& e)
+{
+    int ie;
+    const double m = std::frexp(x.V, &ie);
+    e.V = ie - 1;
+    return { m * 2.0 };
+}
+
+inline VecF vec_load(const float* p)        { return { *p }; }
+inline void vec_store(float* p, VecF a)     { *p = a.V; }
+inline VecF vec_set1(float f)               { return { f }; }
+
+inline VecF operator+(VecF a, VecF b)       { return { a.V + b.V }; }
+inline VecF operator-(VecF a, VecF b)       { return { a.V - b.V }; }
+inline VecF operator*(VecF a, VecF b)       { return { a.V * b.V }; }
+inline VecF operator/(VecF a, VecF b)       { return { a.V / b.V }; }
+inline VecF operator-(VecF a)               { return { -a.V }; }
+
+inline VecF vec_sqrt(VecF a)                { return { std::sqrt(a.V) }; }
+inline VecF vec_round(VecF a)               { return { std::nearbyint(a.V) }; }
+
+inline VecF vec_lt(VecF a, VecF b)          { return { vec_mask<float, uint32_t>(a.V < b.V) }; }
+inline VecF vec_le(VecF a, VecF b)          { return { vec_mask<float, uint32_t>(a.V <= b.V) }; }
+inline VecF vec_eq(VecF a, VecF b)          { return { vec_mask<float, uint32_t>(a.V == b.V) }; }
+inline VecF vec_neq(VecF a, VecF b)         { return { vec_mask<float, uint32_t>(a.V != b.V) }; }
+
+inline VecF vec_and(VecF a, VecF b)     { return { vec_bits_op<float, uint32_t>(a.V, b.V, [](uint32_t x, uint32_t y) { return x & y; }) }; }
+inline VecF vec_or(VecF a, VecF b)      { return { vec_bits_op<float, uint32_t>(a.V, b.V, [](uint32_t x, uint32_t y) { return x | y; }) }; }
+inline VecF vec_andnot(VecF a, VecF b)  { return { vec_bits_op<float, uint32_t>(a.V, b.V, [](uint32_t x, uint32_t y) { return ~x & y; }) }; }
+inline int vec_movemask(VecF m)         { return std::signbit(m.V) ? 1 : 0; }
+inline VecF vec_select(VecF m, VecF a, VecF b)  { return vec_movemask(m) ? a : b; }
+
+inline VecF vec_split_exp(VecF x, VecF& e)
+{
+    int ie;
+    const float m = std::frexp(x.V, &ie);
+    e.V = float(ie - 1);
+    return { m * 2.0f };
+}
+
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+// derived ops that are the same whatever the pack
+
+template<typename V> inline V vec_gt(V a, V b)  { return vec_lt(b, a); }
+template<typename V> inline V vec_ge(V a, V b)  { return vec_le(b, a); }
+
+inline VecD vec_abs(VecD a)     { return vec_andnot(vec_set1(-0.0), a); }
+inline VecF vec_abs(VecF a)     { return vec_andnot(vec_set1(-0.0f), a); }
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,390 @@
+#include "simplify.h"
+
+#include "context.h"
+
+#include <cmath>
+
+//-------------------------------------------------------------------------------------------------
+
+// these rewrites are only done to function bodies, which get run many times. they're not all
+// bit-exact with the tree as written. every way they can differ:
+//
+//  - polynomials in the arg are collected into Horner form. like terms are only merged when they
+//    have the same sign, so nothing cancels (x-x, x*0, 2x-x and x+1-1 are left as written), but
+//    the merged coefficients can round differently. a polynomial where terms would cancel is left
+//    as written all the way down, since an ulp lost in one of its sums, eg. the 3x^3+x in
+//    x-(3x^3+x), is most of what's left once the x's cancel
+//  - Horner form multiplies where the written form adds, so at x = +-inf a sum of terms with
+//    mixed signs is +-inf where the written form made inf - inf = nan, eg. x^2 - x. it can also
+//    overflow later or earlier than the written form for huge x
+//  - at x = +-0 a Horner form with no constant term gives +0 (unless it's a single term), where
+//    the written form gives -0 if every term is -0, eg. -x^2 - x at x = 0
+//  - x^3 and x^4 become multiplies, which can be 1 ulp off std::pow. x^2 and x^-1 are exact
+//  - x^-2 becomes 1/(x*x), which can be 1 ulp off, and is 0 instead of tiny when x*x overflows
+//  - x/c becomes x*(1/c), which is exact when c is a power of 2 and can be 1 ulp off otherwise
+//  - nan comes out with whatever sign the new ops give it, which isn't always the sign pow or
+//    the written ops would have given
+//
+// everything else (x*1, x/1, x-0, x+-0, x^1, x^0, --x, a+-b, a--b) gives identical results.
+// x+0 is left alone, since it turns -0 into +0
+
+constexpr int kMaxPolyDegree = 8;
+constexpr int kMaxMonomialDepth = 32;  // anything deeper is left as written
+
+struct Poly
+{
+    double Coeffs[kMaxPolyDegree + 1] = {};
+    int NumTerms = 0;
+    bool Cancels = false;   // a term is zero, or partly cancels another
+};
+
+//-------------------------------------------------------------------------------------------------
+
+static bool is_const(const Node* node, double val)
+{
+    return node && (node->Kind == NodeKind::Const) && (node->Value == val);
+}
+
+// 0 and -0 compare equal, but x+0 and x-(-0) turn -0 into +0, where x+(-0) and x-0 don't
+static bool is_zero(const Node* node, bool negative)
+{
+    return is_const(node, 0.0) && (std::signbit(node->Value) == negative);
+}
+
+// true if b is a Const holding a whole number in [lo,hi]
+static bool is_whole_const(const Node* node, int lo, int hi, int& outVal)
+{
+    if (!node || (node->Kind != NodeKind::Const))
+        return false;
+
+    const double val = node->Value;
+    if (!(val >= lo && val <= hi) || (val != std::floor(val)))
+        return false;
+
+    outVal = int(val);
+    return true;
+}
+
+// anything that looks a name up or can raise an error must still be run, even if its value isn't
+// needed
+static bool can_fail(Node* root)
+{
+    TreeWalk walk;
+    walk.push(root);
+
+    WalkStep step;
+    while (walk.pop(step))
+    {
+        const Node* node = step.At;
+        if (!node)
+            continue;
+
+        switch (node->Kind)
+        {
+        case NodeKind::Sym:
+        case NodeKind::CallUser:
+        case NodeKind::Deriv:
+        case NodeKind::Fact:
+            return true;
+
+        default:
+            walk.push(node->B);
+            walk.push(node->A);
+            break;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// matches c * x^k, built from numbers, the arg, multiplies, division by a number, negation and
+// whole powers
+static bool match_monomial(const Node* node, double& coeff, int& power, int depth = 0)
+{
+    if (depth > kMaxMonomialDepth)
+        return false;
+
+    switch (node->Kind)
+    {
+    case NodeKind::Const:
+        coeff = node->Value;
+        power = 0;
+        return true;
+
+    case NodeKind::Arg:
+        coeff = 1.0;
+        power = 1;
+        return true;
+
+    case NodeKind::Neg:
+        if (!match_monomial(node->A, coeff, power, depth + 1))
+            return false;
+        coeff = -coeff;
+        return true;
+
+    case NodeKind::Mul:
+    {
+        double coeffB;
+        int powerB;
+        if (!match_monomial(node->A, coeff, power, depth + 1) || !match_monomial(node->B, coeffB, powerB, depth + 1))
+            return false;
+
+        coeff *= coeffB;
+        power += powerB;
+        return power <= kMaxPolyDegree;
+    }
+
+    case NodeKind::Div:
+        if ((node->B->Kind != NodeKind::Const) || !match_monomial(node->A, coeff, power, depth + 1))
+            return false;
+        coeff /= node->B->Value;
+        return true;
+
+    case NodeKind::Pow:
+    {
+        int exponent;
+        if (!is_whole_const(node->B, 0, kMaxPolyDegree, exponent) || !match_monomial(node->A, coeff, power, depth + 1))
+            return false;
+
+        coeff = std::pow(coeff, exponent);
+        power *= exponent;
+        return power <= kMaxPolyDegree;
+    }
+
+    default:
+        return false;
+    }
+}
+
+// matches a sum of monomials. products of sums aren't expanded, since that can lose a lot of
+// precision, eg. (x-1)^8 near 1. terms are taken left to right, with their sign in the tag
+static bool match_poly(Node* root, Poly& poly)
+{
+    TreeWalk walk;
+    walk.push(root, nullptr, 1);
+
+    WalkStep step;
+    while (walk.pop(step))
+    {
+        const Node* node = step.At;
+        const int sign = step.Tag;
+
+        switch (node->Kind)
+        {
+        case NodeKind::Add:
+            walk.push(node->B, nullptr, sign);
+            walk.push(node->A, nullptr, sign);
+            break;
+
+        case NodeKind::Sub:
+            walk.push(node->B, nullptr, -sign);
+            walk.push(node->A, nullptr, sign);
+            break;
+
+        case NodeKind::Neg:
+            walk.push(node->A, nullptr, -sign);
+            break;
+
+        default:
+        {
+            double coeff;
+            int power;
+            if (!match_monomial(node, coeff, power))
+                return false;
+
+            // dropping these would change what inf and nan give
+            const double term = sign * coeff;
+            double& sum = poly.Coeffs[power];
+            if ((term == 0.0) || ((sum != 0.0) && (std::signbit(sum) != std::signbit(term))))
+                poly.Cancels = true;
+
+            sum += term;
+            ++poly.NumTerms;
+            break;
+        }
+        }
+    }
+
+    return true;
+}
+
+// ((c[n] x + c[n-1]) x + ...) x + c[0], skipping the adds of zero coefficients. with more than
+// one term and no c[0], 0 is still added, or x^2 - x would be -0 at x = 0
+static Node* build_horner(const Poly& poly, int degree, int numNonZero)
+{
+    const double* c = poly.Coeffs;
+
+    Node* node = (c[degree] == 1.0) ? new_node(NodeKind::Arg)
+               : new_node(NodeKind::Mul, new_const(c[degree]), new_node(NodeKind::Arg));
+
+    for (int i = degree - 1; ; --i)
+    {
+        if ((c[i] != 0.0) || ((i == 0) && (numNonZero > 1)))
+            node = new_node(NodeKind::Add, node, new_const(c[i]));
+        if (i == 0)
+            break;
+        node = new_node(NodeKind::Mul, node, new_node(NodeKind::Arg));
+    }
+
+    return node;
+}
+
+// the Horner form of a polynomial subtree, node itself to leave it as written, or null to look
+// further down
+static Node* horner_form(Node* node)
+{
+    Poly poly;
+    if (match_poly(node, poly))
+    {
+        if (poly.Cancels)
+            return node;
+
+        int degree = 0;
+        int numNonZero = 0;
+        bool finite = true;
+        for (int i = 0; i <= kMaxPolyDegree; ++i)
+        {
+            finite = finite && std::isfinite(poly.Coeffs[i]);
+            if (poly.Coeffs[i] != 0.0)
+            {
+                degree = i;
+                ++numNonZero;
+            }
+        }
+
+        // worth it for anything with a power in it, or where terms were merged
+        if (finite && (degree >= 1) && ((degree >= 2) || (poly.NumTerms > numNonZero)))
+        {
+            ++calc_context().Simplify.PolysRewritten;
+            return build_horner(poly, degree, numNonZero);
+        }
+    }
+
+    return nullptr;
+}
+
+static Node* keep_node(Node* node)
+{
+    return node;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static Node* dropped(Node* node)
+{
+    ++calc_context().Simplify.OpsDropped;
+    return node;
+}
+
+static Node* square(Node* node)
+{
+    return new_node(NodeKind::Mul, node, node);
+}
+
+static Node* rewrite_pow(Node* node)
+{
+    Node* base = node->A;
+
+    int exponent;
+    if (!is_whole_const(node->B, -2, 4, exponent))
+        return node;
+
+    // only cheap bases are worth running twice
+    const bool leaf = (base->Kind == NodeKind::Arg) || (base->Kind == NodeKind::Sym);
+
+    Node* out = nullptr;
+    switch (exponent)
+    {
+    case -2:    out = new_node(NodeKind::Div, new_const(1.0), square(base));   break;
+    case -1:    out = new_node(NodeKind::Div, new_const(1.0), base);           break;
+    case 0:     if (!can_fail(base)) out = new_const(1.0);                      break;
+    case 1:     out = base;                                                     break;
+    case 2:     out = square(base);                                             break;
+    case 3:     if (leaf) out = new_node(NodeKind::Mul, square(base), base);    break;
+    case 4:     out = square(square(base));                                     break;
+    }
+
+    if (!out)
+        return node;
+
+    ++calc_context().Simplify.PowsExpanded;
+    return out;
+}
+
+// children have already been rewritten
+static Node* rewrite_op(Node* node)
+{
+    Node* a = node->A;
+    Node* b = node->B;
+
+    switch (node->Kind)
+    {
+    case NodeKind::Neg:
+        if (a->Kind == NodeKind::Neg)
+            return dropped(a->A);
+        break;
+
+    case NodeKind::Add:
+        if (is_zero(b, true))
+            return dropped(a);
+        if (is_zero(a, true))
+            return dropped(b);
+        if (b->Kind == NodeKind::Neg)
+            return dropped(new_node(NodeKind::Sub, a, b->A));
+        break;
+
+    case NodeKind::Sub:
+        if (is_zero(b, false))
+            return dropped(a);
+        if (b->Kind == NodeKind::Neg)
+            return dropped(new_node(NodeKind::Add, a, b->A));
+        break;
+
+    case NodeKind::Mul:
+        if (is_const(b, 1.0))
+            return dropped(a);
+        if (is_const(a, 1.0))
+            return dropped(b);
+        break;
+
+    case NodeKind::Div:
+        if (is_const(b, 1.0))
+            return dropped(a);
+        if (b->Kind == NodeKind::Const)
+        {
+            const double recip = 1.0 / b->Value;
+            if (std::isnormal(recip))
+            {
+                ++calc_context().Simplify.DivsRewritten;
+                return new_node(NodeKind::Mul, a, new_const(recip));
+            }
+        }
+        break;
+
+    case NodeKind::Pow:
+        return rewrite_pow(node);
+
+    default:
+        break;
+    }
+
+    return node;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Node* simplify_tree(Node* root)
+{
+    // the largest polynomial subtrees become Horner forms, then ops are tidied bottom up
+    root = rewrite_tree(root, horner_form, keep_node);
+    return rewrite_tree(root, enter_every_node, rewrite_op);
+}
+
+const SimplifyStats& simplify_stats()
+{
+    return calc_context().Simplify;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ast.h"
+
+//-------------------------------------------------------------------------------------------------
+
+struct SimplifyStats
+{
+    uint32_t PolysRewritten = 0;
+    uint32_t PowsExpanded = 0;
+    uint32_t DivsRewritten = 0;
+    uint32_t OpsDropped = 0;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+// rewrites a folded function body into something cheaper to run: polynomials in the arg become
+// Horner form, small integer powers become multiplies, division by a constant becomes a multiply,
+// and ops that do nothing are dropped. some of these round differently, see simplify.cpp
+//
+// the result may share subtrees, eg. x^2 is Mul(x, x) with both sides the same node
+Node* simplify_tree(Node* root);
+
+const SimplifyStats& simplify_stats();
+
+//-------------------------------------------------------------------------------------------------
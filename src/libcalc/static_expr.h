@@ -0,0 +1,685 @@
+#pragma once
+
+#include "ast.h"
+#include "libcalc.h"
+#include "maths.h"
+#include "parser.h"
+
+#include <cmath>
+#include <cstdint>
+
+//-------------------------------------------------------------------------------------------------
+
+// functions of x that are compiled along with the program, for builds where some formulas are
+// fixed. the text is parsed at compile time by the same grammar as expr.cpp, quirks and all, and
+// the tree is turned into straight line code by template instantiation, so nothing is parsed or
+// interpreted at run time:
+//
+//     CALC_REGISTER_STATIC_FUNC(calc, "hann", "0.5 - 0.5cos(2pi*x)");
+//
+// only x, pi, e and the builtin functions can be used. a formula that doesn't parse stops the
+// build, with the reason in the static_expr_error call the compiler points at. numbers are read
+// exactly as strtod would, so the results are the same as running the formula as a user
+// function without its simplifying. the one difference is that where the calculator stops with an
+// error, eg. the factorial of 1.5, these give NaN
+
+// a calc_func made from def, which must be a string literal
+#define CALC_STATIC_EXPR(def) \
+    ([]() -> calc_func { \
+        struct Src { static constexpr const char* text() { return def; } }; \
+        return &StaticExpr<Src>::call; \
+    }())
+
+// the text is kept too, which plotting and derivatives work from
+#define CALC_REGISTER_STATIC_FUNC(calc, name, def) \
+    register_calc_func(calc, name, CALC_STATIC_EXPR(def), def)
+
+//-------------------------------------------------------------------------------------------------
+
+constexpr int kMaxStaticNodes = 64;
+
+enum class StaticFunc : uint8_t
+{
+    Sin, Cos, Tan, Sinc,
+    Asin, Acos, Atan,
+    Ln, Log, Sqrt,
+};
+
+// the same as an ast.h Node, except named values are already Consts. A and B index the tree
+struct StaticNode
+{
+    NodeKind Kind = NodeKind::Const;
+    StaticFunc Func = StaticFunc::Sin;
+    double Value = 0.0;
+
+    int A = -1;
+    int B = -1;
+};
+
+struct StaticTree
+{
+    StaticNode Nodes[kMaxStaticNodes] = {};
+    int NumNodes = 0;
+    int Root = -1;
+};
+
+// not constexpr, so reaching it while compiling a formula fails the build
+inline void static_expr_error(const char* /*why*/)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// strtod rounds correctly, so numbers are read with big integers to get the same bits. 2048 bits
+// is enough for anything that doesn't overflow or underflow
+constexpr int kStaticBigLimbs = 64;
+constexpr int kMaxStaticDigits = 40;
+
+struct StaticBig
+{
+    uint32_t Limbs[kStaticBigLimbs] = {};
+    int Len = 0;    // without leading zero limbs
+};
+
+constexpr void static_big_mul_add(StaticBig& big, uint32_t mul, uint32_t add)
+{
+    uint64_t carry = add;
+    for (int i = 0; i < big.Len; ++i)
+    {
+        const uint64_t v = uint64_t(big.Limbs[i]) * mul + carry;
+        big.Limbs[i] = uint32_t(v);
+        carry = v >> 32;
+    }
+
+    if (carry)
+        big.Limbs[big.Len++] = uint32_t(carry);
+}
+
+constexpr StaticBig static_big_shl(const StaticBig& big, int bits)
+{
+    StaticBig res;
+    if (big.Len == 0)
+        return res;
+
+    const int limbs = bits / 32;
+    const int shift = bits % 32;
+    for (int i = big.Len - 1; i >= 0; --i)
+    {
+        const uint64_t v = uint64_t(big.Limbs[i]) << shift;
+        res.Limbs[i + limbs + 1] |= uint32_t(v >> 32);
+        res.Limbs[i + limbs] |= uint32_t(v);
+    }
+
+    res.Len = big.Len + limbs + 1;
+    while (res.Len > 0 && res.Limbs[res.Len - 1] == 0)
+        --res.Len;
+    return res;
+}
+
+constexpr int static_big_cmp(const StaticBig& a, const StaticBig& b)
+{
+    if (a.Len != b.Len)
+        return (a.Len < b.Len) ? -1 : 1;
+
+    for (int i = a.Len - 1; i >= 0; --i)
+    {
+        if (a.Limbs[i] != b.Limbs[i])
+            return (a.Limbs[i] < b.Limbs[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+// a -= b, where a >= b
+constexpr void static_big_sub(StaticBig& a, const StaticBig& b)
+{
+    int64_t borrow = 0;
+    for (int i = 0; i < a.Len; ++i)
+    {
+        const int64_t v = int64_t(a.Limbs[i]) - ((i < b.Len) ? b.Limbs[i] : 0) - borrow;
+        borrow = (v < 0) ? 1 : 0;
+        a.Limbs[i] = uint32_t(v + (borrow << 32));
+    }
+
+    while (a.Len > 0 && a.Limbs[a.Len - 1] == 0)
+        --a.Len;
+}
+
+constexpr int static_big_bits(const StaticBig& big)
+{
+    if (big.Len == 0)
+        return 0;
+
+    int bits = (big.Len - 1) * 32;
+    for (uint32_t top = big.Limbs[big.Len - 1]; top; top >>= 1)
+        ++bits;
+    return bits;
+}
+
+constexpr double static_pow2(int e)
+{
+    double res = 1.0;
+    for (; e > 0; --e)
+        res *= 2.0;
+    for (; e < 0; ++e)
+        res *= 0.5;
+    return res;
+}
+
+// digits * 10^exp10 rounded to nearest even, or false if it's too big or too small for strtod
+constexpr bool static_decimal(const StaticBig& digits, int numDigits, int exp10, double& outVal)
+{
+    outVal = 0.0;
+    if (digits.Len == 0)
+        return true;
+
+    if ((exp10 > 308) || (numDigits + exp10 < -310))
+        return false;
+
+    StaticBig num = digits;
+    StaticBig den;
+    den.Limbs[0] = 1;
+    den.Len = 1;
+    for (int i = 0; i < exp10; ++i)
+        static_big_mul_add(num, 10, 0);
+    for (int i = 0; i < -exp10; ++i)
+        static_big_mul_add(den, 10, 0);
+
+    // scale so the quotient has 55 or 56 bits, then do the long division a bit at a time
+    const int shift = 55 - (static_big_bits(num) - static_big_bits(den));
+    if (shift > 0)
+        num = static_big_shl(num, shift);
+    else
+        den = static_big_shl(den, -shift);
+
+    uint64_t q = 0;
+    for (int bit = 56; bit >= 0; --bit)
+    {
+        const StaticBig part = static_big_shl(den, bit);
+        if (static_big_cmp(num, part) >= 0)
+        {
+            static_big_sub(num, part);
+            q |= uint64_t(1) << bit;
+        }
+    }
+    const bool sticky = (num.Len != 0);
+
+    int qBits = 0;
+    for (uint64_t v = q; v; v >>= 1)
+        ++qBits;
+
+    int exp2 = qBits - 1 - shift;
+    const int drop = qBits - 53;
+    uint64_t mant = q >> drop;
+    const uint64_t rest = q & ((uint64_t(1) << drop) - 1);
+    const uint64_t half = uint64_t(1) << (drop - 1);
+    if ((rest > half) || ((rest == half) && (sticky || (mant & 1))))
+        ++mant;
+    if (mant == (uint64_t(1) << 53))
+    {
+        mant >>= 1;
+        ++exp2;
+    }
+
+    // strtod calls subnormals out of range too
+    if ((exp2 > 1023) || (exp2 < -1022))
+        return false;
+
+    outVal = double(mant) * static_pow2(exp2 - 52);
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+struct StaticParser
+{
+    const char* In = nullptr;
+    int CurrIx = 0;
+
+    Token NextToken = Token::Invalid;
+    double TokenNumber = 0.0;
+    char TokenSymbol[kMaxSymbolLength+1] = {};
+
+    StaticTree Tree;
+};
+
+constexpr bool static_is_digit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+constexpr int static_hex_digit(char c)
+{
+    if (static_is_digit(c))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    return -1;
+}
+
+constexpr bool static_str_eq(const char* a, const char* b)
+{
+    for (; *a && (*a == *b); ++a, ++b)
+    {
+    }
+    return *a == *b;
+}
+
+// see parse_number. strtod's hex floats aren't supported, just hex integers
+constexpr void static_parse_number(StaticParser& p)
+{
+    const char* in = p.In + p.CurrIx;
+    p.NextToken = Token::Number;
+
+    if ((in[0] == '0') && ((in[1] == 'x') || (in[1] == 'X')) && (static_hex_digit(in[2]) >= 0))
+    {
+        uint64_t val = 0;
+        for (in += 2; static_hex_digit(*in) >= 0; ++in)
+        {
+            val = val * 16 + uint64_t(static_hex_digit(*in));
+            if (val > (uint64_t(1) << 53))
+                static_expr_error("hex number too big to read exactly");
+        }
+
+        const bool hasExp = ((*in == 'p') || (*in == 'P'))
+            && (static_is_digit(in[1]) || (((in[1] == '+') || (in[1] == '-')) && static_is_digit(in[2])));
+        if ((*in == '.') || hasExp)
+            static_expr_error("hex fractions aren't supported");
+
+        p.TokenNumber = double(val);
+    }
+    else
+    {
+        StaticBig digits;
+        int numDigits = 0;
+        int exp10 = 0;
+        bool anyDigits = false;
+
+        for (; static_is_digit(*in); ++in)
+        {
+            anyDigits = true;
+            if ((numDigits > 0) || (*in != '0'))
+            {
+                static_big_mul_add(digits, 10, uint32_t(*in - '0'));
+                ++numDigits;
+            }
+        }
+        if (*in == '.')
+        {
+            for (++in; static_is_digit(*in); ++in)
+            {
+                anyDigits = true;
+                if ((numDigits > 0) || (*in != '0'))
+                {
+                    static_big_mul_add(digits, 10, uint32_t(*in - '0'));
+                    ++numDigits;
+                }
+                --exp10;
+            }
+        }
+
+        if (!anyDigits)
+            static_expr_error("bad number");
+        if (numDigits > kMaxStaticDigits)
+            static_expr_error("too many digits");
+
+        // only an exponent with digits counts, so 1e is 1 times e
+        const bool isExp = (*in == 'e') || (*in == 'E');
+        const int signIx = (isExp && ((in[1] == '+') || (in[1] == '-'))) ? 2 : 1;
+        if (isExp && static_is_digit(in[signIx]))
+        {
+            const bool negExp = (in[1] == '-');
+            int exp = 0;
+            for (in += signIx; static_is_digit(*in); ++in)
+            {
+                if (exp < 100000)
+                    exp = exp * 10 + (*in - '0');
+            }
+            exp10 += negExp ? -exp : exp;
+        }
+
+        if (!static_decimal(digits, numDigits, exp10, p.TokenNumber))
+            static_expr_error("scary number");
+    }
+
+    p.CurrIx = int(in - p.In);
+
+    // scale units
+    const char c = p.In[p.CurrIx];
+    const char nc = c ? p.In[p.CurrIx+1] : 0;
+    if (c && !is_symbol_char(nc, false))
+    {
+        switch (c)
+        {
+        case 'G':   p.TokenNumber *= 1.0e9;     break;
+        case 'M':   p.TokenNumber *= 1.0e6;     break;
+        case 'k':   p.TokenNumber *= 1.0e3;     break;
+        case 'm':   p.TokenNumber *= 1.0e-3;    break;
+        case 'u':   p.TokenNumber *= 1.0e-6;    break;
+        case 'n':   p.TokenNumber *= 1.0e-9;    break;
+        case 'p':   p.TokenNumber *= 1.0e-12;   break;
+        default:
+            return;
+        }
+
+        ++p.CurrIx;
+    }
+}
+
+// see parse_symbol. only the first letter keeps its case
+constexpr void static_parse_symbol(StaticParser& p)
+{
+    const char* in = p.In + p.CurrIx;
+    int len = 0;
+
+    p.TokenSymbol[len++] = *(in++);
+    while ((len < kMaxSymbolLength - 1) && is_symbol_char(*in, false))
+        p.TokenSymbol[len++] = to_lower_sym(*(in++));
+    p.TokenSymbol[len] = 0;
+
+    if (is_symbol_char(*in, false))
+        static_expr_error("symbol too long");
+
+    p.CurrIx = int(in - p.In);
+    p.NextToken = Token::Symbol;
+}
+
+// see advance_token
+constexpr void static_advance(StaticParser& p)
+{
+    while ((p.In[p.CurrIx] == ' ') || (p.In[p.CurrIx] == '\t'))
+        ++p.CurrIx;
+
+    const char c = p.In[p.CurrIx];
+    if (c == 0)
+    {
+        p.NextToken = Token::Eof;
+        return;
+    }
+
+    if (static_is_digit(c) || (c == '.'))
+    {
+        static_parse_number(p);
+        return;
+    }
+
+    if (is_symbol_char(c, true))
+    {
+        static_parse_symbol(p);
+        return;
+    }
+
+    switch (c)
+    {
+    case '+':   p.NextToken = Token::Plus;      break;
+    case '-':   p.NextToken = Token::Minus;     break;
+    case '*':   p.NextToken = Token::Times;     break;
+    case '/':   p.NextToken = Token::Divide;    break;
+    case '^':   p.NextToken = Token::Exponent;  break;
+    case '!':   p.NextToken = Token::Factorial; break;
+
+    case '(': case '{': case '[':
+        p.NextToken = Token::LParen;
+        break;
+
+    case ')': case '}': case ']':
+        p.NextToken = Token::RParen;
+        break;
+
+    // nothing else means anything in an expression
+    default:
+        p.NextToken = Token::Invalid;
+        break;
+    }
+
+    ++p.CurrIx;
+}
+
+constexpr bool static_accept(StaticParser& p, Token t)
+{
+    if (p.NextToken != t)
+        return false;
+
+    static_advance(p);
+    return true;
+}
+
+constexpr void static_expect(StaticParser& p, Token t, const char* why)
+{
+    if (!static_accept(p, t))
+        static_expr_error(why);
+}
+
+constexpr int static_new_node(StaticParser& p, NodeKind kind, int a = -1, int b = -1)
+{
+    if (p.Tree.NumNodes == kMaxStaticNodes)
+        static_expr_error("formula too big");
+
+    StaticNode& node = p.Tree.Nodes[p.Tree.NumNodes];
+    node.Kind = kind;
+    node.A = a;
+    node.B = b;
+    return p.Tree.NumNodes++;
+}
+
+constexpr int static_new_const(StaticParser& p, double val)
+{
+    const int ix = static_new_node(p, NodeKind::Const);
+    p.Tree.Nodes[ix].Value = val;
+    return ix;
+}
+
+constexpr double static_expect_number(StaticParser& p)
+{
+    const double val = p.TokenNumber;
+    static_expect(p, Token::Number, "expected number");
+    return val;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the rules are the ones in expr.cpp. it runs in the compiler, so it can recurse the plain way
+// rather than keeping its own stack
+
+constexpr int static_parse_add(StaticParser& p);
+
+constexpr int static_parse_primary(StaticParser& p)
+{
+    if (static_accept(p, Token::LParen))
+    {
+        const int node = static_parse_add(p);
+        static_expect(p, Token::RParen, "expected )");
+        return node;
+    }
+
+    if (static_accept(p, Token::Minus))
+        return static_new_const(p, -static_expect_number(p));
+
+    return static_new_const(p, static_expect_number(p));
+}
+
+constexpr int static_parse_postfix(StaticParser& p)
+{
+    int node = -1;
+    if (p.NextToken == Token::Symbol)
+    {
+        char name[kMaxSymbolLength+1] = {};
+        for (int i = 0; (name[i] = p.TokenSymbol[i]) != 0; ++i)
+        {
+        }
+        static_advance(p);
+
+        if (static_accept(p, Token::LParen))
+        {
+            if (static_str_eq(name, "d"))
+                static_expr_error("d() can't be compiled ahead of time");
+
+            const int arg = static_parse_add(p);
+            static_expect(p, Token::RParen, "expected )");
+
+            constexpr const char* kFuncNames[] =
+            {
+                "sin", "cos", "tan", "sinc",
+                "asin", "acos", "atan",
+                "ln", "log", "sqrt",
+            };
+
+            int funcIx = -1;
+            for (int i = 0; i < int(sizeof(kFuncNames) / sizeof(kFuncNames[0])); ++i)
+            {
+                if (static_str_eq(name, kFuncNames[i]))
+                    funcIx = i;
+            }
+            if (funcIx < 0)
+                static_expr_error("unknown func");
+
+            node = static_new_node(p, NodeKind::Call, arg);
+            p.Tree.Nodes[node].Func = StaticFunc(funcIx);
+        }
+        else if (static_str_eq(name, "x"))
+            node = static_new_node(p, NodeKind::Arg);
+        else if (static_str_eq(name, "pi"))
+            node = static_new_const(p, 3.1415926535897932384626433);
+        else if (static_str_eq(name, "e"))
+            node = static_new_const(p, 2.7182818284590452353602874);
+        else
+            static_expr_error("unknown named val");
+    }
+    else
+    {
+        node = static_parse_primary(p);
+    }
+
+    if (static_accept(p, Token::Factorial))
+        node = static_new_node(p, NodeKind::Fact, node);
+
+    return node;
+}
+
+constexpr int static_parse_exponent(StaticParser& p)
+{
+    const int node = static_parse_postfix(p);
+    if (static_accept(p, Token::Exponent))
+        return static_new_node(p, NodeKind::Pow, node, static_parse_postfix(p));
+    return node;
+}
+
+constexpr int static_parse_unary(StaticParser& p)
+{
+    if (static_accept(p, Token::Plus))
+        return static_parse_unary(p);
+    if (static_accept(p, Token::Minus))
+        return static_new_node(p, NodeKind::Neg, static_parse_unary(p));
+
+    return static_parse_exponent(p);
+}
+
+constexpr int static_parse_mul(StaticParser& p)
+{
+    const bool allowedImplicitMul = (p.NextToken == Token::Number) || (p.NextToken == Token::LParen);
+
+    int node = static_parse_unary(p);
+
+    bool hadInfix = false;
+    while ((p.NextToken == Token::Times) || (p.NextToken == Token::Divide))
+    {
+        hadInfix = true;
+
+        if (static_accept(p, Token::Times))
+            node = static_new_node(p, NodeKind::Mul, node, static_parse_unary(p));
+        else if (static_accept(p, Token::Divide))
+            node = static_new_node(p, NodeKind::Div, node, static_parse_unary(p));
+    }
+
+    if (allowedImplicitMul && !hadInfix)
+    {
+        if ((p.NextToken == Token::Symbol) || (p.NextToken == Token::LParen))
+            node = static_new_node(p, NodeKind::Mul, node, static_parse_mul(p));
+    }
+
+    return node;
+}
+
+constexpr int static_parse_add(StaticParser& p)
+{
+    int node = static_parse_mul(p);
+
+    while ((p.NextToken == Token::Plus) || (p.NextToken == Token::Minus))
+    {
+        if (static_accept(p, Token::Plus))
+            node = static_new_node(p, NodeKind::Add, node, static_parse_mul(p));
+        else if (static_accept(p, Token::Minus))
+            node = static_new_node(p, NodeKind::Sub, node, static_parse_mul(p));
+    }
+
+    return node;
+}
+
+constexpr StaticTree compile_static_expr(const char* def)
+{
+    StaticParser p;
+    p.In = def;
+
+    static_advance(p);
+    p.Tree.Root = static_parse_add(p);
+    if (p.NextToken != Token::Eof)
+        static_expr_error("trailing nonsense");
+
+    return p.Tree;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+template<StaticFunc F>
+inline double call_static_func(double v)
+{
+    // the same functions as the builtins, so the results match
+    if constexpr (F == StaticFunc::Sin)         return std::sin(v);
+    else if constexpr (F == StaticFunc::Cos)    return std::cos(v);
+    else if constexpr (F == StaticFunc::Tan)    return std::tan(v);
+    else if constexpr (F == StaticFunc::Sinc)   return sinc(v);
+    else if constexpr (F == StaticFunc::Asin)   return std::asin(v);
+    else if constexpr (F == StaticFunc::Acos)   return std::acos(v);
+    else if constexpr (F == StaticFunc::Atan)   return std::atan(v);
+    else if constexpr (F == StaticFunc::Ln)     return std::log(v);
+    else if constexpr (F == StaticFunc::Log)    return std::log10(v);
+    else                                        return std::sqrt(v);
+}
+
+// Src::text() gives the formula. each node is its own instantiation, so the whole tree inlines
+// into one function
+template<typename Src>
+struct StaticExpr
+{
+    static constexpr StaticTree kTree = compile_static_expr(Src::text());
+
+    template<int Ix>
+    static double eval(double x)
+    {
+        constexpr const StaticNode& node = kTree.Nodes[Ix];
+
+        if constexpr (node.Kind == NodeKind::Const)     return node.Value;
+        else if constexpr (node.Kind == NodeKind::Arg)  return x;
+        else if constexpr (node.Kind == NodeKind::Call) return call_static_func<node.Func>(eval<node.A>(x));
+        else if constexpr (node.Kind == NodeKind::Neg)  return -eval<node.A>(x);
+        else if constexpr (node.Kind == NodeKind::Add)  return eval<node.A>(x) + eval<node.B>(x);
+        else if constexpr (node.Kind == NodeKind::Sub)  return eval<node.A>(x) - eval<node.B>(x);
+        else if constexpr (node.Kind == NodeKind::Mul)  return eval<node.A>(x) * eval<node.B>(x);
+        else if constexpr (node.Kind == NodeKind::Div)  return eval<node.A>(x) / eval<node.B>(x);
+        else if constexpr (node.Kind == NodeKind::Pow)  return std::pow(eval<node.A>(x), eval<node.B>(x));
+        else
+        {
+            static_assert(node.Kind == NodeKind::Fact, "unexpected node");
+            double val = eval<node.A>(x);
+            return compute_factorial(val) ? val : NAN;
+        }
+    }
+
+    static double call(double x)
+    {
+        return eval<kTree.Root>(x);
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
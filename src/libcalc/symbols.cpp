@@ -1,12 +1,10 @@
 #include "symbols.h"
 
+#include "context.h"
+#include "deps.h"
 #include "parser.h"
 
-#include <cstring>
-
-//-----------------------------------------------------------------------------------------------
-
-constexpr int kMaxUserSymbols = 25;
+#include <vector>
 
 //-----------------------------------------------------------------------------------------------
 
@@ -18,10 +16,7 @@ struct SymbolDef
 
 struct UserSymbol
 {
-    char Name[kMaxSymbolLength+1] = {0};
-    double Value = 0.0;
-
-    bool IsUsed = false;
+    SymId Name = kNoSymId;
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -33,98 +28,146 @@ SymbolDef gSymbols[] =
 };
 constexpr int kNumSymbols = sizeof(gSymbols) / sizeof(gSymbols[0]);
 
-UserSymbol gUserSymbols[kMaxUserSymbols];
+// user symbols are kept packed, with their values in a separate array so evaluation only
+// touches the values
+struct SymbolsState
+{
+    std::vector<UserSymbol> UserSymbols;
+    std::vector<double> UserValues;
+
+    IdIndex CoreSymbolIx;
+    IdIndex UserSymbolIx;
+};
+
+SymbolsState* create_symbols_state()
+{
+    return new SymbolsState;
+}
+
+void destroy_symbols_state(SymbolsState* state)
+{
+    delete state;
+}
+
+static SymbolsState& sym_state()
+{
+    return *calc_context().Symbols;
+}
 
 //-----------------------------------------------------------------------------------------------
 
-const SymbolDef* find_core_symbol(const char* name)
+void init_symbols()
 {
-    for (const SymbolDef& sym : gSymbols)
+    SymbolsState& state = sym_state();
+
+    state.CoreSymbolIx = IdIndex();
+    state.UserSymbolIx = IdIndex();
+    state.UserSymbols.clear();
+    state.UserValues.clear();
+
+    for (int i=0; i<kNumSymbols; ++i)
     {
-        if (strcmp(sym.Name, name) == 0)
-        {
-            return &sym;
-        }
+        const SymId id = intern(gSymbols[i].Name);
+        if (id != kNoSymId)
+            state.CoreSymbolIx.Set(id, i);
     }
-    return nullptr;
 }
 
-bool eval_named_value(const char* name, double& outVal)
+bool eval_named_value(SymId id, double& outVal)
 {
-    if (const SymbolDef* sym = find_core_symbol(name))
+    SymbolsState& state = sym_state();
+
+    const int coreIx = state.CoreSymbolIx.Find(id);
+    if (coreIx >= 0)
     {
-        outVal = sym->Value;
+        outVal = gSymbols[coreIx].Value;
         return true;
     }
 
-    for (const UserSymbol& sym : gUserSymbols)
+    const int userIx = state.UserSymbolIx.Find(id);
+    if (userIx >= 0)
     {
-        if (sym.IsUsed && (strcmp(sym.Name, name) == 0))
-        {
-            outVal = sym.Value;
-            return true;
-        }
+        outVal = state.UserValues[userIx];
+        return true;
     }
 
     outVal = 0.0;
     return false;
 }
 
+bool is_constant(SymId id)
+{
+    return (sym_state().CoreSymbolIx.Find(id) >= 0);
+}
+
 //-----------------------------------------------------------------------------------------------
 
-static UserSymbol* find_or_alloc_usersym(const char* name)
+bool define_value(SymId id, double val, ParseCtx& ctx)
 {
-    UserSymbol* free_sym = nullptr;
+    SymbolsState& state = sym_state();
 
-    for (UserSymbol& sym : gUserSymbols)
+    if (id == kNoSymId)
     {
-        if (!sym.IsUsed)
-        {
-            if (!free_sym)
-                free_sym = &sym;
-            continue;
-        }
-
-        if (strcmp(name, sym.Name) == 0)
-            return &sym;
+        on_parse_error(ctx, "too many names");
+        return false;
     }
 
-    if (free_sym)
+    if (is_constant(id))
     {
-        strcpy(free_sym->Name, name);
-        free_sym->IsUsed = true;
-        return free_sym;
+        on_parse_error(ctx, "can't redefine a constant");
+        return false;
     }
 
-    return nullptr;
-}
+    keep_interned_names();
 
-bool define_value(const char* name, double val, ParseCtx& ctx)
-{
-    if (find_core_symbol(name))
+    const int userIx = state.UserSymbolIx.Find(id);
+    if (userIx >= 0)
     {
-        on_parse_error(ctx, "can't redefine a constant");
-        return false;
+        state.UserValues[userIx] = val;
     }
-
-    UserSymbol* sym = find_or_alloc_usersym(name);
-    if (!sym)
+    else
     {
-        on_parse_error(ctx, "too many user symbols");
-        return false;
+        state.UserSymbolIx.Set(id, int(state.UserSymbols.size()));
+        state.UserSymbols.push_back({ .Name = id });
+        state.UserValues.push_back(val);
     }
 
-    sym->Value = val;
+    // after storing it, since cells downstream are worked out again from the new value
+    definition_changed(id);
     return true;
 }
 
-void undef_value(const char* name)
+void undef_value(SymId id)
 {
-    UserSymbol* sym = find_or_alloc_usersym(name);
-    if (sym)
+    SymbolsState& state = sym_state();
+
+    const int userIx = state.UserSymbolIx.Find(id);
+    if (userIx < 0)
+        return;
+
+    // move the last symbol into the hole
+    const int lastIx = int(state.UserSymbols.size()) - 1;
+    if (userIx != lastIx)
     {
-        sym->IsUsed = false;
+        state.UserSymbols[userIx] = state.UserSymbols[lastIx];
+        state.UserValues[userIx] = state.UserValues[lastIx];
+        state.UserSymbolIx.Set(state.UserSymbols[userIx].Name, userIx);
     }
+
+    state.UserSymbols.pop_back();
+    state.UserValues.pop_back();
+    state.UserSymbolIx.Clear(id);
+
+    definition_changed(id);
+}
+
+void refresh_value(SymId id, double val)
+{
+    SymbolsState& state = sym_state();
+
+    const int userIx = state.UserSymbolIx.Find(id);
+    if (userIx >= 0)
+        state.UserValues[userIx] = val;
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -156,26 +199,23 @@ const char* symbol_name(BuiltinSymbolIt it)
 
 UserSymbolIt symbol_user_begin()
 {
-    UserSymbolIt it = gUserSymbols;
+    SymbolsState& state = sym_state();
 
-    if (!it->IsUsed)
-        it = symbol_next(it);
-
-    return it;
+    return state.UserSymbols.empty() ? nullptr : state.UserSymbols.data();
 }
 
 UserSymbolIt symbol_next(UserSymbolIt it)
 {
+    SymbolsState& state = sym_state();
+
     if (!it)
         return nullptr;
 
-    for (++it; it < gUserSymbols + kMaxUserSymbols; ++it)
-    {
-        if (it->IsUsed)
-            return it;
-    }
+    ++it;
+    if (it >= state.UserSymbols.data() + state.UserSymbols.size())
+        return nullptr;
 
-    return nullptr;
+    return it;
 }
 
 const char* symbol_name(UserSymbolIt it)
@@ -183,15 +223,22 @@ const char* symbol_name(UserSymbolIt it)
     if (!it)
         return "<null>";
 
-    return it->Name;
+    return interned_name(it->Name);
+}
+
+SymId symbol_id(UserSymbolIt it)
+{
+    return it ? it->Name : kNoSymId;
 }
 
 double symbol_val(UserSymbolIt it)
 {
+    SymbolsState& state = sym_state();
+
     if (!it)
         return 1.0 / 0.0;
 
-    return it->Value;
+    return state.UserValues[it - state.UserSymbols.data()];
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -1,15 +1,28 @@
 #pragma once
 
+#include "intern.h"
+
 //-----------------------------------------------------------------------------------------------
 
 struct ParseCtx;
 
 //-----------------------------------------------------------------------------------------------
 
-bool eval_named_value(const char* name, double& outVal);
+struct SymbolsState;
+SymbolsState* create_symbols_state();
+void destroy_symbols_state(SymbolsState* state);
+
+void init_symbols();
+
+bool eval_named_value(SymId id, double& outVal);
+bool is_constant(SymId id);
+
+bool define_value(SymId id, double val, ParseCtx& ctx);
+void undef_value(SymId id);
 
-bool define_value(const char* name, double val, ParseCtx& ctx);
-void undef_value(const char* name);
+// stores the new value of a cell that's being recomputed. unlike define_value it doesn't tell
+// anything downstream, since the recompute is already working through that in order
+void refresh_value(SymId id, double val);
 
 //-----------------------------------------------------------------------------------------------
 
@@ -26,6 +39,7 @@ const char* symbol_name(BuiltinSymbolIt it);
 UserSymbolIt symbol_user_begin();
 UserSymbolIt symbol_next(UserSymbolIt it);
 const char* symbol_name(UserSymbolIt it);
+SymId symbol_id(UserSymbolIt it);
 double symbol_val(UserSymbolIt it);
 
 //-----------------------------------------------------------------------------------------------
@@ -0,0 +1,406 @@
+#include "vmaths.h"
+
+#include "maths.h"
+#include "simd.h"
+
+#include <cmath>
+#include <limits>
+
+//-------------------------------------------------------------------------------------------------
+
+// everything below is written once against a pack type V and instantiated for VecD and VecF.
+// the polynomials are plain taylor series, carried far enough that truncation is well under half
+// an ulp over the reduced ranges; the error budget goes on argument reduction and rounding
+
+template<typename V> struct KernelConsts;
+
+template<> struct KernelConsts<VecD>
+{
+    using Scalar = double;
+
+    static constexpr int SinTerms = 8;
+    static constexpr int CosTerms = 8;
+    static constexpr int AtanTerms = 20;
+    static constexpr int LogTerms = 10;
+
+    // x - n*pi/2 is done in parts; all but the last have short enough mantissas that n*part is
+    // exact for |n| < 2^21
+    static constexpr double TrigLimit = 0x1p20;
+    static constexpr double TwoOverPi = 0x1.45f306dc9c883p-1;
+    static constexpr double PiO2_1 = 0x1.921fb544p+0;
+    static constexpr double PiO2_2 = 0x1.0b4611a6p-34;
+    static constexpr double PiO2_3 = 0x1.3198a2e037073p-69;
+    static constexpr double PiO2_4 = 0.0;
+
+    static constexpr double PiO2Hi = 0x1.921fb54442d18p+0;
+    static constexpr double PiO2Lo = 0x1.1a62633145c07p-54;
+    static constexpr double PiO4Hi = 0x1.921fb54442d18p-1;
+    static constexpr double PiO4Lo = 0x1.1a62633145c07p-55;
+    static constexpr double Tan3PiO8 = 0x1.3504f333f9de6p+1;
+    static constexpr double TanPiO8 = 0x1.a827999fcef32p-2;
+
+    static constexpr double Sqrt2 = 0x1.6a09e667f3bcdp+0;
+    static constexpr double Ln2Hi = 0x1.62e42feep-1;
+    static constexpr double Ln2Lo = 0x1.a39ef35793c76p-33;
+    static constexpr double Log10_2Hi = 0x1.34413508p-2;
+    static constexpr double Log10_2Lo = 0x1.f79fef311f12bp-34;
+    static constexpr double InvLn10 = 0x1.bcb7b1526e50ep-2;
+
+    static constexpr double MinNormal = 0x1p-1022;
+    static constexpr double DenormScale = 0x1p54;
+    static constexpr double DenormExp = 54;
+};
+
+template<> struct KernelConsts<VecF>
+{
+    using Scalar = float;
+
+    static constexpr int SinTerms = 4;
+    static constexpr int CosTerms = 4;
+    static constexpr int AtanTerms = 9;
+    static constexpr int LogTerms = 4;
+
+    // floats need a fourth part to get the results near multiples of pi right. n*part is exact
+    // much further out, but the last part runs out of bits past a few hundred
+    static constexpr float TrigLimit = 512.0f;
+    static constexpr float TwoOverPi = 0x1.45f306p-1f;
+    static constexpr float PiO2_1 = 0x1.92p+0f;
+    static constexpr float PiO2_2 = 0x1.fb4p-12f;
+    static constexpr float PiO2_3 = 0x1.444p-24f;
+    static constexpr float PiO2_4 = 0x1.68c234p-39f;
+
+    static constexpr float PiO2Hi = 0x1.921fb6p+0f;
+    static constexpr float PiO2Lo = -0x1.777a5cp-25f;
+    static constexpr float PiO4Hi = 0x1.921fb6p-1f;
+    static constexpr float PiO4Lo = -0x1.777a5cp-26f;
+    static constexpr float Tan3PiO8 = 0x1.3504f4p+1f;
+    static constexpr float TanPiO8 = 0x1.a8279ap-2f;
+
+    static constexpr float Sqrt2 = 0x1.6a09e6p+0f;
+    static constexpr float Ln2Hi = 0x1.62ep-1f;
+    static constexpr float Ln2Lo = 0x1.0bfbe8p-15f;
+    static constexpr float Log10_2Hi = 0x1.344p-2f;
+    static constexpr float Log10_2Lo = 0x1.3509f8p-18f;
+    static constexpr float InvLn10 = 0x1.bcb7b2p-2f;
+
+    static constexpr float MinNormal = 0x1p-126f;
+    static constexpr float DenormScale = 0x1p25f;
+    static constexpr float DenormExp = 25;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+template<typename S, int N>
+struct Coeffs
+{
+    S C[N];
+};
+
+// sin(r) = r + r*z*P(z), z = r^2
+template<typename S, int N>
+constexpr Coeffs<S, N> sin_coeffs()
+{
+    Coeffs<S, N> c {};
+    double fact = 1.0;
+    for (int i = 0; i < N; ++i)
+    {
+        fact *= (2*i + 2) * (2*i + 3);
+        c.C[i] = S(((i & 1) ? 1.0 : -1.0) / fact);
+    }
+    return c;
+}
+
+// cos(r) = 1 - z/2 + z*z*Q(z)
+template<typename S, int N>
+constexpr Coeffs<S, N> cos_coeffs()
+{
+    Coeffs<S, N> c {};
+    double fact = 2.0;
+    for (int i = 0; i < N; ++i)
+    {
+        fact *= (2*i + 3) * (2*i + 4);
+        c.C[i] = S(((i & 1) ? -1.0 : 1.0) / fact);
+    }
+    return c;
+}
+
+// atan(t) = t + t*z*A(z)
+template<typename S, int N>
+constexpr Coeffs<S, N> atan_coeffs()
+{
+    Coeffs<S, N> c {};
+    for (int i = 0; i < N; ++i)
+        c.C[i] = S(((i & 1) ? 1.0 : -1.0) / (2*i + 3));
+    return c;
+}
+
+// log(1+f) = f - hfsq + s*(hfsq + z*L(z)), with s = f/(2+f), z = s^2 and hfsq = f^2/2
+template<typename S, int N>
+constexpr Coeffs<S, N> log_coeffs()
+{
+    Coeffs<S, N> c {};
+    for (int i = 0; i < N; ++i)
+        c.C[i] = S(2.0 / (2*i + 3));
+    return c;
+}
+
+template<typename V, typename S, int N>
+inline V poly(V z, const Coeffs<S, N>& c)
+{
+    V p = vec_set1(c.C[N-1]);
+    for (int i = N-2; i >= 0; --i)
+        p = p * z + vec_set1(c.C[i]);
+    return p;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+template<typename V>
+struct Kernels
+{
+    using K = KernelConsts<V>;
+    using S = typename K::Scalar;
+
+    static constexpr Coeffs<S, K::SinTerms> SinC = sin_coeffs<S, K::SinTerms>();
+    static constexpr Coeffs<S, K::CosTerms> CosC = cos_coeffs<S, K::CosTerms>();
+    static constexpr Coeffs<S, K::AtanTerms> AtanC = atan_coeffs<S, K::AtanTerms>();
+    static constexpr Coeffs<S, K::LogTerms> LogC = log_coeffs<S, K::LogTerms>();
+
+    static V set(S s) { return vec_set1(s); }
+
+    static V copysign(V mag, V sign)
+    {
+        return vec_or(vec_abs(mag), vec_and(sign, set(S(-0.0))));
+    }
+
+    // r = x - q*pi/2 with q the nearest integer, and quadrant = q mod 4
+    static V reduce(V x, V& quadrant, V& useLibm)
+    {
+        const V all = vec_eq(set(S(0)), set(S(0)));
+        useLibm = vec_andnot(vec_le(vec_abs(x), set(K::TrigLimit)), all);
+
+        const V q = vec_round(x * set(K::TwoOverPi));
+        quadrant = q - set(S(4)) * vec_round(q * set(S(0.25)) - set(S(0.375)));
+
+        // the middle steps keep their rounding errors, so r is only rounded once at the end
+        const V a = x - q * set(K::PiO2_1);
+        const V b = q * set(K::PiO2_2);
+        const V c = q * set(K::PiO2_3);
+        const V hi = a - b;
+        const V lo = (a - hi) - b;
+        const V hi2 = hi - c;
+        const V lo2 = (hi - hi2) - c;
+        const V r = hi2 + ((lo + lo2) - q * set(K::PiO2_4));
+
+        // keeps the sign of -0
+        return vec_select(vec_eq(q, set(S(0))), x, r);
+    }
+
+    static V sin_poly(V r)
+    {
+        // r*z*P is +0 for r = -0, which would lose the sign
+        const V z = r * r;
+        return vec_select(vec_eq(r, set(S(0))), r, r + r * z * poly(z, SinC));
+    }
+
+    static V cos_poly(V r)
+    {
+        const V z = r * r;
+        return (set(S(1)) - z * set(S(0.5))) + z * z * poly(z, CosC);
+    }
+
+    static V sin(V x, V& useLibm)
+    {
+        V quadrant;
+        const V r = reduce(x, quadrant, useLibm);
+
+        const V odd = vec_or(vec_eq(quadrant, set(S(1))), vec_eq(quadrant, set(S(3))));
+        const V y = vec_select(odd, cos_poly(r), sin_poly(r));
+        return vec_select(vec_ge(quadrant, set(S(2))), -y, y);
+    }
+
+    static V cos(V x, V& useLibm)
+    {
+        V quadrant;
+        const V r = reduce(x, quadrant, useLibm);
+
+        const V odd = vec_or(vec_eq(quadrant, set(S(1))), vec_eq(quadrant, set(S(3))));
+        const V neg = vec_or(vec_eq(quadrant, set(S(1))), vec_eq(quadrant, set(S(2))));
+        const V y = vec_select(odd, sin_poly(r), cos_poly(r));
+        return vec_select(neg, -y, y);
+    }
+
+    static V tan(V x, V& useLibm)
+    {
+        V quadrant;
+        const V r = reduce(x, quadrant, useLibm);
+
+        const V odd = vec_or(vec_eq(quadrant, set(S(1))), vec_eq(quadrant, set(S(3))));
+        const V s = sin_poly(r);
+        const V c = cos_poly(r);
+        return vec_select(odd, -c / s, s / c);
+    }
+
+    // matches maths.cpp's sinc, which gives 1 wherever sin(x)/x is nan but x isn't
+    static V sinc(V x, V& useLibm)
+    {
+        const V y = sin(x, useLibm) / x;
+        return vec_select(vec_and(vec_eq(x, x), vec_neq(y, y)), set(S(1)), y);
+    }
+
+    static V atan(V x, V&)
+    {
+        const V a = vec_abs(x);
+        const V big = vec_gt(a, set(K::Tan3PiO8));
+        const V mid = vec_andnot(big, vec_gt(a, set(K::TanPiO8)));
+
+        const V one = set(S(1));
+        const V t = vec_select(big, -one / a, vec_select(mid, (a - one) / (a + one), a));
+        const V baseHi = vec_select(big, set(K::PiO2Hi), vec_and(mid, set(K::PiO4Hi)));
+        const V baseLo = vec_select(big, set(K::PiO2Lo), vec_and(mid, set(K::PiO4Lo)));
+
+        const V z = t * t;
+        const V y = baseHi + (t + (baseLo + t * z * poly(z, AtanC)));
+        return copysign(y, x);
+    }
+
+    static V asin(V x, V& useLibm)
+    {
+        const V one = set(S(1));
+        return atan(x / vec_sqrt((one - x) * (one + x)), useLibm);
+    }
+
+    static V acos(V x, V& useLibm)
+    {
+        const V one = set(S(1));
+        return set(S(2)) * atan(vec_sqrt((one - x) / (one + x)), useLibm);
+    }
+
+    // splits x into 2^e * (1+f), with 1+f in [sqrt(2)/2, sqrt(2)), and returns log(1+f)
+    static V log_reduced(V x, V& e)
+    {
+        const V tiny = vec_lt(x, set(K::MinNormal));
+        V m = vec_split_exp(vec_select(tiny, x * set(K::DenormScale), x), e);
+        e = e - vec_and(tiny, set(K::DenormExp));
+
+        const V big = vec_gt(m, set(K::Sqrt2));
+        m = vec_select(big, m * set(S(0.5)), m);
+        e = e + vec_and(big, set(S(1)));
+
+        const V f = m - set(S(1));
+        const V s = f / (set(S(2)) + f);
+        const V z = s * s;
+        const V hfsq = set(S(0.5)) * f * f;
+        return f - (hfsq - s * (hfsq + z * poly(z, LogC)));
+    }
+
+    static V log_special_cases(V x, V y)
+    {
+        const S inf = std::numeric_limits<S>::infinity();
+        const S nan = std::numeric_limits<S>::quiet_NaN();
+
+        y = vec_select(vec_eq(x, set(S(0))), set(-inf), y);
+        y = vec_select(vec_lt(x, set(S(0))), set(nan), y);
+        y = vec_select(vec_eq(x, set(inf)), x, y);
+        return vec_select(vec_neq(x, x), x, y);
+    }
+
+    static V ln(V x, V&)
+    {
+        V e;
+        const V lm = log_reduced(x, e);
+        const V y = e * set(K::Ln2Hi) + (lm + e * set(K::Ln2Lo));
+        return log_special_cases(x, y);
+    }
+
+    static V log10(V x, V&)
+    {
+        V e;
+        const V lm = log_reduced(x, e);
+        const V y = e * set(K::Log10_2Hi) + (lm * set(K::InvLn10) + e * set(K::Log10_2Lo));
+        return log_special_cases(x, y);
+    }
+
+    static V sqrt(V x, V&)
+    {
+        return vec_sqrt(x);
+    }
+};
+
+//-------------------------------------------------------------------------------------------------
+
+// runs a kernel over an array a pack at a time. any lanes the kernel flags are recomputed with libm
+template<typename V, typename S, V (*Kernel)(V, V&), S (*LibmFn)(S)>
+static void run_kernel(const S* in, S* out, int count)
+{
+    constexpr int W = V::Width;
+
+    S xs[W];
+    S ys[W];
+
+    for (int i = 0; i < count; i += W)
+    {
+        const int num = (count - i < W) ? (count - i) : W;
+
+        V x;
+        if (num == W)
+        {
+            x = vec_load(in + i);
+        }
+        else
+        {
+            for (int j = 0; j < W; ++j)
+                xs[j] = in[i + (j < num ? j : 0)];
+            x = vec_load(xs);
+        }
+
+        V useLibm = vec_set1(S(0));
+        const V y = Kernel(x, useLibm);
+        const int libmLanes = vec_movemask(useLibm);
+
+        if (num == W && !libmLanes)
+        {
+            vec_store(out + i, y);
+            continue;
+        }
+
+        vec_store(xs, x);
+        vec_store(ys, y);
+        for (int j = 0; j < num; ++j)
+            out[i + j] = (libmLanes & (1 << j)) ? LibmFn(xs[j]) : ys[j];
+    }
+}
+
+static float sincf(float v)
+{
+    return float(sinc(v));
+}
+
+//-------------------------------------------------------------------------------------------------
+
+using KD = Kernels<VecD>;
+using KF = Kernels<VecF>;
+
+void vsin(const double* in, double* out, int count)     { run_kernel<VecD, double, KD::sin, ::sin>(in, out, count); }
+void vcos(const double* in, double* out, int count)     { run_kernel<VecD, double, KD::cos, ::cos>(in, out, count); }
+void vtan(const double* in, double* out, int count)     { run_kernel<VecD, double, KD::tan, ::tan>(in, out, count); }
+void vsinc(const double* in, double* out, int count)    { run_kernel<VecD, double, KD::sinc, ::sinc>(in, out, count); }
+void vasin(const double* in, double* out, int count)    { run_kernel<VecD, double, KD::asin, ::asin>(in, out, count); }
+void vacos(const double* in, double* out, int count)    { run_kernel<VecD, double, KD::acos, ::acos>(in, out, count); }
+void vatan(const double* in, double* out, int count)    { run_kernel<VecD, double, KD::atan, ::atan>(in, out, count); }
+void vln(const double* in, double* out, int count)      { run_kernel<VecD, double, KD::ln, ::log>(in, out, count); }
+void vlog10(const double* in, double* out, int count)   { run_kernel<VecD, double, KD::log10, ::log10>(in, out, count); }
+void vsqrt(const double* in, double* out, int count)    { run_kernel<VecD, double, KD::sqrt, ::sqrt>(in, out, count); }
+
+void vsinf(const float* in, float* out, int count)      { run_kernel<VecF, float, KF::sin, ::sinf>(in, out, count); }
+void vcosf(const float* in, float* out, int count)      { run_kernel<VecF, float, KF::cos, ::cosf>(in, out, count); }
+void vtanf(const float* in, float* out, int count)      { run_kernel<VecF, float, KF::tan, ::tanf>(in, out, count); }
+void vsincf(const float* in, float* out, int count)     { run_kernel<VecF, float, KF::sinc, sincf>(in, out, count); }
+void vasinf(const float* in, float* out, int count)     { run_kernel<VecF, float, KF::asin, ::asinf>(in, out, count); }
+void vacosf(const float* in, float* out, int count)     { run_kernel<VecF, float, KF::acos, ::acosf>(in, out, count); }
+void vatanf(const float* in, float* out, int count)     { run_kernel<VecF, float, KF::atan, ::atanf>(in, out, count); }
+void vlnf(const float* in, float* out, int count)       { run_kernel<VecF, float, KF::ln, ::logf>(in, out, count); }
+void vlog10f(const float* in, float* out, int count)    { run_kernel<VecF, float, KF::log10, ::log10f>(in, out, count); }
+void vsqrtf(const float* in, float* out, int count)     { run_kernel<VecF, float, KF::sqrt, ::sqrtf>(in, out, count); }
+
+//-------------------------------------------------------------------------------------------------
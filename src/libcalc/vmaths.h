@@ -0,0 +1,52 @@
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+
+// array versions of the builtin maths functions: out[i] = f(in[i]) for i in [0,count)
+// they work a SIMD pack at a time (see simd.h), and in and out may be the same array
+//
+// max error against the exact result, measured over dense sweeps of each domain:
+//
+//            double      float
+//   sin       1.6 ulp   1.6 ulp     |x| > 2^20 (floats: 512) is handed to libm
+//   cos       1.6 ulp   1.6 ulp       "
+//   tan       3.7 ulp   3.7 ulp       "
+//   sinc      2.5 ulp   2.5 ulp       "
+//   asin        3 ulp     3 ulp
+//   acos      2.5 ulp   2.5 ulp
+//   atan        2 ulp     2 ulp
+//   ln        1.5 ulp     1 ulp
+//   log         2 ulp     2 ulp     (log10)
+//   sqrt      0.5 ulp   0.5 ulp     (correctly rounded)
+//
+// infs, nans and out-of-domain inputs give the same results as libm. tools/test/vmaths_test.cpp
+// checks all of this
+
+typedef void (*CalcDoubleVecFn)(const double* in, double* out, int count);
+typedef void (*CalcFloatVecFn)(const float* in, float* out, int count);
+
+//-------------------------------------------------------------------------------------------------
+
+void vsin(const double* in, double* out, int count);
+void vcos(const double* in, double* out, int count);
+void vtan(const double* in, double* out, int count);
+void vsinc(const double* in, double* out, int count);
+void vasin(const double* in, double* out, int count);
+void vacos(const double* in, double* out, int count);
+void vatan(const double* in, double* out, int count);
+void vln(const double* in, double* out, int count);
+void vlog10(const double* in, double* out, int count);
+void vsqrt(const double* in, double* out, int count);
+
+void vsinf(const float* in, float* out, int count);
+void vcosf(const float* in, float* out, int count);
+void vtanf(const float* in, float* out, int count);
+void vsincf(const float* in, float* out, int count);
+void vasinf(const float* in, float* out, int count);
+void vacosf(const float* in, float* out, int count);
+void vatanf(const float* in, float* out, int count);
+void vlnf(const float* in, float* out, int count);
+void vlog10f(const float* in, float* out, int count);
+void vsqrtf(const float* in, float* out, int count);
+
+//-------------------------------------------------------------------------------------------------
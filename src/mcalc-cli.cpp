@@ -0,0 +1,248 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "libcalc/libcalc.h"
+
+//-------------------------------------------------------------------------------------------------
+// headless calc: evaluates lines from files or stdin, one after another, and writes what the calc
+// has to say to stdout. it's for piping lots of expressions through, so nothing is echoed and
+// output only goes out when the buffer fills
+//
+
+constexpr int kMaxLineLen = 4096;
+
+static const char kUsage[] =
+    "usage: mcalc-cli [--stats] [file ...]\n"
+    "  evaluates each line of the files, or of stdin if there are none or the file is -\n"
+    "  --stats   writes how many lines per second were evaluated to stderr at the end\n"
+    "  exits with 1 if any line has an error\n";
+
+//-------------------------------------------------------------------------------------------------
+// buffered writer
+//
+
+char gOutBuf[64 * 1024];
+int gOutLen = 0;
+
+void flush_out()
+{
+    if (gOutLen > 0)
+        fwrite(gOutBuf, 1, gOutLen, stdout);
+    gOutLen = 0;
+}
+
+void out_write(const char* s, int len)
+{
+    if (gOutLen + len > int(sizeof(gOutBuf)))
+    {
+        flush_out();
+
+        // too big to be worth buffering
+        if (len > int(sizeof(gOutBuf)))
+        {
+            fwrite(s, 1, len, stdout);
+            return;
+        }
+    }
+
+    memcpy(gOutBuf + gOutLen, s, len);
+    gOutLen += len;
+}
+
+void out_puts(const char* s)
+{
+    if (s)
+        out_write(s, int(strlen(s)));
+}
+
+void calc_output(const char* s, void*)
+{
+    out_puts(s);
+}
+
+//-------------------------------------------------------------------------------------------------
+// line reader
+//
+// reads a file in big blocks and hands out the lines in it, without the line endings. a line
+// that doesn't fit in the block is read up to kMaxLineLen and the rest of it skipped
+//
+
+struct LineReader
+{
+    FILE* File = nullptr;
+    char Buf[64 * 1024];
+    int Start = 0;
+    int End = 0;
+    bool Eof = false;
+};
+
+LineReader gReader;
+
+// returns false at the end of the file. tooLong is set if the line was cut short
+bool read_line(LineReader& rdr, char* line, bool& tooLong)
+{
+    tooLong = false;
+    int lineLen = 0;
+    for (;;)
+    {
+        const char* start = rdr.Buf + rdr.Start;
+        const char* nl = (const char*)memchr(start, '\n', rdr.End - rdr.Start);
+        const int len = nl ? int(nl - start) : (rdr.End - rdr.Start);
+
+        const int keep = (lineLen + len < kMaxLineLen) ? len : (kMaxLineLen - lineLen);
+        if (keep < len)
+            tooLong = true;
+        memcpy(line + lineLen, start, keep);
+        lineLen += keep;
+
+        if (nl)
+        {
+            rdr.Start += len + 1;
+            break;
+        }
+
+        rdr.Start = rdr.End = 0;
+        if (!rdr.Eof)
+        {
+            rdr.End = int(fread(rdr.Buf, 1, sizeof(rdr.Buf), rdr.File));
+            rdr.Eof = (rdr.End == 0);
+        }
+
+        if (rdr.Eof)
+        {
+            // the last line doesn't need a newline
+            if ((lineLen == 0) && !tooLong)
+                return false;
+            break;
+        }
+    }
+
+    if ((lineLen > 0) && (line[lineLen-1] == '\r'))
+        --lineLen;
+    line[lineLen] = 0;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+uint64_t gNumLines = 0;
+uint64_t gNumBytes = 0;
+bool gAnyErrors = false;
+
+CalcContext* gCalc = nullptr;
+
+void eval_file(FILE* file)
+{
+    gReader.File = file;
+    gReader.Start = gReader.End = 0;
+    gReader.Eof = false;
+
+    static char line[kMaxLineLen+1];
+    char resBuf[1024];
+    bool tooLong;
+    while (read_line(gReader, line, tooLong))
+    {
+        ++gNumLines;
+        if (tooLong)
+        {
+            out_puts("line too long\n");
+            gAnyErrors = true;
+            continue;
+        }
+
+        const int len = int(strlen(line));
+        gNumBytes += len;
+        if (len == 0)
+            continue;
+
+        if (!calc_eval(gCalc, line, resBuf, sizeof(resBuf)))
+            gAnyErrors = true;
+
+        // errors come with their own newline
+        const int resLen = int(strlen(resBuf));
+        if (resLen > 0)
+        {
+            out_write(resBuf, resLen);
+            if (resBuf[resLen-1] != '\n')
+                out_write("\n", 1);
+        }
+
+        // there's nowhere to show them
+        if (get_plot(gCalc))
+            reset_plot(gCalc);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bool showStats = false;
+    int numFiles = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            showStats = true;
+        }
+        else if ((argv[i][0] == '-') && argv[i][1])
+        {
+            fputs(kUsage, stderr);
+            return 2;
+        }
+        else
+        {
+            ++numFiles;
+        }
+    }
+
+    gCalc = calc_create(calc_output, nullptr);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (numFiles == 0)
+        eval_file(stdin);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* path = argv[i];
+        if (strcmp(path, "--stats") == 0)
+            continue;
+
+        if (strcmp(path, "-") == 0)
+        {
+            eval_file(stdin);
+            continue;
+        }
+
+        FILE* file = fopen(path, "rb");
+        if (!file)
+        {
+            flush_out();
+            fprintf(stderr, "can't open %s\n", path);
+            gAnyErrors = true;
+            continue;
+        }
+
+        eval_file(file);
+        fclose(file);
+    }
+
+    flush_out();
+    fflush(stdout);
+
+    calc_destroy(gCalc);
+
+    if (showStats)
+    {
+        const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%llu lines, %llu bytes in %.3fs: %.0f lines/sec, %.1f MB/sec\n",
+            (unsigned long long)gNumLines, (unsigned long long)gNumBytes, secs,
+            (secs > 0.0) ? gNumLines / secs : 0.0,
+            (secs > 0.0) ? gNumBytes / secs / 1.0e6 : 0.0);
+    }
+
+    return gAnyErrors ? 1 : 0;
+}
@@ -254,6 +254,14 @@ void display_puts(const char* s)
 }
 
 
+void calc_output(const char* s, void*)
+{
+    display_puts(s);
+}
+
+
+CalcContext* gCalc = nullptr;
+
 char gReadBuf[256] = {0};
 constexpr int kReadBufSize = sizeof(gReadBuf) / sizeof(gReadBuf[0]);
 int gReadBufIx = 0;
@@ -299,13 +307,13 @@ bool handleInputChar(char c)
 void eval_input()
 {
     char resBuf[1024];
-    calc_eval(gReadBuf, resBuf, sizeof(resBuf));
+    calc_eval(gCalc, gReadBuf, resBuf, sizeof(resBuf));
     display_puts(resBuf);
 
-    if (const Plot* plot = get_plot())
+    if (const Plot* plot = get_plot(gCalc))
     {
         lcd_put_image(plot->Pixels, MC_PLOT_WIDTH, MC_PLOT_HEIGHT);
-        reset_plot();
+        reset_plot(gCalc);
     }
 
     display_puts("\n>");
@@ -441,10 +449,10 @@ int main()
 
     SDL_FillRect(gBackBuffer, NULL, 0);
 
-    calc_init(display_puts);
-    register_calc_cmd(cmd_big, "big", "", "switches to big text");
-    register_calc_cmd(cmd_small, "small", "", "switches to small text");
-    register_calc_cmd(cmd_bye, "bye", "", "closes the calc");
+    gCalc = calc_create(calc_output, nullptr);
+    register_calc_cmd(gCalc, cmd_big, "big", "", "switches to big text");
+    register_calc_cmd(gCalc, cmd_small, "small", "", "switches to small text");
+    register_calc_cmd(gCalc, cmd_bye, "bye", "", "closes the calc");
 
     display_puts(MCALC_WELCOME);
     display_puts(">");
@@ -483,6 +491,8 @@ int main()
 
     SDL_RemoveTimer(cursorTimer);
 
+    calc_destroy(gCalc);
+
     cleanup_lcd();
     SDL_FreeSurface(gBackBuffer);
     SDL_DestroyWindow(gWindow);
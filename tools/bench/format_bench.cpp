@@ -0,0 +1,115 @@
+// times the number formatting against snprintf, for shortest digits and a few fixed numbers of
+// digits, on random doubles and on the short numbers a calculator mostly shows
+
+#include "libcalc/context.h"
+#include "libcalc/format.h"
+#include "libcalc/libcalc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+static const int kCount = 4096;
+static const int kRepeats = 50;
+
+static volatile char s_sink;
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, so the numbers are the same every run
+static uint64_t next_random()
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// best of a few runs, in ns per number
+template<typename F>
+static double time_ns(F&& run)
+{
+    double best = HUGE_VAL;
+    for (int attempt = 0; attempt < 5; ++attempt)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRepeats; ++i)
+            run();
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / (double(kCount) * kRepeats));
+    }
+    return best;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void run_benches()
+{
+    std::vector<double> random(kCount), short_(kCount);
+    for (int i = 0; i < kCount; ++i)
+    {
+        const uint64_t bits = next_random() & 0x7fefffffffffffffull;
+        memcpy(&random[i], &bits, sizeof(double));
+
+        // a few digits, like sums of prices or 1/8
+        short_[i] = double(next_random() % 100000) / ((i & 1) ? 100.0 : 8.0);
+    }
+
+    const struct { const char* Name; const std::vector<double>& Vals; } sets[] =
+        { { "random", random }, { "short", short_ } };
+
+    printf("%-16s %10s %10s %8s\n", "", "format", "snprintf", "");
+    for (const auto& set : sets)
+    {
+        char buf[40];
+
+        // snprintf needs 17 digits to be sure of reading back
+        const double ours = time_ns([&] {
+            for (double val : set.Vals)
+                dtostr_shortest(val, buf, sizeof(buf));
+            s_sink = buf[0];
+        });
+        const double theirs = time_ns([&] {
+            for (double val : set.Vals)
+                snprintf(buf, sizeof(buf), "%.17g", val);
+            s_sink = buf[0];
+        });
+        printf("%-6s shortest  %7.2f ns %7.2f ns %7.1fx\n", set.Name, ours, theirs, theirs / ours);
+
+        for (int digits : { 8, 15, 17 })
+        {
+            set_format_digits(digits);
+            const double oursDigits = time_ns([&] {
+                for (double val : set.Vals)
+                    dtostr_human(val, buf, sizeof(buf));
+                s_sink = buf[0];
+            });
+            const double theirsDigits = time_ns([&] {
+                for (double val : set.Vals)
+                    snprintf(buf, sizeof(buf), "%.*g", digits, val);
+                s_sink = buf[0];
+            });
+            printf("%-6s %2d digits %7.2f ns %7.2f ns %7.1fx\n", set.Name, digits, oursDigits,
+                theirsDigits, theirsDigits / oursDigits);
+        }
+    }
+}
+
+int main()
+{
+    // the number of digits is kept in the context
+    CalcContext* calc = calc_create(nullptr, nullptr);
+    {
+        ContextScope scope(calc);
+        run_benches();
+    }
+    calc_destroy(calc);
+    return 0;
+}
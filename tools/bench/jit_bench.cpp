@@ -0,0 +1,125 @@
+// times the interpreter against compiled code on some typical definitions of f(x)
+
+#include "libcalc/bytecode.h"
+#include "libcalc/context.h"
+#include "libcalc/expr.h"
+#include "libcalc/intern.h"
+#include "libcalc/jit.h"
+#include "libcalc/libcalc.h"
+#include "libcalc/parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+//-------------------------------------------------------------------------------------------------
+#if MLN_JIT_X64
+
+static const char* const kDefs[] =
+{
+    "sin(x^2)/x",
+    "x^3 - 2x^2 + 3x - 4",
+    "((((x - 1)x + 2)x - 3)x + 4)x - 5",
+    "e^(-x^2/2)/sqrt(2pi)",
+    "ln(1 + x^2)/(1 + x^2) + atan(x)",
+};
+
+static const int kCount = 200000;
+
+static volatile double s_sink;
+
+// best of a few runs, in ns per call
+template<typename F>
+static double time_ns(F&& run)
+{
+    double best = HUGE_VAL;
+    for (int attempt = 0; attempt < 5; ++attempt)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / kCount);
+    }
+    return best;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static bool run_benches()
+{
+    const SymId x = intern("x");
+    bool ok = true;
+
+    printf("%-36s %10s %10s %8s\n", "", "interp", "jit", "");
+    for (const char* def : kDefs)
+    {
+        char errBuf[64] = {0};
+        ParseCtx ctx { .InBuffer = def, .ResBuffer = errBuf, .ResBufferLen = sizeof(errBuf) };
+        Program prog;
+        advance_token(ctx);
+        if (!compile_expression(ctx, prog, x))
+        {
+            printf("%-36s %s\n", def, errBuf);
+            ok = false;
+            continue;
+        }
+
+        const JitFn fn = jit_compile(prog);
+        if (!fn)
+        {
+            printf("%-36s can't be compiled\n", def);
+            continue;
+        }
+
+        double interpSum = 0.0;
+        const double interp = time_ns([&] {
+            interpSum = 0.0;
+            for (int i = 0; i < kCount; ++i)
+            {
+                double val = 0.0;
+                run_program(prog, 0.5 + i * (1.0 / kCount), val, ctx);
+                interpSum += val;
+            }
+            s_sink = interpSum;
+        });
+
+        double jitSum = 0.0;
+        const double jit = time_ns([&] {
+            jitSum = 0.0;
+            for (int i = 0; i < kCount; ++i)
+                jitSum += fn(0.5 + i * (1.0 / kCount), &ctx);
+            s_sink = jitSum;
+        });
+
+        jit_free(fn);
+
+        // they're meant to give identical results, so the sums are too
+        printf("%-36s %7.2f ns %7.2f ns %7.1fx%s\n", def, interp, jit, interp / jit,
+            (interpSum == jitSum) ? "" : "  MISMATCH");
+        ok = ok && (interpSum == jitSum);
+    }
+
+    return ok;
+}
+
+#endif  // MLN_JIT_X64
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+#if MLN_JIT_X64
+    CalcContext* calc = calc_create(nullptr, nullptr);
+    bool ok;
+    {
+        ContextScope scope(calc);
+        ok = run_benches();
+    }
+    calc_destroy(calc);
+    return ok ? 0 : 1;
+#else
+    printf("no jit on this platform\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,112 @@
+// times read_number against strtod on a few kinds of number
+
+#include "libcalc/numparse.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+static const int kCount = 4096;
+static const int kRepeats = 200;
+
+static volatile double s_sink;
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, so the numbers are the same every run
+static uint64_t next_random()
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static double random_double()
+{
+    const uint64_t bits = next_random() & 0x7fefffffffffffffull;
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+// best of a few runs, in ns per number
+template<typename F>
+static double time_ns(F&& run)
+{
+    double best = HUGE_VAL;
+    for (int attempt = 0; attempt < 5; ++attempt)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRepeats; ++i)
+            run();
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / (double(kCount) * kRepeats));
+    }
+    return best;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+    struct Case
+    {
+        const char* Name;
+        std::vector<std::string> Strs;
+    };
+
+    Case cases[] = { { "integers", {} }, { "short", {} }, { "17 digits", {} }, { "30 digits", {} } };
+
+    char buf[64];
+    for (int i = 0; i < kCount; ++i)
+    {
+        snprintf(buf, sizeof(buf), "%d", int(next_random() % 1000000));
+        cases[0].Strs.push_back(buf);
+
+        snprintf(buf, sizeof(buf), "%.6g", double(next_random() >> 11) * 0x1p-40);
+        cases[1].Strs.push_back(buf);
+
+        snprintf(buf, sizeof(buf), "%.17g", random_double());
+        cases[2].Strs.push_back(buf);
+
+        std::string digits = "0.";
+        for (int d = 0; d < 30; ++d)
+            digits += char('0' + next_random() % 10);
+        cases[3].Strs.push_back(digits);
+    }
+
+    printf("%-10s %10s %10s %8s\n", "", "numparse", "strtod", "");
+    for (const Case& c : cases)
+    {
+        const double ours = time_ns([&] {
+            double sum = 0.0;
+            for (const std::string& str : c.Strs)
+            {
+                double val;
+                bool outOfRange;
+                read_number(str.c_str(), val, outOfRange);
+                sum += val;
+            }
+            s_sink = sum;
+        });
+        const double theirs = time_ns([&] {
+            double sum = 0.0;
+            for (const std::string& str : c.Strs)
+                sum += strtod(str.c_str(), nullptr);
+            s_sink = sum;
+        });
+
+        printf("%-10s %7.2f ns %7.2f ns %7.1fx\n", c.Name, ours, theirs, theirs / ours);
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+// times whole lines through calc_eval: a fixed script of definitions, commands, expressions,
+// cells and mistakes, each kind on its own and then all mixed together as a session would be
+
+#include "libcalc/libcalc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+static const int kRepeats = 200;
+
+struct Corpus
+{
+    const char* Name;
+    std::vector<const char*> Lines;
+    bool Fails;     // every line should give an error
+};
+
+static const Corpus kCorpora[] =
+{
+    { "definitions", {
+        "a = 2", "b = a^2 + 1", "theta = 2pi/3", "f(x) = x^3 - 2x + a", "g[x] = sin(x)*e^(-x/4)",
+        "h(x) -> f(x) + g(x)/b", "k(x) = h(x/2) + f(x)^2", "fp = deriv f", "s(x) = sqrt(1 + x^2)",
+    }, false },
+    { "cells", {
+        "r = 1.5", "area := pi*r^2", "vol := area*b", "r = 2", "b = 3", "r = 1.5", "b = a^2 + 1",
+    }, false },
+    { "commands", {
+        "digits 8", "digits shortest", "digits 10", "memo f", "memo f clear", "memo f off", "list",
+        "stats", "memo",
+    }, false },
+    { "expressions", {
+        "1 + 2*3", "2pi/3", "f(2) + g(0.5)", "h(1.5)^2", "d(f, 1) - fp(1)", "sqrt(b)*area",
+        "5!/3!", "0x1F + 4.7k", "((1 + 2)*(3 + 4))/7", "sin(pi/6) + cos(pi/3)", "-a^2 + --3",
+        "vol/area", "k(0.3) - s(theta)", "2(a + 1)(b - 1)", "ln(2)^2 + log(1000)",
+    }, false },
+    { "errors", {
+        "1 = 2", "f(", "nope(3)", "q + 1", "0.5!", "2 +", "pi r^2", "memo nope", "(1 + 2",
+    }, true },
+};
+
+static const int kNumCorpora = int(sizeof(kCorpora) / sizeof(kCorpora[0]));
+
+// best of a few runs, in ns per line
+template<typename F>
+static double time_ns(int numLines, F&& run)
+{
+    double best = HUGE_VAL;
+    for (int attempt = 0; attempt < 5; ++attempt)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRepeats; ++i)
+            run();
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / (double(numLines) * kRepeats));
+    }
+    return best;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static char s_res[256];
+
+static void run_lines(CalcContext* calc, const Corpus& corpus)
+{
+    for (const char* line : corpus.Lines)
+        calc_eval(calc, line, s_res, sizeof(s_res));
+}
+
+static void print_row(const char* name, int numLines, double ns)
+{
+    printf("%-12s %6d %10.0f ns %12.0f\n", name, numLines, ns, 1.0e9 / ns);
+}
+
+int main()
+{
+    CalcContext* calc = calc_create(nullptr, nullptr);
+
+    // the definitions the rest use, and a check that every line does what it's there for
+    bool mismatch = false;
+    for (const Corpus& corpus : kCorpora)
+    {
+        for (const char* line : corpus.Lines)
+        {
+            if (calc_eval(calc, line, s_res, sizeof(s_res)) == corpus.Fails)
+            {
+                printf("MISMATCH %s: %s\n%s", corpus.Name, line, s_res);
+                mismatch = true;
+            }
+        }
+    }
+
+    printf("%-12s %6s %13s %12s\n", "", "lines", "per line", "lines/sec");
+
+    int totalLines = 0;
+    for (const Corpus& corpus : kCorpora)
+    {
+        const int numLines = int(corpus.Lines.size());
+        totalLines += numLines;
+        print_row(corpus.Name, numLines, time_ns(numLines, [&] { run_lines(calc, corpus); }));
+    }
+
+    // a line of each kind in turn, so nothing stays warm from the line before
+    std::vector<const char*> mixed;
+    for (size_t i = 0; int(mixed.size()) < totalLines; ++i)
+    {
+        for (const Corpus& corpus : kCorpora)
+        {
+            if (i < corpus.Lines.size())
+                mixed.push_back(corpus.Lines[i]);
+        }
+    }
+    const Corpus mixedCorpus { "mixed", mixed, false };
+    print_row(mixedCorpus.Name, totalLines, time_ns(totalLines, [&] { run_lines(calc, mixedCorpus); }));
+
+    calc_destroy(calc);
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+// times each vector maths kernel against calling libm an element at a time
+
+#include "libcalc/maths.h"
+#include "libcalc/vmaths.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+struct Case
+{
+    const char* Name;
+    CalcDoubleVecFn Fn;
+    CalcFloatVecFn FloatFn;
+    double (*Libm)(double v);
+    float (*LibmFloat)(float v);
+    double Lo;
+    double Hi;
+};
+
+static const int kCount = 4096;
+static const int kRepeats = 2000;
+
+static volatile double s_sink;
+
+static float sincf(float v)
+{
+    return float(sinc(v));
+}
+
+// best of a few runs, in ns per element
+template<typename F>
+static double time_ns(F&& run)
+{
+    double best = HUGE_VAL;
+    for (int attempt = 0; attempt < 5; ++attempt)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRepeats; ++i)
+            run();
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / (double(kCount) * kRepeats));
+    }
+    return best;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+    const Case cases[] = {
+        { "sin", vsin, vsinf, ::sin, ::sinf, -10.0, 10.0 },
+        { "cos", vcos, vcosf, ::cos, ::cosf, -10.0, 10.0 },
+        { "tan", vtan, vtanf, ::tan, ::tanf, -10.0, 10.0 },
+        { "sinc", vsinc, vsincf, ::sinc, sincf, -10.0, 10.0 },
+        { "asin", vasin, vasinf, ::asin, ::asinf, -1.0, 1.0 },
+        { "acos", vacos, vacosf, ::acos, ::acosf, -1.0, 1.0 },
+        { "atan", vatan, vatanf, ::atan, ::atanf, -10.0, 10.0 },
+        { "ln", vln, vlnf, ::log, ::logf, 0.001, 1000.0 },
+        { "log", vlog10, vlog10f, ::log10, ::log10f, 0.001, 1000.0 },
+        { "sqrt", vsqrt, vsqrtf, ::sqrt, ::sqrtf, 0.0, 1000.0 },
+    };
+
+    std::vector<double> in(kCount), out(kCount);
+    std::vector<float> inFloat(kCount), outFloat(kCount);
+
+    printf("%-5s %10s %10s %8s %10s %10s %8s\n", "", "vector", "libm", "", "float", "libm", "");
+    for (const Case& c : cases)
+    {
+        for (int i = 0; i < kCount; ++i)
+        {
+            in[i] = c.Lo + (c.Hi - c.Lo) * (i + 0.5) / kCount;
+            inFloat[i] = float(in[i]);
+        }
+
+        const double vec = time_ns([&] { c.Fn(in.data(), out.data(), kCount); s_sink = out[0]; });
+        const double libm = time_ns([&] {
+            for (int i = 0; i < kCount; ++i)
+                out[i] = c.Libm(in[i]);
+            s_sink = out[0];
+        });
+        const double vecFloat = time_ns([&] {
+            c.FloatFn(inFloat.data(), outFloat.data(), kCount);
+            s_sink = outFloat[0];
+        });
+        const double libmFloat = time_ns([&] {
+            for (int i = 0; i < kCount; ++i)
+                outFloat[i] = c.LibmFloat(inFloat[i]);
+            s_sink = outFloat[0];
+        });
+
+        printf("%-5s %7.2f ns %7.2f ns %7.1fx %7.2f ns %7.2f ns %7.1fx\n", c.Name, vec, libm,
+            libm / vec, vecFloat, libmFloat, libmFloat / vecFloat);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#!/bin/env python3
+
+import argparse
+
+
+# the powers of 5 that reading a double can need, and a little more either side. writing one
+# out needs up to 10^332, to scale the smallest subnormals up
+SMALLEST_POWER = -342
+LARGEST_POWER = 332
+
+
+def pow5_128(q):
+    """5^q as a 128 bit number with its top bit set, with the exponent of 2 left implicit.
+    positive powers are truncated, and negative ones rounded up"""
+    if q >= 0:
+        power5 = 5 ** q
+        while power5 < (1 << 127):
+            power5 *= 2
+        while power5 >= (1 << 128):
+            power5 //= 2
+        return power5
+
+    power5 = 5 ** -q
+    z = 0
+    while (1 << z) < power5:
+        z += 1
+
+    if q >= -27:
+        # 2^b / 5^-q fits in 128 bits straight away
+        b = z + 127
+        return 2 ** b // power5 + 1
+
+    b = 2 * z + 2 * 64
+    c = 2 ** b // power5 + 1
+    while c >= (1 << 128):
+        c //= 2
+    return c
+
+
+def emit_prologue(outfile):
+    outfile.write('//\n')
+    outfile.write('// powers of 5 for reading numbers\n')
+    outfile.write('//\n')
+    outfile.write('// This file was created using genpow5.py\n')
+    outfile.write('//\n')
+    outfile.write('\n')
+    outfile.write('#include <stdint.h>\n')
+    outfile.write('\n')
+    outfile.write(f'// 5^q for q in [{SMALLEST_POWER}, {LARGEST_POWER}], high 64 bits first\n')
+    outfile.write('const uint64_t pow5_128[][2] = {\n')
+
+
+def emit_powers(outfile):
+    for q in range(SMALLEST_POWER, LARGEST_POWER + 1):
+        c = pow5_128(q)
+        hi = c >> 64
+        lo = c & ((1 << 64) - 1)
+        outfile.write(f'    {{ 0x{hi:016x}, 0x{lo:016x} }},   // 5^{q}\n')
+
+
+def emit_epilogue(outfile):
+    outfile.write('};\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        prog='genpow5',
+        description='writes the table of 128 bit powers of 5 that numparse.cpp reads and writes numbers with')
+    parser.add_argument('-o', '--output', required=True)
+    args = parser.parse_args()
+
+    with open(args.output, 'wt', encoding='utf-8') as outfile:
+        emit_prologue(outfile)
+        emit_powers(outfile)
+        emit_epilogue(outfile)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,116 @@
+// checks d(f, x) and deriv against slopes worked out by hand, and that d is only read as a
+// derivative when it's written like one, so it can still be the name of a user function
+
+#include "libcalc/context.h"
+#include "libcalc/intern.h"
+#include "libcalc/libcalc.h"
+#include "libcalc/symbols.h"
+
+#include <cmath>
+#include <cstdio>
+
+//-------------------------------------------------------------------------------------------------
+
+static int s_failures = 0;
+
+// runs a line that should work
+static bool run(CalcContext* calc, const char* line)
+{
+    char res[256];
+    if (calc_eval(calc, line, res, sizeof(res)))
+        return true;
+
+    printf("%s: %s", line, res);
+    ++s_failures;
+    return false;
+}
+
+// expr's value, got by assigning it to y
+static double value_of(CalcContext* calc, const char* expr)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "y = %s", expr);
+
+    double val = NAN;
+    if (run(calc, line))
+        eval_named_value(intern("y"), val);
+    return val;
+}
+
+static void check(CalcContext* calc, const char* expr, double want)
+{
+    const double got = value_of(calc, expr);
+    if (!(std::fabs(got - want) <= 1e-12 * std::fmax(1.0, std::fabs(want))))
+    {
+        printf("%s gave %.17g, not %.17g\n", expr, got, want);
+        ++s_failures;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void check_slopes(CalcContext* calc)
+{
+    run(calc, "f(x) = x^3 - 2x");
+    run(calc, "g(x) = sin(x)*e^x");
+    run(calc, "fp = deriv f");
+
+    char expr[64];
+    for (double x : { -2.5, -1.0, 0.0, 0.5, 3.0 })
+    {
+        const double fSlope = 3.0 * x * x - 2.0;
+
+        snprintf(expr, sizeof(expr), "d(f, %.17g)", x);
+        check(calc, expr, fSlope);
+
+        snprintf(expr, sizeof(expr), "fp(%.17g)", x);
+        check(calc, expr, fSlope);
+
+        snprintf(expr, sizeof(expr), "d(g, %.17g)", x);
+        check(calc, expr, std::exp(x) * (std::sin(x) + std::cos(x)));
+
+        snprintf(expr, sizeof(expr), "d(sin, %.17g)", x);
+        check(calc, expr, std::cos(x));
+    }
+}
+
+// d(3) is a call, and d(f, x) is still a derivative once there's a user function called d
+static void check_d_as_function(CalcContext* calc)
+{
+    char res[256];
+    if (calc_eval(calc, "d(3)", res, sizeof(res)))
+    {
+        printf("d(3) worked before d was defined\n");
+        ++s_failures;
+    }
+
+    run(calc, "d(x) = x*2");
+    check(calc, "d(3)", 6.0);
+    check(calc, "d(2+1)", 6.0);
+    check(calc, "d(f, 2)", 10.0);
+    check(calc, "d(d, 1)", 2.0);
+
+    run(calc, "h(x) = d(x) + d(f, x)");
+    check(calc, "h(1)", 3.0);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+    CalcContext* calc = calc_create(nullptr, nullptr);
+    {
+        ContextScope scope(calc);
+        check_slopes(calc);
+        check_d_as_function(calc);
+    }
+    calc_destroy(calc);
+
+    if (s_failures)
+    {
+        printf("deriv: %d failures\n", s_failures);
+        return 1;
+    }
+    printf("deriv: ok\n");
+    return 0;
+}
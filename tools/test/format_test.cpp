@@ -0,0 +1,202 @@
+// checks the number formatting: that shortest digits read back as exactly the same double, with
+// as few digits as that takes and no made up zeros on the end of big integers, and that every
+// other number of digits comes out just like %g
+
+#include "libcalc/context.h"
+#include "libcalc/format.h"
+#include "libcalc/libcalc.h"
+#include "libcalc/numparse.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+static int s_failures = 0;
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, so the samples are the same everywhere
+static uint64_t next_random()
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// any finite double, with every exponent as likely as any other
+static double random_double()
+{
+    const uint64_t bits = next_random() & 0xffefffffffffffffull;
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+static bool same(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void fail(const char* what, double val, const char* got, const char* want)
+{
+    if (s_failures < 20)
+        printf("%s: %.17g gave %s, not %s\n", what, val, got, want);
+    ++s_failures;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// str read the way the calculator reads it, with the sign done separately
+static double parse(const char* str)
+{
+    const bool negative = (str[0] == '-');
+    double val = 0.0;
+    bool outOfRange = false;
+    read_number(str + (negative ? 1 : 0), val, outOfRange);
+    return negative ? -val : val;
+}
+
+// the significant digits in str, not counting zeros at either end
+static int count_digits(const char* str)
+{
+    const char* first = str;
+    while (*first && ((*first < '1') || (*first > '9')))
+        ++first;
+
+    const char* last = first;
+    for (const char* p = first; *p && (*p != 'e'); ++p)
+    {
+        if ((*p >= '1') && (*p <= '9'))
+            last = p;
+    }
+
+    // zero has one
+    if (!*first)
+        return 1;
+
+    int count = 0;
+    for (const char* p = first; p <= last; ++p)
+        count += (*p != '.') ? 1 : 0;
+    return count;
+}
+
+// the fewest digits printf needs for val to read back
+static int fewest_digits(double val)
+{
+    char buf[40];
+    for (int digits = 1; digits < kMaxFormatDigits; ++digits)
+    {
+        snprintf(buf, sizeof(buf), "%.*e", digits - 1, val);
+        if (same(strtod(buf, nullptr), val))
+            return digits;
+    }
+    return kMaxFormatDigits;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void check_shortest(double val)
+{
+    char buf[40];
+    dtostr_shortest(val, buf, sizeof(buf));
+
+    char want[40];
+    if (!same(parse(buf), val))
+    {
+        snprintf(want, sizeof(want), "%.17g", val);
+        fail("doesn't read back", val, buf, want);
+        return;
+    }
+
+    // integers too big for every one to be a double are written out in full when they fit
+    const double mag = fabs(val);
+    if ((mag >= 0x1p53) && (mag < 1e17))
+    {
+        snprintf(want, sizeof(want), "%.0f", val);
+        if (strcmp(buf, want) != 0)
+            fail("not the whole integer", val, buf, want);
+        return;
+    }
+
+    const int fewest = fewest_digits(val);
+    if (count_digits(buf) != fewest)
+    {
+        snprintf(want, sizeof(want), "%.*g", fewest, val);
+        fail("not the shortest", val, buf, want);
+    }
+}
+
+static void check_digits(double val)
+{
+    char buf[40];
+    char want[40];
+    for (int digits = 1; digits <= kMaxFormatDigits; ++digits)
+    {
+        set_format_digits(digits);
+        dtostr_human(val, buf, sizeof(buf));
+        snprintf(want, sizeof(want), "%.*g", digits, val);
+        if (strcmp(buf, want) != 0)
+            fail("not like %g", val, buf, want);
+    }
+    set_format_digits(kDefaultDigits);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void run_checks()
+{
+    static const double kSpecials[] =
+    {
+        0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.0 / 3.0, 2.0 / 3.0, 100.0, 1e21, 1e22, 1e23,
+        5e-324, 1e-323, 2.2250738585072014e-308, 2.2250738585072009e-308, 1.7976931348623157e308,
+        0x1p53, 0x1p53 + 2.0, 0x1p54, 0x1p56, 0x1p56 + 16.0, 99999999999999984.0, 1e16, 1e17,
+        123456789012345678.0, 9007199254740991.0, 4503599627370497.5, 0.000123, 0.0001, 1e-5,
+        1234567.0, 12345678.0, 123456789.0, 9.5, 0.95, 99.5, 999999.5, 1e15 + 0.5,
+    };
+
+    for (double val : kSpecials)
+    {
+        check_shortest(val);
+        check_shortest(-val);
+        check_digits(val);
+    }
+
+    // big integers, where the last digits of the shortest form would be zeros
+    for (int i = 0; i < 200000; ++i)
+        check_shortest(ldexp(double(next_random() >> 11), 1 + int(next_random() % 10)));
+
+    for (int i = 0; i < 500000; ++i)
+        check_shortest(random_double());
+
+    // and every number of digits, which takes more printing
+    for (int i = 0; i < 50000; ++i)
+    {
+        const double val = random_double();
+        check_digits(val);
+        check_digits(ldexp(double(next_random() >> 11), -int(next_random() % 60)));
+    }
+}
+
+int main()
+{
+    // the number of digits is kept in the context
+    CalcContext* calc = calc_create(nullptr, nullptr);
+    {
+        ContextScope scope(calc);
+        run_checks();
+    }
+    calc_destroy(calc);
+
+    if (s_failures)
+    {
+        printf("format: %d failures\n", s_failures);
+        return 1;
+    }
+    printf("format: ok\n");
+    return 0;
+}
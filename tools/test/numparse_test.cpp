@@ -0,0 +1,226 @@
+// checks read_number against strtod: the value, where it stops and whether it's out of range,
+// for random doubles written every way, random digit strings, numbers near half way between two
+// doubles, every number with up to 3 significant digits at every exponent, and the awkward ones
+
+#include "libcalc/numparse.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+//-------------------------------------------------------------------------------------------------
+
+static int s_failures = 0;
+static int s_checked = 0;
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, so the samples are the same everywhere
+static uint64_t next_random()
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static int random_below(int n)
+{
+    return int(next_random() % uint64_t(n));
+}
+
+static double bits_to_double(uint64_t bits)
+{
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+static uint64_t double_to_bits(double val)
+{
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void check(const char* str)
+{
+    ++s_checked;
+
+    char* strtodEnd = nullptr;
+    errno = 0;
+    const double want = strtod(str, &strtodEnd);
+    const bool wantOutOfRange = (errno != 0);
+
+    double got = 0.0;
+    bool gotOutOfRange = false;
+    const char* end = read_number(str, got, gotOutOfRange);
+
+    // strtod reads a sign and leading spaces, which read_number leaves to the parser
+    const bool same = (double_to_bits(got) == double_to_bits(want)) && (end == strtodEnd)
+        && (gotOutOfRange == wantOutOfRange);
+    if (!same)
+    {
+        if (s_failures < 20)
+        {
+            printf("%s: got %.17g (%d chars%s), strtod %.17g (%d chars%s)\n", str, got,
+                int(end - str), gotOutOfRange ? ", out of range" : "", want, int(strtodEnd - str),
+                wantOutOfRange ? ", out of range" : "");
+        }
+        ++s_failures;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// finite positive doubles with random bits, so every exponent is as likely as any other, written
+// with every number of significant digits and in each format
+static void check_random_doubles()
+{
+    static const char* const kFormats[] = { "%.*g", "%.*e", "%.*f" };
+
+    char buf[400];
+    for (int i = 0; i < 200000; ++i)
+    {
+        const double val = bits_to_double(next_random() & 0x7fefffffffffffffull);
+        for (int digits = 1; digits <= 17; ++digits)
+        {
+            const char* format = kFormats[(digits + i) % 3];
+
+            // %f of a big or tiny number is hundreds of digits long, and mostly zeros
+            if ((format[3] == 'f') && ((val > 1e30) || (val < 1e-30)))
+                format = kFormats[0];
+
+            snprintf(buf, sizeof(buf), format, digits, val);
+            check(buf);
+        }
+    }
+}
+
+// up to 40 random digits, maybe with a point in, and a random exponent. plenty of these have more
+// digits than fit in 64 bits, or overflow, or are subnormal
+static void check_random_digits()
+{
+    for (int i = 0; i < 1000000; ++i)
+    {
+        std::string str;
+        const int numDigits = 1 + random_below(40);
+        const int point = random_below(numDigits + 1);
+        for (int d = 0; d < numDigits; ++d)
+        {
+            if (d == point)
+                str += '.';
+
+            // runs of 0s and 9s are where rounding is hardest
+            const int kind = random_below(4);
+            str += (kind == 0) ? '0' : (kind == 1) ? '9' : char('0' + random_below(10));
+        }
+
+        if (random_below(4) != 0)
+        {
+            char exp[16];
+            snprintf(exp, sizeof(exp), "e%d", random_below(700) - 360);
+            str += exp;
+        }
+
+        check(str.c_str());
+    }
+}
+
+// the exact half way point between two doubles, and a digit either side of it, which decides
+// which one it rounds to. the half way point has a 64 bit mantissa, so fits in a long double
+static void check_half_way()
+{
+    char buf[800];
+    for (int i = 0; i < 100000; ++i)
+    {
+        const uint64_t bits = next_random() & 0x7fefffffffffffffull;
+        const double lo = bits_to_double(bits);
+        const double hi = bits_to_double(bits + 1);
+        const long double mid = ((long double)lo + (long double)hi) / 2;
+
+        // all the digits, then cut short at a few lengths
+        const int len = snprintf(buf, sizeof(buf), "%.760Le", mid);
+        if ((len <= 0) || (len >= int(sizeof(buf))))
+            continue;
+        check(buf);
+
+        char* exp = strchr(buf, 'e');
+        const std::string expPart = exp;
+        const std::string mantissa(buf, exp - buf);
+        for (int cut : { 18, 19, 20, 25, 40 })
+        {
+            std::string str = mantissa.substr(0, cut) + expPart;
+            check(str.c_str());
+
+            str = mantissa.substr(0, cut) + "1" + expPart;
+            check(str.c_str());
+        }
+    }
+}
+
+// every d, d.d and d.dd at every exponent that isn't far out of range
+static void check_short_numbers()
+{
+    char buf[32];
+    for (int exp = -345; exp <= 310; ++exp)
+    {
+        for (int m = 1; m < 1000; ++m)
+        {
+            snprintf(buf, sizeof(buf), "%d.%02de%d", m / 100, m % 100, exp);
+            check(buf);
+        }
+    }
+}
+
+static void check_specials()
+{
+    static const char* const kStrs[] =
+    {
+        "0", "0.0", "0.", ".0", "00000", "0e0", "0e-999999", "0e999999", "000123", ".5", "5.",
+        "1e", "1e+", "1e-", "1e+5", "1E5", "1ex", "1.e3", "1..2", "1.2.3", "12abc",
+        "0x10", "0x1p-3", "0X1.8P1", "0x", "0xg",
+        "1e308", "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308",
+        "1e309", "1e999999999", "1e-999999999", "99999999999999999999e-999999999",
+        "2.2250738585072014e-308", "2.2250738585072011e-308", "2.2250738585072012e-308",
+        "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+        "9007199254740992", "9007199254740993", "9007199254740994", "9007199254740995",
+        "18446744073709551615", "18446744073709551616", "1844674407370955161500000",
+        "9999999999999999999", "99999999999999999999", "10000000000000000000000000001",
+        "0.1", "0.2", "0.3", "3.14159265358979323846264338327950288", "2.718281828459045",
+        "1e23", "8.589973e9", "5e-324", "1e22", "1e-22", "123456789012345678901234567890e-30",
+        "0.000000000000000000000000000000000000000000001e45",
+        "7.038531e-26", "9223372036854775807", "9223372036854775808",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+    };
+
+    for (const char* str : kStrs)
+        check(str);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+    check_specials();
+    check_short_numbers();
+    check_half_way();
+    check_random_digits();
+    check_random_doubles();
+
+    if (s_failures)
+    {
+        printf("numparse: %d of %d differ from strtod\n", s_failures, s_checked);
+        return 1;
+    }
+    printf("numparse: ok, %d numbers\n", s_checked);
+    return 0;
+}
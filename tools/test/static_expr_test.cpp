@@ -0,0 +1,171 @@
+// checks formulas compiled ahead of time with static_expr.h against the same text run by the
+// calculator. static_expr.h promises the same bits as the formula run without simplifying, which
+// is what an expression in a user value x gets. it also checks d() and deriv work on a registered
+// builtin, from the def it was registered with
+
+#include "libcalc/context.h"
+#include "libcalc/intern.h"
+#include "libcalc/libcalc.h"
+#include "libcalc/static_expr.h"
+#include "libcalc/symbols.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+static int s_failures = 0;
+
+struct Formula
+{
+    const char* Name;
+    const char* Def;
+    bool WholeOnly;     // has x! in, which is an error for the calculator and NaN here otherwise
+};
+
+static Formula s_formulas[16];
+static int s_numFormulas = 0;
+
+// registers def as the builtin name, and keeps it to check
+#define ADD_FORMULA(calc, name, def, wholeOnly) \
+    add_formula(CALC_REGISTER_STATIC_FUNC(calc, name, def), name, def, wholeOnly)
+
+static void add_formula(bool registered, const char* name, const char* def, bool wholeOnly)
+{
+    if (!registered)
+    {
+        printf("couldn't register %s\n", name);
+        ++s_failures;
+        return;
+    }
+
+    s_formulas[s_numFormulas++] = { .Name = name, .Def = def, .WholeOnly = wholeOnly };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// runs a line that should work
+static bool run(CalcContext* calc, const char* line)
+{
+    char res[256];
+    if (calc_eval(calc, line, res, sizeof(res)))
+        return true;
+
+    printf("%s: %s", line, res);
+    ++s_failures;
+    return false;
+}
+
+// expr's value, got by assigning it to y
+static double value_of(CalcContext* calc, const char* expr)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "y = %s", expr);
+
+    double val = NAN;
+    if (run(calc, line))
+        eval_named_value(intern("y"), val);
+    return val;
+}
+
+static bool same(double a, double b)
+{
+    return (memcmp(&a, &b, sizeof(a)) == 0) || (std::isnan(a) && std::isnan(b));
+}
+
+static void check_close(const char* what, double got, double want)
+{
+    if (!(std::fabs(got - want) <= 1e-12 * std::fmax(1.0, std::fabs(want))))
+    {
+        printf("%s gave %.17g, not %.17g\n", what, got, want);
+        ++s_failures;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void check_values(CalcContext* calc)
+{
+    static const double kXs[] = { -2.5, -1.0, -0.3, 0.0, 0.2, 0.5, 1.0, 1.7, 3.0, 10.0, 1e-5, 123.456 };
+
+    char line[256];
+    for (int i = 0; i < s_numFormulas; ++i)
+    {
+        const Formula& formula = s_formulas[i];
+        for (double x : kXs)
+        {
+            if (formula.WholeOnly && ((x < 0.0) || (x != std::floor(x))))
+                continue;
+
+            snprintf(line, sizeof(line), "%s(%.17g)", formula.Name, x);
+            const double got = value_of(calc, line);
+
+            snprintf(line, sizeof(line), "x = %.17g", x);
+            run(calc, line);
+            const double want = value_of(calc, formula.Def);
+
+            if (!same(got, want))
+            {
+                printf("%s at %.17g gave %.17g, not %.17g\n", formula.Name, x, got, want);
+                ++s_failures;
+            }
+        }
+    }
+}
+
+// registered builtins have no slope of their own, so theirs comes from running the def with dual
+// numbers
+static void check_slopes(CalcContext* calc)
+{
+    run(calc, "hw(x) = 2hann(x)");
+    run(calc, "hwp = deriv hw");
+
+    char expr[64];
+    for (double x : { -0.7, 0.0, 0.1, 0.25, 0.6, 2.0 })
+    {
+        const double hannSlope = pi * std::sin(2.0 * pi * x);
+
+        snprintf(expr, sizeof(expr), "d(hann, %.17g)", x);
+        check_close(expr, value_of(calc, expr), hannSlope);
+
+        snprintf(expr, sizeof(expr), "hwp(%.17g)", x);
+        check_close(expr, value_of(calc, expr), 2.0 * hannSlope);
+
+        snprintf(expr, sizeof(expr), "d(poly, %.17g)", x);
+        check_close(expr, value_of(calc, expr), 9.0 * x * x - 4.0 * x + 0.25);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+    CalcContext* calc = calc_create(nullptr, nullptr);
+
+    ADD_FORMULA(calc, "hann", "0.5 - 0.5cos(2pi*x)", false);
+    ADD_FORMULA(calc, "poly", "3x^3 - 2x^2 + x/4 - 1", false);
+    ADD_FORMULA(calc, "units", "4.7k*x + 10m - 3u/x", false);
+    ADD_FORMULA(calc, "negs", "-x^2 + -3*-x - (-2)^2 - -x", false);
+    ADD_FORMULA(calc, "parens", "2(x+1)(x-1) + [x - 3]{x}", false);
+    ADD_FORMULA(calc, "hex", "0x1F*x + 0xff/0x10", false);
+    ADD_FORMULA(calc, "quirks", "2e*x + 1e3x - .5e-1", false);
+    ADD_FORMULA(calc, "mixed", "sqrt(1 + x^2)*e^(-x)/ln(2 + x^2) + sinc(x)", false);
+    ADD_FORMULA(calc, "trig", "sin(x)^2 + cos(x)^2 - tan(x/3)*atan(x) + log(1 + x^4)", false);
+    ADD_FORMULA(calc, "fact", "x!/3! + 2^x - 4!", true);
+
+    {
+        ContextScope scope(calc);
+        check_values(calc);
+        check_slopes(calc);
+    }
+    calc_destroy(calc);
+
+    if (s_failures)
+    {
+        printf("static_expr: %d failures\n", s_failures);
+        return 1;
+    }
+    printf("static_expr: ok, %d formulas\n", s_numFormulas);
+    return 0;
+}
@@ -0,0 +1,322 @@
+// checks the vector maths kernels against libm: the error bounds in vmaths.h over each domain,
+// the special values, counts that leave a partial pack, and working in place
+
+#include "libcalc/maths.h"
+#include "libcalc/vmaths.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+
+typedef long double (*RefFn)(long double v);
+typedef double (*LibmFn)(double v);
+typedef float (*LibmFloatFn)(float v);
+
+struct Range
+{
+    double Lo;
+    double Hi;
+    bool Log;       // spread the samples evenly over the exponents rather than the values
+};
+
+struct Case
+{
+    const char* Name;
+    CalcDoubleVecFn Fn;
+    CalcFloatVecFn FloatFn;
+    RefFn Ref;
+    LibmFn Libm;
+    LibmFloatFn LibmFloat;
+    double MaxUlp;
+    double MaxFloatUlp;
+    std::vector<Range> Ranges;
+    std::vector<Range> FloatRanges;
+};
+
+static const int kSamples = 1 << 18;
+
+static int s_failures = 0;
+
+//-------------------------------------------------------------------------------------------------
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, so the samples are the same everywhere
+static uint64_t next_random()
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static double random_in(const Range& range)
+{
+    const double u = double(next_random() >> 11) * 0x1p-53;
+    if (range.Log)
+        return range.Lo * std::pow(range.Hi / range.Lo, u);
+    return range.Lo + (range.Hi - range.Lo) * u;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static long double sincl(long double v)
+{
+    return v == 0 ? 1.0L : sinl(v) / v;
+}
+
+static float sincf(float v)
+{
+    return float(sinc(v));
+}
+
+static double ulp_error(double got, long double ref)
+{
+    if (std::isnan(got) || std::isnan(ref))
+        return std::isnan(got) && std::isnan(ref) ? 0.0 : HUGE_VAL;
+    if (std::isinf(got) || std::isinf(double(ref)))
+        return got == double(ref) ? 0.0 : HUGE_VAL;
+    if (ref == 0)
+        return got == 0 ? 0.0 : HUGE_VAL;
+
+    int exp;
+    frexpl(ref, &exp);
+    const long double ulp = ldexpl(1.0L, std::max(exp - 53, -1074));
+    return double(fabsl(got - ref) / ulp);
+}
+
+static double ulp_error_float(float got, long double ref)
+{
+    if (std::isnan(got) || std::isnan(ref))
+        return std::isnan(got) && std::isnan(ref) ? 0.0 : HUGE_VAL;
+    if (std::isinf(got) || std::isinf(float(ref)))
+        return got == float(ref) ? 0.0 : HUGE_VAL;
+    if (ref == 0)
+        return got == 0 ? 0.0 : HUGE_VAL;
+
+    int exp;
+    frexpl(ref, &exp);
+    const long double ulp = ldexpl(1.0L, std::max(exp - 24, -149));
+    return double(fabsl(got - ref) / ulp);
+}
+
+static bool same(double a, double b)
+{
+    return (std::isnan(a) && std::isnan(b)) || std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool same_float(float a, float b)
+{
+    return (std::isnan(a) && std::isnan(b)) || std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void check_accuracy(const Case& c)
+{
+    std::vector<double> in(kSamples), out(kSamples);
+    std::vector<float> inFloat(kSamples), outFloat(kSamples);
+
+    double worst = 0.0, worstAt = 0.0;
+    for (const Range& range : c.Ranges)
+    {
+        for (int i = 0; i < kSamples; ++i)
+            in[i] = random_in(range);
+        c.Fn(in.data(), out.data(), kSamples);
+        for (int i = 0; i < kSamples; ++i)
+        {
+            const double err = ulp_error(out[i], c.Ref(in[i]));
+            if (err > worst)
+            {
+                worst = err;
+                worstAt = in[i];
+            }
+        }
+    }
+
+    double worstFloat = 0.0, worstFloatAt = 0.0;
+    for (const Range& range : c.FloatRanges)
+    {
+        for (int i = 0; i < kSamples; ++i)
+            inFloat[i] = float(random_in(range));
+        c.FloatFn(inFloat.data(), outFloat.data(), kSamples);
+        for (int i = 0; i < kSamples; ++i)
+        {
+            const double err = ulp_error_float(outFloat[i], c.Ref(inFloat[i]));
+            if (err > worstFloat)
+            {
+                worstFloat = err;
+                worstFloatAt = inFloat[i];
+            }
+        }
+    }
+
+    const bool ok = worst <= c.MaxUlp && worstFloat <= c.MaxFloatUlp;
+    printf("%-5s %5.2f ulp (max %.1f, at %.17g)  float %5.2f ulp (max %.1f, at %.9g)%s\n", c.Name,
+        worst, c.MaxUlp, worstAt, worstFloat, c.MaxFloatUlp, worstFloatAt, ok ? "" : "  FAILED");
+    if (!ok)
+        ++s_failures;
+}
+
+static void check_specials(const Case& c)
+{
+    static const double specials[] = {
+        0.0, -0.0, INFINITY, -INFINITY, NAN, -NAN, 1.0, -1.0, 2.0, -2.0, 0.5, -0.5,
+        0x1p-1074, -0x1p-1074, 0x1p-1022, -0x1p-1022, 1e-310, 1e-20, -1e-20, DBL_MAX, -DBL_MAX,
+        0x1p20, -0x1p20, 0x1.0000000000001p20, 1e300, 1e22,
+    };
+    const int count = int(sizeof(specials) / sizeof(specials[0]));
+
+    double out[count];
+    c.Fn(specials, out, count);
+    for (int i = 0; i < count; ++i)
+    {
+        const double want = c.Libm(specials[i]);
+        // finite results are held to the error bound, everything else has to match exactly
+        const bool ok = std::isfinite(want) && want != 0 ? ulp_error(out[i], want) <= c.MaxUlp + 0.5
+                                                         : same(out[i], want);
+        if (!ok)
+        {
+            printf("%s(%.17g) = %.17g, libm gives %.17g\n", c.Name, specials[i], out[i], want);
+            ++s_failures;
+        }
+    }
+
+    float inFloat[count], outFloat[count];
+    for (int i = 0; i < count; ++i)
+        inFloat[i] = float(specials[i]);
+    c.FloatFn(inFloat, outFloat, count);
+    for (int i = 0; i < count; ++i)
+    {
+        const float want = c.LibmFloat(inFloat[i]);
+        const bool ok = std::isfinite(want) && want != 0
+            ? ulp_error_float(outFloat[i], want) <= c.MaxFloatUlp + 0.5
+            : same_float(outFloat[i], want);
+        if (!ok)
+        {
+            printf("%sf(%.9g) = %.9g, libm gives %.9g\n", c.Name, inFloat[i], outFloat[i], want);
+            ++s_failures;
+        }
+    }
+}
+
+// every count up to a few packs, at every offset, has to give the same as one long call. so does
+// writing over the input
+static void check_tails(const Case& c)
+{
+    const int size = 40;
+    double in[size], whole[size];
+    float inFloat[size], wholeFloat[size];
+    for (int i = 0; i < size; ++i)
+    {
+        in[i] = random_in(c.Ranges[0]);
+        inFloat[i] = float(random_in(c.FloatRanges[0]));
+    }
+    c.Fn(in, whole, size);
+    c.FloatFn(inFloat, wholeFloat, size);
+
+    bool ok = true;
+    for (int start = 0; start < 8; ++start)
+    {
+        for (int count = 0; start + count <= size; ++count)
+        {
+            double out[size];
+            float outFloat[size];
+            for (int i = 0; i < size; ++i)
+            {
+                out[i] = -123.0;
+                outFloat[i] = -123.0f;
+            }
+            c.Fn(in + start, out + start, count);
+            c.FloatFn(inFloat + start, outFloat + start, count);
+            for (int i = 0; i < size; ++i)
+            {
+                const bool inside = i >= start && i < start + count;
+                ok = ok && same(out[i], inside ? whole[i] : -123.0);
+                ok = ok && same_float(outFloat[i], inside ? wholeFloat[i] : -123.0f);
+            }
+        }
+    }
+
+    double inPlace[size];
+    float inPlaceFloat[size];
+    std::memcpy(inPlace, in, sizeof(in));
+    std::memcpy(inPlaceFloat, inFloat, sizeof(inFloat));
+    c.Fn(inPlace, inPlace, size);
+    c.FloatFn(inPlaceFloat, inPlaceFloat, size);
+    for (int i = 0; i < size; ++i)
+        ok = ok && same(inPlace[i], whole[i]) && same_float(inPlaceFloat[i], wholeFloat[i]);
+
+    if (!ok)
+    {
+        printf("%s: partial packs or in-place use give different results\n", c.Name);
+        ++s_failures;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main()
+{
+    // the trig kernels are checked an octave at a time up to where they give up, and a little past
+    std::vector<Range> trig, trigFloat;
+    for (int e = -8; e <= 20; ++e)
+    {
+        trig.push_back({ std::ldexp(1.0, e), std::ldexp(1.0, e + 1), false });
+        trig.push_back({ -std::ldexp(1.0, e + 1), -std::ldexp(1.0, e), false });
+    }
+    trig.push_back({ 0x1p-30, 0x1p-8, true });
+    trig.push_back({ 0x1p20, 0x1p22, false });
+    for (int e = -8; e <= 9; ++e)
+    {
+        trigFloat.push_back({ std::ldexp(1.0, e), std::ldexp(1.0, e + 1), false });
+        trigFloat.push_back({ -std::ldexp(1.0, e + 1), -std::ldexp(1.0, e), false });
+    }
+    trigFloat.push_back({ 0x1p-30, 0x1p-8, true });
+    trigFloat.push_back({ 512.0, 2048.0, false });
+
+    const std::vector<Range> unit = { { -1.0, 1.0, false }, { 0x1p-30, 0x1p-4, true },
+        { -0x1p-4, -0x1p-30, true }, { 0.9, 1.0, false }, { -1.0, -0.9, false } };
+    const std::vector<Range> atanRanges = { { -4.0, 4.0, false }, { 0x1p-30, 1e30, true },
+        { -1e30, -0x1p-30, true } };
+    const std::vector<Range> logRanges = { { 0.5, 2.0, false }, { 0.99, 1.01, false },
+        { 1e-320, 1e300, true } };
+    const std::vector<Range> logFloatRanges = { { 0.5, 2.0, false }, { 0.99, 1.01, false },
+        { 1e-44, 1e38, true } };
+    const std::vector<Range> sqrtRanges = { { 0.0, 100.0, false }, { 1e-320, 1e300, true } };
+    const std::vector<Range> sqrtFloatRanges = { { 0.0, 100.0, false }, { 1e-44, 1e38, true } };
+
+    const Case cases[] = {
+        { "sin", vsin, vsinf, sinl, ::sin, ::sinf, 1.6, 1.6, trig, trigFloat },
+        { "cos", vcos, vcosf, cosl, ::cos, ::cosf, 1.6, 1.6, trig, trigFloat },
+        { "tan", vtan, vtanf, tanl, ::tan, ::tanf, 3.7, 3.7, trig, trigFloat },
+        { "sinc", vsinc, vsincf, sincl, ::sinc, sincf, 2.5, 2.5, trig, trigFloat },
+        { "asin", vasin, vasinf, asinl, ::asin, ::asinf, 3.0, 3.0, unit, unit },
+        { "acos", vacos, vacosf, acosl, ::acos, ::acosf, 2.5, 2.5, unit, unit },
+        { "atan", vatan, vatanf, atanl, ::atan, ::atanf, 2.0, 2.0, atanRanges, atanRanges },
+        { "ln", vln, vlnf, logl, ::log, ::logf, 1.5, 1.0, logRanges, logFloatRanges },
+        { "log", vlog10, vlog10f, log10l, ::log10, ::log10f, 2.0, 2.0, logRanges, logFloatRanges },
+        { "sqrt", vsqrt, vsqrtf, sqrtl, ::sqrt, ::sqrtf, 0.5, 0.5, sqrtRanges, sqrtFloatRanges },
+    };
+
+    for (const Case& c : cases)
+    {
+        check_accuracy(c);
+        check_specials(c);
+        check_tails(c);
+    }
+
+    if (s_failures)
+    {
+        printf("vmaths: %d failures\n", s_failures);
+        return 1;
+    }
+    printf("vmaths: ok\n");
+    return 0;
+}